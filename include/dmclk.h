@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include "dmod.h"
 #include "dmclk_defs.h"
+#include "dmclk_port.h"
 
 /**
  * @brief Source of the clock signal
@@ -16,6 +17,36 @@ typedef enum
     dmclk_source_hibernation,       /**< Low-power hibernation clock source */
 } dmclk_source_t;
 
+/**
+ * @brief Maximum number of operating points read from the [dmclk.opp.N] sections
+ */
+#ifndef DMCLK_MAX_OPPS
+#   define DMCLK_MAX_OPPS   8
+#endif
+
+/**
+ * @brief Number of clock output pins (MCO1 and MCO2)
+ */
+#define DMCLK_MCO_COUNT     2
+
+/**
+ * @brief Operating point index reported when the clock was not set from the table
+ */
+#define DMCLK_OPP_NONE      0xFFFFFFFFU
+
+/**
+ * @brief Open flag selecting the binary device record
+ *
+ * Handles opened with it read a #dmclk_info_t instead of the info text.
+ * Outside the bits used by the DMDRVI_O_* flags.
+ */
+#define DMCLK_O_BINARY      0x01000000
+
+/**
+ * @brief Layout version of #dmclk_info_t, raised when the record changes
+ */
+#define DMCLK_INFO_VERSION  1U
+
 /**
  * @brief IOCTL commands for DMCLK device
  */
@@ -31,9 +62,202 @@ typedef enum
     dmclk_ioctl_cmd_set_target_frequency,    /**< Set target frequency */
     dmclk_ioctl_cmd_get_target_frequency,    /**< Get target frequency */
     dmclk_ioctl_cmd_reconfigure,             /**< Reconfigure clock with current settings */
+    dmclk_ioctl_cmd_register_notifier,       /**< Register clock change notifier (dmclk_notifier_t*) */
+    dmclk_ioctl_cmd_unregister_notifier,     /**< Unregister clock change notifier (dmclk_notifier_t*) */
+    dmclk_ioctl_cmd_get_clock_tree,          /**< Get SYSCLK, HCLK, PCLKx, timer and PLL clocks (dmclk_clock_tree_t*) */
+    dmclk_ioctl_cmd_get_shared,              /**< Get the ISR-safe shared clock state (const dmclk_shared_t**) */
+    dmclk_ioctl_cmd_set_governor,            /**< Set frequency governor policy (dmclk_governor_t*) */
+    dmclk_ioctl_cmd_get_governor,            /**< Get frequency governor policy (dmclk_governor_t*) */
+    dmclk_ioctl_cmd_governor_sample,         /**< Feed a CPU load sample to the governor (dmclk_load_sample_t*) */
+    dmclk_ioctl_cmd_set_opp,                 /**< Switch to a precomputed operating point by index (uint32_t*) */
+    dmclk_ioctl_cmd_get_opp,                 /**< Get index of the active operating point, DMCLK_OPP_NONE if none (uint32_t*) */
+    dmclk_ioctl_cmd_get_opp_count,           /**< Get number of operating points from the configuration (uint32_t*) */
+    dmclk_ioctl_cmd_add_qos_request,         /**< Add a minimum/maximum frequency request (dmclk_qos_request_t*) */
+    dmclk_ioctl_cmd_remove_qos_request,      /**< Remove a frequency request (dmclk_qos_request_t*) */
+    dmclk_ioctl_cmd_get_qos_limits,          /**< Get the aggregated frequency limits (dmclk_qos_limits_t*) */
+    dmclk_ioctl_cmd_enter_stop,              /**< Enter STOP mode, return at full speed after wakeup (NULL) */
+    dmclk_ioctl_cmd_get_hse_failures,        /**< Get number of external oscillator failures detected by CSS (uint32_t*) */
+    dmclk_ioctl_cmd_set_mco,                 /**< Route a clock to a clock output pin (dmclk_mco_config_t*) */
+    dmclk_ioctl_cmd_get_mco,                 /**< Get the clock routed to the output given in @c output (dmclk_mco_config_t*) */
+    dmclk_ioctl_cmd_reconfigure_async,       /**< Start a reconfiguration finished by later polls (dmclk_async_request_t*) */
+    dmclk_ioctl_cmd_get_async_status,        /**< Get the state of the last asynchronous reconfiguration (dmclk_async_status_t*) */
+    dmclk_ioctl_cmd_cancel_async,            /**< Abandon the pending asynchronous reconfiguration (NULL) */
+    dmclk_ioctl_cmd_process_events,          /**< Do the work deferred from the clock interrupts, e.g. HSE failure recovery (NULL) */
 
     dmclk_ioctl_cmd_max
 
 } dmclk_ioctl_cmd_t;
 
+/**
+ * @brief Clock change notification events
+ */
+typedef enum
+{
+    dmclk_notify_pre_change = 0,    /**< Clock is about to change - quiesce DMA, stop transfers */
+    dmclk_notify_post_change,       /**< Clock has changed, also by a failed change - recompute baud rates and prescalers */
+    dmclk_notify_abort,             /**< Announced change was vetoed or failed - resume at the old rate */
+} dmclk_notify_event_t;
+
+/**
+ * @brief Data passed to clock change notifiers
+ */
+typedef struct
+{
+    dmclk_frequency_t old_frequency;    /**< Frequency before the change in Hz */
+    dmclk_frequency_t new_frequency;    /**< Target (pre-change) or achieved (post-change) frequency in Hz */
+} dmclk_notify_data_t;
+
+/**
+ * @brief Clock change notifier callback
+ *
+ * A non-zero return value from #dmclk_notify_pre_change vetoes the change: notifiers that
+ * were already called receive #dmclk_notify_abort and the clock is left untouched.
+ * The return value is ignored for the other events.
+ */
+typedef int (*dmclk_notifier_callback_t)(dmclk_notify_event_t event, const dmclk_notify_data_t* data, void* user_data);
+
+/**
+ * @brief Clock change notifier block
+ *
+ * The block is owned by the caller and must stay valid until it is unregistered.
+ */
+typedef struct dmclk_notifier
+{
+    dmclk_notifier_callback_t callback;     /**< Function called on clock change events */
+    void* user_data;                        /**< User pointer passed to the callback */
+    int priority;                           /**< Notifiers with higher priority are called first */
+    struct dmclk_notifier* next;            /**< Internal - managed by dmclk */
+} dmclk_notifier_t;
+
+/**
+ * @brief Frequency governor policies
+ */
+typedef enum
+{
+    dmclk_governor_none = 0,        /**< No governor - the target only changes on set commands */
+    dmclk_governor_performance,     /**< Always run at the maximum governor frequency */
+    dmclk_governor_powersave,       /**< Always run at the minimum governor frequency */
+    dmclk_governor_ondemand,        /**< Jump to the maximum under load, scale down proportionally when idle */
+    dmclk_governor_conservative,    /**< Step gradually up and down following the load */
+} dmclk_governor_t;
+
+/**
+ * @brief CPU load sample fed to the governor
+ *
+ * Typically produced by the RTOS idle hook, which measures the time spent in WFI
+ * (e.g. with the DWT cycle counter) and reports busy = period - idle.
+ */
+typedef struct
+{
+    uint32_t busy_us;               /**< Time the CPU was busy during the sample in microseconds */
+    uint32_t period_us;             /**< Length of the sample in microseconds */
+} dmclk_load_sample_t;
+
+/**
+ * @brief Kind of a frequency QoS request
+ */
+typedef enum
+{
+    dmclk_qos_min_frequency = 0,    /**< Clock must not run slower than the requested frequency */
+    dmclk_qos_max_frequency,        /**< Clock must not run faster than the requested frequency */
+} dmclk_qos_type_t;
+
+/**
+ * @brief Frequency QoS request block
+ *
+ * The block is owned by the caller and serves as the handle of the request - it must
+ * stay valid and unmodified until it is removed.
+ */
+typedef struct dmclk_qos_request
+{
+    dmclk_qos_type_t type;                  /**< Minimum or maximum request */
+    dmclk_frequency_t frequency;            /**< Requested limit in Hz */
+    struct dmclk_qos_request* next;         /**< Internal - managed by dmclk */
+} dmclk_qos_request_t;
+
+/**
+ * @brief Aggregated frequency QoS limits
+ *
+ * The target frequency is raised to @c min_frequency and then capped at @c max_frequency,
+ * so maximum requests win when requests conflict.
+ */
+typedef struct
+{
+    dmclk_frequency_t min_frequency;        /**< Highest of the minimum requests, 0 if there is none */
+    dmclk_frequency_t max_frequency;        /**< Lowest of the maximum requests, DMCLK_QOS_NO_LIMIT if there is none */
+} dmclk_qos_limits_t;
+
+/**
+ * @brief Clock output (MCO) configuration
+ */
+typedef struct
+{
+    uint32_t output;                        /**< Clock output number, 1 to DMCLK_MCO_COUNT */
+    dmclk_mco_source_t source;              /**< Clock routed to the pin */
+    uint32_t divider;                       /**< Output divider, 1 to 5 */
+} dmclk_mco_config_t;
+
+/**
+ * @brief State of the asynchronous reconfiguration
+ */
+typedef enum
+{
+    dmclk_async_idle = 0,           /**< No asynchronous reconfiguration was started */
+    dmclk_async_pending,            /**< Waiting for the oscillator / PLL - write commands are refused with -EBUSY */
+    dmclk_async_done,               /**< The last one completed, the new configuration runs */
+    dmclk_async_failed,             /**< The last one failed or was cancelled, the configuration is unchanged */
+} dmclk_async_status_t;
+
+/**
+ * @brief Completion callback of an asynchronous reconfiguration
+ *
+ * Called from the task that completed the reconfiguration (process_events,
+ * cancel_async or any write command) after the clock change
+ * notifiers and after the context was unlocked, so it may issue commands. Never
+ * called before the reconfigure_async command returned.
+ *
+ * @param result 0 if the new configuration runs, negative errno value otherwise
+ * @param frequency Frequency (HCLK) the clock runs at now in Hz
+ * @param user_data User pointer of the request
+ */
+typedef void (*dmclk_async_callback_t)(int result, dmclk_frequency_t frequency, void* user_data);
+
+/**
+ * @brief Asynchronous reconfiguration request, copied by dmclk
+ */
+typedef struct
+{
+    dmclk_frequency_t target_frequency;     /**< New target frequency in Hz, 0 to reapply the current configuration */
+    dmclk_async_callback_t callback;        /**< Completion callback, NULL to poll with dmclk_ioctl_cmd_process_events */
+    void* user_data;                        /**< User pointer passed to the callback */
+} dmclk_async_request_t;
+
+/**
+ * @brief Binary device record read through a handle opened with #DMCLK_O_BINARY
+ *
+ * Fixed layout in the byte order and alignment of the target. The record is a
+ * consistent snapshot - all fields describe the same configuration generation.
+ */
+typedef struct
+{
+    uint32_t version;                       /**< #DMCLK_INFO_VERSION */
+    uint32_t size;                          /**< sizeof(dmclk_info_t) */
+    uint32_t generation;                    /**< Configuration generation, changes with every update */
+    uint32_t source;                        /**< Clock source (#dmclk_source_t) */
+    uint32_t bus_policy;                    /**< Bus policy (#dmclk_bus_policy_t) */
+    uint32_t current_opp;                   /**< Active operating point or DMCLK_OPP_NONE */
+    dmclk_frequency_t frequency;            /**< Current frequency (HCLK) in Hz */
+    dmclk_frequency_t target_frequency;     /**< Configured target frequency in Hz */
+    dmclk_frequency_t tolerance;            /**< Configured tolerance in Hz */
+    dmclk_frequency_t oscillator_frequency; /**< External oscillator frequency in Hz */
+    dmclk_clock_tree_t clock_tree;          /**< Clocks of the running plan */
+    uint32_t clock_changes;                 /**< Clock tree updates since the context was created */
+    uint32_t hse_failures;                  /**< External oscillator failures detected by the Clock Security System */
+} dmclk_info_t;
+
+/**
+ * @brief Maximum frequency limit reported when there is no maximum request
+ */
+#define DMCLK_QOS_NO_LIMIT  UINT64_MAX
+
 #endif // DMCLK_H
\ No newline at end of file
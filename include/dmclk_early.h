@@ -0,0 +1,40 @@
+#ifndef DMCLK_EARLY_H
+#define DMCLK_EARLY_H
+
+#include "dmclk_port.h"
+
+/**
+ * @brief Early clock bring-up for the boot code
+ *
+ * Everything that runs before dmclk is loaded - loading and decompressing
+ * modules, parsing ini files - runs from the reset clock unless the boot code
+ * raises it first. dmclk_early_init() does that without the DMOD loader: it is
+ * a plain function of the dmclk_early static library (see src/port/CMakeLists.txt)
+ * that only writes the clock registers, with no ini parsing, no solver and no
+ * heap.
+ *
+ * The plan is normally baked at build time by tools/plangen:
+ *
+ * @code
+ * #include "dmclk_early.h"
+ * #include "dmclk_static_config.h"
+ *
+ * static const dmclk_port_plan_t boot_plan = DMCLK_STATIC_PLAN;
+ *
+ * int main(void)
+ * {
+ *     dmclk_early_init(&boot_plan);
+ *     // load modules at full speed
+ * }
+ * @endcode
+ *
+ * When dmclk_dmdrvi_create() later solves the same plan, the port adopts the
+ * running configuration (dmclk_port_adopt_plan()) instead of switching the
+ * clock again.
+ *
+ * @param plan  Plan to apply, calculated for the same port and MCU series
+ * @return      0 on success, non-zero on failure (the core keeps its current clock)
+ */
+int dmclk_early_init(const dmclk_port_plan_t* plan);
+
+#endif // DMCLK_EARLY_H
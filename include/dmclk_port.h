@@ -14,12 +14,373 @@ typedef uint64_t dmclk_frequency_t;
  */
 typedef uint64_t dmclk_time_us_t;
 
+/**
+ * @brief Frequencies of the clock tree derived from the system clock (all in Hz)
+ */
+typedef struct
+{
+    dmclk_frequency_t sysclk;           /**< System clock (SYSCLK) */
+    dmclk_frequency_t hclk;             /**< AHB clock - core, memories and DMA */
+    dmclk_frequency_t pclk1;            /**< APB1 (low-speed) peripheral clock */
+    dmclk_frequency_t pclk2;            /**< APB2 (high-speed) peripheral clock */
+    dmclk_frequency_t apb1_timer;       /**< Clock of timers on APB1 (2 x PCLK1 when APB1 is divided) */
+    dmclk_frequency_t apb2_timer;       /**< Clock of timers on APB2 (2 x PCLK2 when APB2 is divided) */
+    dmclk_frequency_t pll_vco;          /**< Main PLL VCO output, 0 when the PLL is not running */
+    dmclk_frequency_t pll_q;            /**< Main PLL Q output - 48 MHz domain (USB, SDIO, RNG), 0 when the PLL is not running */
+    dmclk_frequency_t i2s;              /**< I2S clock from PLLI2S, 0 when PLLI2S is not running */
+    dmclk_frequency_t sai;              /**< SAI clock from PLLSAI, 0 when PLLSAI is not running */
+    dmclk_frequency_t lcd;              /**< LCD-TFT pixel clock from PLLSAI, 0 when PLLSAI is not running */
+    uint32_t oscillators;               /**< Running oscillators and PLLs (DMCLK_OSC_* flags) */
+} dmclk_clock_tree_t;
+
+#define DMCLK_OSC_INTERNAL      (1U << 0)   /**< Internal high-speed RC oscillator (HSI) */
+#define DMCLK_OSC_EXTERNAL      (1U << 1)   /**< External high-speed oscillator (HSE) */
+#define DMCLK_OSC_PLL           (1U << 2)   /**< Main PLL */
+#define DMCLK_OSC_PLLI2S        (1U << 3)   /**< Audio PLL (PLLI2S) */
+#define DMCLK_OSC_PLLSAI        (1U << 4)   /**< SAI / LCD-TFT PLL (PLLSAI) */
+
+/**
+ * @brief Peripheral clock domains driven by dedicated PLLs (PLLI2S and PLLSAI)
+ *
+ * A frequency of 0 leaves the output unused. The dedicated PLLs share their input
+ * with the main PLL, so they are solved together with every plan and keep running
+ * across frequency changes of the core clock. Hibernation plans stop them.
+ */
+typedef struct
+{
+    dmclk_frequency_t i2s_frequency;    /**< I2S clock (PLLI2S R output) */
+    dmclk_frequency_t i2s_tolerance;    /**< Tolerance of the I2S clock */
+    dmclk_frequency_t sai_frequency;    /**< SAI clock (PLLSAI Q output after DIVQ) */
+    dmclk_frequency_t lcd_frequency;    /**< LCD-TFT pixel clock (PLLSAI R output after DIVR) */
+    dmclk_frequency_t pllsai_tolerance; /**< Tolerance of both PLLSAI outputs */
+} dmclk_peripheral_clocks_t;
+
+/**
+ * @brief Clock routed to a clock output pin (MCO)
+ *
+ * Not every output can select every clock - see dmclk_port_configure_mco().
+ */
+typedef enum
+{
+    dmclk_mco_source_off = 0,           /**< Output disabled, pin released */
+    dmclk_mco_source_sysclk,            /**< System clock (SYSCLK) */
+    dmclk_mco_source_internal,          /**< Internal high-speed oscillator (HSI) */
+    dmclk_mco_source_external,          /**< External high-speed oscillator (HSE) */
+    dmclk_mco_source_pll,               /**< Main PLL output */
+    dmclk_mco_source_plli2s,            /**< PLLI2S output */
+} dmclk_mco_source_t;
+
+/**
+ * @brief Read-only clock state shared with hot paths and interrupt handlers
+ *
+ * The port updates the block at every clock transition. @c sequence is odd while an
+ * update is in progress, so readers retry until they observe the same even value
+ * before and after copying (see dmclk_shared_read()). @c generation is incremented
+ * once per completed transition, letting consumers cache derived values (baud
+ * divisors, tick reloads) and detect that they are stale with a single load.
+ */
+typedef struct
+{
+    volatile uint32_t sequence;         /**< Sequence counter, odd while the block is being updated */
+    volatile uint32_t generation;       /**< Number of completed clock transitions */
+    dmclk_clock_tree_t tree;            /**< Clock tree valid for @c generation */
+} dmclk_shared_t;
+
+/**
+ * @brief Number of 32-bit words reserved for port specific plan data
+ */
+#define DMCLK_PORT_PLAN_WORDS   16
+
+/**
+ * @brief Precomputed clock configuration
+ *
+ * Produced by dmclk_port_plan_internal() / dmclk_port_plan_external() without touching
+ * the hardware and later applied by dmclk_port_apply_plan(). Applying a plan is only a
+ * sequence of register writes - no solver runs on that path. The content of @c data
+ * is private to the port.
+ */
+typedef struct
+{
+    dmclk_frequency_t frequency;                /**< Core clock (HCLK) frequency the plan results in */
+    uint32_t data[DMCLK_PORT_PLAN_WORDS];       /**< Port specific register images */
+} dmclk_port_plan_t;
+
+/**
+ * @brief Policy for dividing the peripheral buses
+ */
+typedef enum
+{
+    dmclk_bus_policy_performance = 0,           /**< APB buses as fast as their limits allow */
+    dmclk_bus_policy_powersave,                 /**< APB buses divided as much as possible */
+} dmclk_bus_policy_t;
+
+/**
+ * @brief Asynchronous clock events reported by the port
+ */
+typedef enum
+{
+    dmclk_port_event_hse_failure = 0,           /**< External oscillator failed - call dmclk_port_css_recover() from a task */
+} dmclk_port_event_t;
+
+/**
+ * @brief Callback receiving port events
+ *
+ * Called from the RCC interrupt after the port published the new clock tree in the
+ * shared block - never from the NMI. The callback may only record the event.
+ */
+typedef void (*dmclk_port_event_callback_t)(dmclk_port_event_t event, void* user_data);
+
 dmod_dmclk_port_api(1.0, int, _configure_internal, ( dmclk_frequency_t target_freq, dmclk_frequency_t tolerance) );
 dmod_dmclk_port_api(1.0, int, _configure_external, ( dmclk_frequency_t target_freq, dmclk_frequency_t tolerance, dmclk_frequency_t oscillator_freq) );
 dmod_dmclk_port_api(1.0, int, _configure_hibernatation, ( dmclk_frequency_t target_freq, dmclk_frequency_t tolerance, dmclk_frequency_t oscillator_freq) );
 dmod_dmclk_port_api(1.0, void, _delay_us, ( dmclk_time_us_t time_us) );
 dmod_dmclk_port_api(1.0, dmclk_frequency_t, _get_current_frequency, ( void ) );
 
+/**
+ * @brief Read the complete clock tree as currently configured in hardware.
+ *
+ * @param tree  Output clock tree
+ * @return      0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api(1.0, int, _get_clock_tree, ( dmclk_clock_tree_t* tree ) );
+
+/**
+ * @brief Get the shared clock state block.
+ *
+ * The returned pointer stays valid for the lifetime of the port module, so it can be
+ * fetched once and then read from any context, including interrupt handlers.
+ *
+ * @return Pointer to the shared clock state
+ */
+dmod_dmclk_port_api(1.0, const dmclk_shared_t*, _get_shared, ( void ) );
+
+/**
+ * @brief Take a consistent snapshot of the shared clock state.
+ *
+ * Lock-free and safe to call from interrupt handlers. Never blocks - it only retries
+ * when an update was in progress while copying.
+ *
+ * @param shared  Shared block from dmclk_port_get_shared()
+ * @param tree    Output clock tree
+ * @return        Generation of the returned clock tree
+ */
+static inline uint32_t dmclk_shared_read(const dmclk_shared_t* shared, dmclk_clock_tree_t* tree)
+{
+    uint32_t sequence;
+    uint32_t generation;
+    do
+    {
+        while ((sequence = shared->sequence) & 1U)
+        {
+            /* Update in progress */
+        }
+        __sync_synchronize();
+        *tree = shared->tree;
+        generation = shared->generation;
+        __sync_synchronize();
+    } while (shared->sequence != sequence);
+    return generation;
+}
+
+/**
+ * @brief Calculate a plan running from the internal oscillator, without touching the hardware.
+ *
+ * @param target_freq  Target system clock frequency in Hz
+ * @param tolerance    Tolerance in Hz
+ * @param bus_policy   Peripheral bus policy
+ * @param plan         Output plan
+ * @return             0 on success, non-zero if the target cannot be reached
+ */
+dmod_dmclk_port_api(1.0, int, _plan_internal, ( dmclk_frequency_t target_freq, dmclk_frequency_t tolerance, dmclk_bus_policy_t bus_policy, dmclk_port_plan_t* plan ) );
+
+/**
+ * @brief Calculate a plan running from the external oscillator, without touching the hardware.
+ *
+ * @param target_freq      Target system clock frequency in Hz
+ * @param tolerance        Tolerance in Hz
+ * @param oscillator_freq  External oscillator frequency in Hz
+ * @param bus_policy       Peripheral bus policy
+ * @param plan             Output plan
+ * @return                 0 on success, non-zero if the target cannot be reached
+ */
+dmod_dmclk_port_api(1.0, int, _plan_external, ( dmclk_frequency_t target_freq, dmclk_frequency_t tolerance, dmclk_frequency_t oscillator_freq, dmclk_bus_policy_t bus_policy, dmclk_port_plan_t* plan ) );
+
+/**
+ * @brief Calculate a low-power plan, without touching the hardware.
+ *
+ * The core runs directly from an oscillator divided down to the target, with
+ * everything not needed for it (PLL, unused oscillators) switched off and the
+ * regulator in its lowest-power scale.
+ *
+ * @param target_freq      Target core clock frequency in Hz
+ * @param tolerance        Tolerance in Hz
+ * @param oscillator_freq  External oscillator frequency in Hz, 0 if only the internal one may be used
+ * @param plan             Output plan
+ * @return                 0 on success, non-zero if the target cannot be reached
+ */
+dmod_dmclk_port_api(1.0, int, _plan_hibernation, ( dmclk_frequency_t target_freq, dmclk_frequency_t tolerance, dmclk_frequency_t oscillator_freq, dmclk_port_plan_t* plan ) );
+
+/**
+ * @brief Set the clocks of the peripheral domains driven by dedicated PLLs.
+ *
+ * Plans calculated afterwards also configure the dedicated PLLs for @p clocks.
+ * Nothing is applied to the hardware until the next dmclk_port_apply_plan().
+ *
+ * @param clocks  Requested peripheral clocks, NULL to stop using the dedicated PLLs
+ * @return        0 on success, non-zero if the port has no dedicated PLLs
+ */
+dmod_dmclk_port_api(1.0, int, _set_peripheral_clocks, ( const dmclk_peripheral_clocks_t* clocks ) );
+
+/**
+ * @brief Route a clock to a clock output pin, including the pin setup.
+ *
+ * On STM32F4/F7 output 1 (MCO1, PA8) can select the internal oscillator, the
+ * external oscillator or the main PLL, and output 2 (MCO2, PC9) SYSCLK, PLLI2S,
+ * the external oscillator or the main PLL.
+ *
+ * @param output   Clock output number, starting from 1
+ * @param source   Clock to output, #dmclk_mco_source_off to release the pin
+ * @param divider  Output divider (1 to 5 on STM32)
+ * @return         0 on success, non-zero if the output, source or divider is not supported
+ */
+dmod_dmclk_port_api(1.0, int, _configure_mco, ( uint32_t output, dmclk_mco_source_t source, uint32_t divider ) );
+
+/**
+ * @brief Apply a plan calculated by one of the dmclk_port_plan_*() functions.
+ *
+ * @param plan  Plan to apply
+ * @return      0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api(1.0, int, _apply_plan, ( const dmclk_port_plan_t* plan ) );
+
+/**
+ * @brief Take over a plan that is already running.
+ *
+ * Used when the clock was configured before the module was loaded - by the boot
+ * code through dmclk_early_init() or by a previous instance of the module. If the
+ * hardware already runs @p plan, the port records it as the applied plan and
+ * publishes the clock tree without touching the hardware.
+ *
+ * @param plan  Plan expected to be running
+ * @return      0 if the plan was adopted, non-zero if the hardware runs something else
+ */
+dmod_dmclk_port_api(1.0, int, _adopt_plan, ( const dmclk_port_plan_t* plan ) );
+
+/**
+ * @brief Decode the running clock configuration into a plan.
+ *
+ * Reads the live clock registers back into a plan that stands in for @p request,
+ * the plan solved for the configuration. What cannot be read from the hardware
+ * (oscillator frequency, tolerance, bus policy) comes from @p request. The caller
+ * checks plan->frequency against its own tolerance and passes the plan to
+ * dmclk_port_adopt_plan() to keep the running clock instead of re-applying it.
+ *
+ * @param request  Plan solved for the configuration
+ * @param plan     Decoded plan, plan->frequency is the running HCLK
+ * @return         0 if the running configuration is equivalent to @p request (same
+ *                 oscillator and peripheral clocks, valid bus and Flash settings),
+ *                 non-zero otherwise
+ */
+dmod_dmclk_port_api(1.0, int, _read_active_plan, ( const dmclk_port_plan_t* request, dmclk_port_plan_t* plan ) );
+
+/**
+ * @brief Enter STOP mode and return at full speed after wakeup.
+ *
+ * The plan applied last is kept by the port and restored right after wakeup
+ * with dmclk_port_exit_stop(). Call it with interrupts disabled - the pending
+ * wakeup interrupt then runs only after the clock has been restored.
+ *
+ * @return  0 on success, non-zero if the clock could not be restored
+ */
+dmod_dmclk_port_api(1.0, int, _enter_stop, ( void ) );
+
+/**
+ * @brief Restore the clock plan that was active before STOP mode.
+ *
+ * Idempotent - returns immediately when the clock is already restored, so it can
+ * also be called as the first thing in a wakeup interrupt handler.
+ *
+ * @return  0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api(1.0, int, _exit_stop, ( void ) );
+
+/**
+ * @brief Register the callback receiving asynchronous port events.
+ *
+ * @param callback   Callback, NULL to unregister
+ * @param user_data  User pointer passed to the callback
+ */
+dmod_dmclk_port_api(1.0, void, _set_event_callback, ( dmclk_port_event_callback_t callback, void* user_data ) );
+
+/**
+ * @brief Clock Security System interrupt handler.
+ *
+ * Must be called from the NMI handler of the application. The hardware already moved
+ * the core to the internal oscillator; the handler only acknowledges the event and
+ * pends the RCC interrupt, from which #dmclk_port_event_hse_failure is reported.
+ */
+dmod_dmclk_port_api(1.0, void, _css_irq_handler, ( void ) );
+
+/**
+ * @brief Recover from an external oscillator failure.
+ *
+ * Called from task context after #dmclk_port_event_hse_failure, serialized with the
+ * other plan changes. Moves to the best internal-oscillator plan near the lost
+ * frequency and publishes it in the shared block.
+ *
+ * @return  0 if an internal-oscillator plan was applied, 1 if the core stays on the
+ *          plain internal oscillator, negative if no failure is pending
+ */
+dmod_dmclk_port_api(1.0, int, _css_recover, ( void ) );
+
+/**
+ * @brief Apply a plan without waiting for the oscillator and PLL.
+ *
+ * Starts the external oscillator and locks the PLL of @p plan with their ready
+ * interrupts enabled and returns right away - the core keeps running at the old
+ * frequency meanwhile (or from the internal oscillator when the PLL driving it
+ * has to be relocked). The switch is never finished here: it is finished from task
+ * context by dmclk_port_advance_async(). Until then dmclk_port_apply_plan() is refused.
+ *
+ * @param plan  Plan to apply, copied by the port
+ * @return      0 if the switch was started, non-zero if another one is pending or @p plan is invalid
+ */
+dmod_dmclk_port_api(1.0, int, _apply_plan_async, ( const dmclk_port_plan_t* plan ) );
+
+/**
+ * @brief Continue the plan started with dmclk_port_apply_plan_async().
+ *
+ * Called from task context, serialized with the other plan changes, typically after
+ * the ready interrupt woke the caller. Once the oscillator and PLL are ready the rest
+ * of the switch (Over-Drive, dedicated PLLs, SYSCLK) is applied before returning.
+ * The switch fails if the oscillator and PLL are not ready within the port timeout
+ * (on STM32 ASYNC_STARTUP_TIMEOUT_MS, timed with the DWT cycle counter) or the
+ * oscillator failed meanwhile.
+ *
+ * @return  1 while waiting, 0 if the plan was applied, negative if it failed or
+ *          no switch is pending
+ */
+dmod_dmclk_port_api(1.0, int, _advance_async, ( void ) );
+
+/**
+ * @brief Abandon the plan started with dmclk_port_apply_plan_async().
+ *
+ * The ready interrupts are disabled and the clock keeps running as it is.
+ *
+ * @return  0 if a pending switch was abandoned, non-zero if none was pending
+ */
+dmod_dmclk_port_api(1.0, int, _cancel_async, ( void ) );
+
+/**
+ * @brief Clock ready interrupt handler.
+ *
+ * Must be called from the RCC interrupt handler of the application (RCC_IRQHandler
+ * on STM32). It acknowledges the ready interrupts of dmclk_port_apply_plan_async() -
+ * the application may wake the task finishing the switch from there - and reports the
+ * oscillator failures handed over by dmclk_port_css_irq_handler().
+ */
+dmod_dmclk_port_api(1.0, void, _rcc_irq_handler, ( void ) );
+
 /**
  * @brief Busy-wait delay for a given number of seconds and return consumed CPU cycles.
  *
@@ -38,4 +399,5 @@ dmod_dmclk_port_api(1.0, dmclk_frequency_t, _get_current_frequency, ( void ) );
 dmod_dmclk_port_api(1.0, uint64_t, _delay, ( uint32_t seconds ) );
 
 
+
 #endif // DMCLK_PORT_H
\ No newline at end of file
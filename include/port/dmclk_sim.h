@@ -0,0 +1,159 @@
+#ifndef DMCLK_SIM_H
+#define DMCLK_SIM_H
+
+#include <stdint.h>
+
+/**
+ * @brief Control interface of the simulation port (DMCLK_MCU_SERIES=sim)
+ *
+ * The simulation port models the RCC, FLASH, PWR and GPIO registers of an
+ * STM32F7 in RAM, so dmclk.c and stm32_common.c run unchanged on the host.
+ * Time advances by one tick per iteration of a register polling loop: ready
+ * flags rise after the modelled start-up times, and every tick checks the
+ * running configuration against the limits of the part. A tick stands for one
+ * microsecond: the cycle counter timing asynchronous switches advances by the
+ * modelled HCLK in MHz per tick.
+ */
+
+/* Modelled start-up times in ticks (well below the polling timeouts) */
+#define DMCLK_SIM_HSI_STARTUP_TICKS     2U
+#define DMCLK_SIM_HSE_STARTUP_TICKS     200U
+#define DMCLK_SIM_PLL_LOCK_TICKS        100U
+#define DMCLK_SIM_OVERDRIVE_TICKS       50U
+#define DMCLK_SIM_CLOCKSWITCH_TICKS     1U
+
+/* Sequences real hardware would reject or run out of specification */
+#define DMCLK_SIM_VIOLATION_FLASH_LATENCY   (1U << 0)   /**< HCLK needs more Flash wait states than configured */
+#define DMCLK_SIM_VIOLATION_OVERDRIVE       (1U << 1)   /**< HCLK above 180 MHz without Over-Drive */
+#define DMCLK_SIM_VIOLATION_VOLTAGE_SCALE   (1U << 2)   /**< HCLK above the limit of the regulator voltage scale */
+#define DMCLK_SIM_VIOLATION_APB_LIMIT       (1U << 3)   /**< PCLK1 or PCLK2 above its limit */
+#define DMCLK_SIM_VIOLATION_PLL_RECONFIGURED (1U << 4)  /**< RCC_PLLCFGR changed while the PLL was running */
+#define DMCLK_SIM_VIOLATION_PLL_IN_USE      (1U << 5)   /**< PLL stopped while SYSCLK was running from it */
+
+/**
+ * @brief Counters collected by the model since the last dmclk_sim_reset()
+ */
+typedef struct
+{
+    uint64_t ticks;                 /**< Iterations of register polling loops */
+    uint64_t delay_us;              /**< Time requested from dmclk_port_delay_us() */
+    uint32_t hse_startups;          /**< HSE start-ups completed */
+    uint32_t pll_locks;             /**< Main PLL lock sequences completed */
+    uint32_t clock_switches;        /**< SYSCLK source switches completed */
+    uint32_t reg_reads;             /**< Register reads of the common code */
+    uint32_t reg_writes;            /**< Register writes of the common code */
+    uint32_t violations;            /**< Number of violations (each onset counted once) */
+    uint32_t violation_mask;        /**< DMCLK_SIM_VIOLATION_* flags seen so far */
+    uint32_t rcc_interrupts;        /**< RCC interrupts delivered (ready flags or set pending by the port) */
+} dmclk_sim_stats_t;
+
+/**
+ * @brief Register blocks of the modelled part
+ */
+typedef enum
+{
+    dmclk_sim_block_rcc,
+    dmclk_sim_block_flash,
+    dmclk_sim_block_pwr,
+    dmclk_sim_block_gpioa,
+    dmclk_sim_block_gpioc,
+    dmclk_sim_block_unknown,
+} dmclk_sim_block_t;
+
+/**
+ * @brief Register access recorded by the trace
+ */
+typedef struct
+{
+    uint32_t sequence;              /**< Position of the access since dmclk_sim_trace_start() */
+    uint8_t write;                  /**< 1 for a write, 0 for a read */
+    uint8_t block;                  /**< Register block (dmclk_sim_block_t) */
+    uint16_t offset;                /**< Register offset within the block, e.g. RCC_CFGR_OFFSET */
+    uint32_t value;                 /**< Value read or written */
+} dmclk_sim_trace_entry_t;
+
+/**
+ * @brief Return the registers to their reset values and clear the counters
+ */
+void dmclk_sim_reset(void);
+
+/**
+ * @brief Advance the model
+ *
+ * Stands for the time the application runs between clock operations. Pending
+ * HSE / PLL ready interrupts (RCC_CIR) and an RCC interrupt set pending by the
+ * port are delivered here by calling dmclk_port_rcc_irq_handler(), never from
+ * within a polling loop.
+ *
+ * @param ticks Number of ticks to advance
+ */
+void dmclk_sim_tick(uint32_t ticks);
+
+/**
+ * @brief Read the counters collected by the model
+ *
+ * @param stats Output counters
+ */
+void dmclk_sim_get_stats(dmclk_sim_stats_t* stats);
+
+/**
+ * @brief Read a register of the modelled part
+ *
+ * The read is neither counted nor traced.
+ *
+ * @param block Register block
+ * @param offset Register offset within the block, e.g. RCC_CFGR_OFFSET
+ *
+ * @return uint32_t Register value, 0 for an offset outside the block
+ */
+uint32_t dmclk_sim_read_register(dmclk_sim_block_t block, uint16_t offset);
+
+/**
+ * @brief Make the external oscillator fail
+ *
+ * HSE stops and does not start again until dmclk_sim_repair_hse(). With the
+ * Clock Security System enabled the model switches SYSCLK to HSI like the
+ * hardware does and calls dmclk_port_css_irq_handler() in place of the NMI,
+ * followed by the RCC interrupt the handler sets pending. The context recovers
+ * at the next writer or dmclk_ioctl_cmd_process_events.
+ */
+void dmclk_sim_inject_hse_failure(void);
+
+/**
+ * @brief Allow the external oscillator to start again
+ */
+void dmclk_sim_repair_hse(void);
+
+/**
+ * @brief Make the main PLL fail to lock
+ *
+ * A locked PLL keeps running, but it does not lock again until
+ * dmclk_sim_repair_pll(). The next plan that relocks it times out after SYSCLK
+ * was moved to HSI for the relock, like a PLL whose input is out of range.
+ */
+void dmclk_sim_inject_pll_failure(void);
+
+/**
+ * @brief Allow the main PLL to lock again
+ */
+void dmclk_sim_repair_pll(void);
+
+/**
+ * @brief Record the register accesses of the common code
+ *
+ * Accesses beyond the capacity of the buffer are counted but not stored.
+ * The model itself (ready flags, SWS) is not part of the trace.
+ *
+ * @param buffer Trace buffer
+ * @param capacity Number of entries in the buffer
+ */
+void dmclk_sim_trace_start(dmclk_sim_trace_entry_t* buffer, uint32_t capacity);
+
+/**
+ * @brief Stop recording
+ *
+ * @return uint32_t Number of accesses since dmclk_sim_trace_start()
+ */
+uint32_t dmclk_sim_trace_stop(void);
+
+#endif // DMCLK_SIM_H
@@ -15,6 +15,9 @@
 #define RCC_PLLCFGR_OFFSET      0x04U   /* PLL configuration register */
 #define RCC_CFGR_OFFSET         0x08U   /* Clock configuration register */
 #define RCC_CIR_OFFSET          0x0CU   /* Clock interrupt register */
+#define RCC_PLLI2SCFGR_OFFSET   0x84U   /* PLLI2S configuration register */
+#define RCC_PLLSAICFGR_OFFSET   0x88U   /* PLLSAI configuration register */
+#define RCC_DCKCFGR_OFFSET      0x8CU   /* Dedicated clocks configuration register (DCKCFGR1 on STM32F7) */
 
 /* RCC_CR register bits */
 #define RCC_CR_HSION            (1U << 0)   /* HSI oscillator ON */
@@ -22,8 +25,23 @@
 #define RCC_CR_HSEON            (1U << 16)  /* HSE oscillator ON */
 #define RCC_CR_HSERDY           (1U << 17)  /* HSE oscillator ready */
 #define RCC_CR_HSEBYP           (1U << 18)  /* HSE oscillator bypass */
+#define RCC_CR_CSSON            (1U << 19)  /* Clock security system enable */
 #define RCC_CR_PLLON            (1U << 24)  /* Main PLL enable */
 #define RCC_CR_PLLRDY           (1U << 25)  /* Main PLL ready */
+#define RCC_CR_PLLI2SON         (1U << 26)  /* PLLI2S enable */
+#define RCC_CR_PLLI2SRDY        (1U << 27)  /* PLLI2S ready */
+#define RCC_CR_PLLSAION         (1U << 28)  /* PLLSAI enable */
+#define RCC_CR_PLLSAIRDY        (1U << 29)  /* PLLSAI ready */
+
+/* RCC_CIR register bits */
+#define RCC_CIR_HSERDYF         (1U << 3)   /* HSE ready interrupt flag */
+#define RCC_CIR_PLLRDYF         (1U << 4)   /* Main PLL ready interrupt flag */
+#define RCC_CIR_CSSF            (1U << 7)   /* Clock security system interrupt flag (HSE failure) */
+#define RCC_CIR_HSERDYIE        (1U << 11)  /* HSE ready interrupt enable */
+#define RCC_CIR_PLLRDYIE        (1U << 12)  /* Main PLL ready interrupt enable */
+#define RCC_CIR_HSERDYC         (1U << 19)  /* HSE ready interrupt clear */
+#define RCC_CIR_PLLRDYC         (1U << 20)  /* Main PLL ready interrupt clear */
+#define RCC_CIR_CSSC            (1U << 23)  /* Clock security system interrupt clear */
 
 /* RCC_PLLCFGR register bits and masks */
 #define RCC_PLLCFGR_PLLM_Pos    0U
@@ -36,6 +54,31 @@
 #define RCC_PLLCFGR_PLLQ_Pos    24U
 #define RCC_PLLCFGR_PLLQ_Msk    (0xFU << RCC_PLLCFGR_PLLQ_Pos)
 
+/* RCC_PLLI2SCFGR and RCC_PLLSAICFGR register bits and masks (same layout, the input
+ * is the main PLL source divided by PLLM on parts where PLLM is shared, e.g.
+ * STM32F42x/F43x/F469/F479 and STM32F7) */
+#define RCC_PLLxCFGR_PLLN_Pos   6U
+#define RCC_PLLxCFGR_PLLN_Msk   (0x1FFU << RCC_PLLxCFGR_PLLN_Pos)
+#define RCC_PLLxCFGR_PLLQ_Pos   24U
+#define RCC_PLLxCFGR_PLLQ_Msk   (0xFU << RCC_PLLxCFGR_PLLQ_Pos)
+#define RCC_PLLxCFGR_PLLR_Pos   28U
+#define RCC_PLLxCFGR_PLLR_Msk   (0x7U << RCC_PLLxCFGR_PLLR_Pos)
+
+#define RCC_PLLxCFGR_PLLQ_MIN   2U
+#define RCC_PLLxCFGR_PLLQ_MAX   15U
+#define RCC_PLLxCFGR_PLLR_MIN   2U
+#define RCC_PLLxCFGR_PLLR_MAX   7U
+
+/* RCC_DCKCFGR register bits and masks - post-dividers behind PLLI2S and PLLSAI */
+#define RCC_DCKCFGR_PLLI2SDIVQ_Pos  0U
+#define RCC_DCKCFGR_PLLI2SDIVQ_Msk  (0x1FU << RCC_DCKCFGR_PLLI2SDIVQ_Pos)
+#define RCC_DCKCFGR_PLLSAIDIVQ_Pos  8U      /* SAI clock = PLLSAI Q / (DIVQ + 1) */
+#define RCC_DCKCFGR_PLLSAIDIVQ_Msk  (0x1FU << RCC_DCKCFGR_PLLSAIDIVQ_Pos)
+#define RCC_DCKCFGR_PLLSAIDIVR_Pos  16U     /* LCD-TFT clock = PLLSAI R / 2^(DIVR + 1) */
+#define RCC_DCKCFGR_PLLSAIDIVR_Msk  (0x3U << RCC_DCKCFGR_PLLSAIDIVR_Pos)
+
+#define RCC_DCKCFGR_PLLSAIDIVQ_MAX  32U
+
 /* RCC_APB1ENR register bits (needed to clock the PWR peripheral before its
  * registers, e.g. for Over-Drive, can be accessed) */
 #define RCC_APB1ENR_PWREN       (1U << 28)
@@ -62,6 +105,31 @@
 #define RCC_CFGR_PPRE2_Pos      13U
 #define RCC_CFGR_PPRE2_Msk      (0x7U << RCC_CFGR_PPRE2_Pos)
 
+/* Clock outputs: MCO1 on PA8 selects HSI, LSE, HSE or PLL, MCO2 on PC9 selects
+ * SYSCLK, PLLI2S, HSE or PLL. Prescaler codes: 0xx = /1, 100 = /2 ... 111 = /5 */
+#define RCC_CFGR_MCO1_Pos       21U
+#define RCC_CFGR_MCO1_Msk       (0x3U << RCC_CFGR_MCO1_Pos)
+#define RCC_CFGR_MCO1PRE_Pos    24U
+#define RCC_CFGR_MCO1PRE_Msk    (0x7U << RCC_CFGR_MCO1PRE_Pos)
+#define RCC_CFGR_MCO2PRE_Pos    27U
+#define RCC_CFGR_MCO2PRE_Msk    (0x7U << RCC_CFGR_MCO2PRE_Pos)
+#define RCC_CFGR_MCO2_Pos       30U
+#define RCC_CFGR_MCO2_Msk       (0x3U << RCC_CFGR_MCO2_Pos)
+
+#define RCC_CFGR_MCO1_HSI       0U
+#define RCC_CFGR_MCO1_HSE       2U
+#define RCC_CFGR_MCO1_PLL       3U
+#define RCC_CFGR_MCO2_SYSCLK    0U
+#define RCC_CFGR_MCO2_PLLI2S    1U
+#define RCC_CFGR_MCO2_HSE       2U
+#define RCC_CFGR_MCO2_PLL       3U
+
+#define RCC_CFGR_MCOPRE_MAX     5U
+
+/* RCC_AHB1ENR register bits - GPIO ports carrying the MCO pins */
+#define RCC_AHB1ENR_GPIOAEN     (1U << 0)
+#define RCC_AHB1ENR_GPIOCEN     (1U << 2)
+
 /* Flash interface register offsets */
 #define FLASH_ACR_OFFSET        0x00U   /* Flash access control register */
 
@@ -75,6 +143,7 @@
 /* Clock source definitions */
 #define HSI_VALUE               16000000U   /* HSI oscillator frequency in Hz */
 #define LSI_VALUE               32000U      /* LSI oscillator frequency in Hz */
+#define PLL48_MAX_FREQ          48000000U   /* USB OTG FS, SDIO and RNG clock limit in Hz */
 
 /* Timeout values for clock operations */
 #define HSI_STARTUP_TIMEOUT     5000U
@@ -82,6 +151,19 @@
 #define PLL_STARTUP_TIMEOUT     5000U
 #define CLOCKSWITCH_TIMEOUT     5000U
 #define OVERDRIVE_STARTUP_TIMEOUT 5000U
+#define ASYNC_STARTUP_TIMEOUT_MS  100U      /* HSE start-up and PLL lock of an asynchronous switch, in ms */
+
+/* NVIC - the CSS handler (NMI) hands its work over to the RCC interrupt */
+#define NVIC_ISPR_BASE          0xE000E200UL    /* Interrupt set-pending registers */
+#define RCC_IRQ_NUMBER          5U              /* RCC global interrupt on STM32F4 and STM32F7 */
+
+/**
+ * @brief Flash latency table entry - wait states required up to a SYSCLK frequency
+ */
+typedef struct {
+    uint32_t max_freq;
+    uint32_t latency;
+} stm32_flash_latency_t;
 
 /**
  * @brief RCC register structure (common layout)
@@ -91,11 +173,40 @@ typedef struct {
     volatile uint32_t PLLCFGR;      /* 0x04 - PLL configuration register */
     volatile uint32_t CFGR;         /* 0x08 - Clock configuration register */
     volatile uint32_t CIR;          /* 0x0C - Clock interrupt register */
-    volatile uint32_t RESERVED0[12]; /* 0x10..0x3C - resets/enables not needed here */
+    volatile uint32_t RESERVED0[8]; /* 0x10..0x2C - peripheral resets */
+    volatile uint32_t AHB1ENR;      /* 0x30 - AHB1 peripheral clock enable register */
+    volatile uint32_t RESERVED2[3]; /* 0x34..0x3C - AHB2/AHB3 enables */
     volatile uint32_t APB1ENR;      /* 0x40 - APB1 peripheral clock enable register */
+    volatile uint32_t RESERVED1[16]; /* 0x44..0x80 - enables, backup domain and reset flags */
+    volatile uint32_t PLLI2SCFGR;   /* 0x84 - PLLI2S configuration register */
+    volatile uint32_t PLLSAICFGR;   /* 0x88 - PLLSAI configuration register */
+    volatile uint32_t DCKCFGR;      /* 0x8C - Dedicated clocks configuration register */
     /* Additional registers would follow but are not needed for basic clock config */
 } RCC_TypeDef;
 
+/**
+ * @brief GPIO port register structure, needed to route the MCO pins
+ */
+typedef struct {
+    volatile uint32_t MODER;        /* 0x00 - Port mode register */
+    volatile uint32_t OTYPER;       /* 0x04 - Output type register */
+    volatile uint32_t OSPEEDR;      /* 0x08 - Output speed register */
+    volatile uint32_t PUPDR;        /* 0x0C - Pull-up/pull-down register */
+    volatile uint32_t IDR;          /* 0x10 - Input data register */
+    volatile uint32_t ODR;          /* 0x14 - Output data register */
+    volatile uint32_t BSRR;         /* 0x18 - Bit set/reset register */
+    volatile uint32_t LCKR;         /* 0x1C - Configuration lock register */
+    volatile uint32_t AFR[2];       /* 0x20..0x24 - Alternate function low/high registers */
+} GPIO_TypeDef;
+
+#define GPIO_MODER_INPUT        0x0U
+#define GPIO_MODER_AF           0x2U
+#define GPIO_OSPEEDR_VERY_HIGH  0x3U
+#define GPIO_AF_MCO             0x0U    /* MCO1 (PA8) and MCO2 (PC9) are AF0 */
+
+#define MCO1_PIN                8U      /* PA8 */
+#define MCO2_PIN                9U      /* PC9 */
+
 /**
  * @brief Flash register structure
  */
@@ -114,7 +225,10 @@ typedef struct {
     volatile uint32_t CSR1;         /* 0x04 - Power control/status register 1 */
 } PWR_TypeDef;
 
-/* PWR_CR1 register bits */
+/* PWR_CR1 register bits (PWR_CR on STM32F4 - same positions) */
+#define PWR_CR1_LPDS            (1U << 0)   /* Low-power regulator in STOP mode */
+#define PWR_CR1_PDDS            (1U << 1)   /* Enter STANDBY instead of STOP on deep sleep */
+#define PWR_CR1_VOS_Pos         14U         /* Regulator voltage scaling, family specific width */
 #define PWR_CR1_ODEN            (1U << 16)  /* Over-Drive enable */
 #define PWR_CR1_ODSWEN          (1U << 17)  /* Over-Drive switching enable */
 
@@ -10,6 +10,9 @@
 /* Memory base addresses for STM32F4 */
 #define STM32F4_FLASH_BASE      0x40023C00U
 #define STM32F4_RCC_BASE        0x40023800U
+#define STM32F4_PWR_BASE        0x40007000U
+#define STM32F4_GPIOA_BASE      0x40020000U  /* MCO1 pin */
+#define STM32F4_GPIOC_BASE      0x40020800U  /* MCO2 pin */
 
 /* STM32F4 clock frequency limits */
 #define STM32F4_MAX_SYSCLK      168000000U  /* Maximum system clock for STM32F4 */
@@ -17,6 +20,13 @@
 #define STM32F4_MAX_PCLK1       42000000U   /* Maximum APB1 clock */
 #define STM32F4_MAX_PCLK2       84000000U   /* Maximum APB2 clock */
 
+/* Regulator voltage scaling (PWR_CR.VOS). Only bit 14 is common to all F4
+ * lines: 1 = scale 1 (full speed), 0 = scale 2 (max 144 MHz, lower consumption).
+ * VOS can only be changed while the PLL is off. */
+#define STM32F4_PWR_VOS_Msk             (0x1U << PWR_CR1_VOS_Pos)
+#define STM32F4_PWR_VOS_PERFORMANCE     (0x1U << PWR_CR1_VOS_Pos)
+#define STM32F4_PWR_VOS_LOW_POWER       (0x0U << PWR_CR1_VOS_Pos)
+
 /* PLL parameters for STM32F4 */
 #define STM32F4_PLLM_MIN        2U
 #define STM32F4_PLLM_MAX        63U
@@ -35,10 +45,7 @@
 
 /* Flash latency settings for STM32F4 (depends on voltage range and frequency) */
 /* These are for voltage range 2.7V-3.6V */
-static const struct {
-    uint32_t max_freq;
-    uint32_t latency;
-} stm32f4_flash_latency[] = {
+static const stm32_flash_latency_t stm32f4_flash_latency[] = {
     {30000000U, 0U},
     {60000000U, 1U},
     {90000000U, 2U},
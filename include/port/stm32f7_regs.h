@@ -11,6 +11,8 @@
 #define STM32F7_FLASH_BASE      0x40023C00U
 #define STM32F7_RCC_BASE        0x40023800U
 #define STM32F7_PWR_BASE        0x40007000U
+#define STM32F7_GPIOA_BASE      0x40020000U  /* MCO1 pin */
+#define STM32F7_GPIOC_BASE      0x40020800U  /* MCO2 pin */
 
 /* STM32F7 clock frequency limits */
 #define STM32F7_MAX_SYSCLK      216000000U  /* Maximum system clock for STM32F7 */
@@ -25,6 +27,13 @@
 #define STM32F7_MAX_PCLK1       54000000U   /* Maximum APB1 clock */
 #define STM32F7_MAX_PCLK2       108000000U  /* Maximum APB2 clock */
 
+/* Regulator voltage scaling (PWR_CR1.VOS): 11 = scale 1, 10 = scale 2,
+ * 01 = scale 3 (max 144 MHz, lowest consumption). VOS takes effect when the
+ * PLL is enabled, so it is written while the PLL is off. */
+#define STM32F7_PWR_VOS_Msk             (0x3U << PWR_CR1_VOS_Pos)
+#define STM32F7_PWR_VOS_PERFORMANCE     (0x3U << PWR_CR1_VOS_Pos)
+#define STM32F7_PWR_VOS_LOW_POWER       (0x1U << PWR_CR1_VOS_Pos)
+
 /* PLL parameters for STM32F7 */
 #define STM32F7_PLLM_MIN        2U
 #define STM32F7_PLLM_MAX        63U
@@ -43,10 +52,7 @@
 
 /* Flash latency settings for STM32F7 (depends on voltage range and frequency) */
 /* These are for voltage range 2.7V-3.6V */
-static const struct {
-    uint32_t max_freq;
-    uint32_t latency;
-} stm32f7_flash_latency[] = {
+static const stm32_flash_latency_t stm32f7_flash_latency[] = {
     {30000000U, 0U},
     {60000000U, 1U},
     {90000000U, 2U},
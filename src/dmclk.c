@@ -3,12 +3,26 @@
 #include "dmdrvi.h"
 #include "dmini.h"
 #include "dmclk_port.h"
+#include "dmclk_governor.h"
 #include <errno.h>
 #include <string.h>
+#ifdef DMCLK_STATIC_CONFIG
+#   include "dmclk_static_config.h"
+#endif
 
 // Magic set to DCLK
 #define DMCLK_CONTEXT_MAGIC    0x44434C4B
 
+// Size of the info text returned by dmclk_dmdrvi_read()
+#define DMCLK_INFO_TEXT_SIZE   256
+
+// Cached info text states - the seqlock sequence is even when stable, so these never match it
+#define DMCLK_INFO_NONE        1U
+#define DMCLK_INFO_BUSY        3U
+
+// Port events recorded in interrupt context and handled by the next writer - see process_events()
+#define DMCLK_EVENT_HSE_FAILURE    (1U << 0)
+
 /**
  * @brief Configuration structure
  */
@@ -18,6 +32,25 @@ struct config
     dmclk_frequency_t tolerance;
     dmclk_frequency_t oscillator_frequency;
     dmclk_source_t source;
+    dmclk_bus_policy_t bus_policy;
+};
+
+/**
+ * @brief Operating point - configuration solved once at creation
+ */
+struct opp
+{
+    struct config config;              /**< Configuration the plan was solved for */
+    dmclk_port_plan_t plan;            /**< Precomputed register plan */
+};
+
+/**
+ * @brief Device handle - the format chosen at open
+ */
+struct handle
+{
+    dmdrvi_context_t context;          /**< Context the handle belongs to */
+    int binary;                        /**< Read the dmclk_info_t record instead of the info text */
 };
 
 /**
@@ -26,10 +59,55 @@ struct config
 struct dmdrvi_context
 {
     uint32_t magic;                    /**< Magic number for validation */
+    void* mutex;                       /**< Serializes writers (reconfiguration, notifier list) */
+    volatile uint32_t sequence;        /**< Seqlock counter for lock-free readers, odd during updates */
     struct config config;              /**< Configuration parameters */
     dmclk_frequency_t current_frequency;  /**< Current clock frequency in Hz */
+    dmclk_clock_tree_t clock_tree;     /**< Clock tree captured at the last configuration */
+    dmclk_notifier_t* notifiers;       /**< Clock change notifiers sorted by priority */
+    struct dmclk_governor governor;    /**< Load-driven frequency governor */
+    struct opp opps[DMCLK_MAX_OPPS];   /**< Operating points from the [dmclk.opp.N] sections */
+    uint32_t opp_count;                /**< Number of valid entries in @c opps */
+    uint32_t current_opp;              /**< Active operating point or DMCLK_OPP_NONE */
+    dmclk_qos_request_t* qos_requests; /**< Active frequency QoS requests */
+    dmclk_qos_limits_t qos_limits;     /**< Limits aggregated from @c qos_requests */
+    dmclk_frequency_t applied_target;  /**< Target the running plan was selected for, QoS limits included */
+    uint32_t hse_failures;             /**< External oscillator failures detected by the Clock Security System */
+    volatile uint32_t pending_events;  /**< DMCLK_EVENT_* reported by the port and not handled yet */
+    dmclk_mco_config_t mco[DMCLK_MCO_COUNT]; /**< Clock outputs, indexed by output number - 1 */
+    uint32_t clock_changes;            /**< Clock tree updates published since creation */
+    volatile uint32_t info_generation; /**< Sequence @c info was formatted at, or DMCLK_INFO_NONE / DMCLK_INFO_BUSY */
+    uint32_t info_length;              /**< Length of @c info */
+    char info[DMCLK_INFO_TEXT_SIZE];   /**< Cached info text */
+    struct handle handles[2];          /**< Text and binary (DMCLK_O_BINARY) device handles */
+    volatile uint32_t async_status;    /**< dmclk_async_status_t of the last asynchronous reconfiguration */
+    struct config async_config;        /**< Configuration committed when the pending reconfiguration completes */
+    uint32_t async_opp;                /**< Operating point committed with @c async_config */
+    dmclk_frequency_t async_target;    /**< Solver target of the pending reconfiguration */
+    dmclk_notify_data_t async_notify;  /**< Data sent with its pre-change notification */
+    dmclk_async_request_t async_request; /**< Completion callback of the pending reconfiguration */
+    dmclk_async_request_t async_completed; /**< Request whose callback is due, run by unlock_context() */
+    int async_result;                  /**< Result passed to the callback of @c async_completed */
+    dmclk_frequency_t async_frequency; /**< Frequency passed to the callback of @c async_completed */
 };
 
+#ifdef DMCLK_STATIC_CONFIG
+/*
+ * Configuration generated by tools/plangen from the DMCLK_STATIC_CONFIG ini file.
+ * The plans were solved at build time by the same port planner, so creating the
+ * context neither parses the ini file nor allocates memory.
+ */
+static const struct config static_config = DMCLK_STATIC_CONFIG_VALUES;
+static const struct dmclk_governor static_governor = DMCLK_STATIC_GOVERNOR;
+static const dmclk_port_plan_t static_plan = DMCLK_STATIC_PLAN;
+static const struct opp static_opps[DMCLK_MAX_OPPS] = DMCLK_STATIC_OPPS;
+static const dmclk_mco_config_t static_mcos[DMCLK_MCO_COUNT] = DMCLK_STATIC_MCOS;
+#ifdef DMCLK_STATIC_PERIPHERAL_CLOCKS
+static const dmclk_peripheral_clocks_t static_peripheral_clocks = DMCLK_STATIC_PERIPHERAL_CLOCKS;
+#endif
+static struct dmdrvi_context static_context;    /**< The only context of a static configuration build */
+#endif
+
 /**
  * @brief Validate DMDRVI context
  * 
@@ -39,220 +117,1977 @@ struct dmdrvi_context
  */
 static int is_valid_context(dmdrvi_context_t context)
 {
-    return (context != NULL && context->magic == DMCLK_CONTEXT_MAGIC);
+    return (context != NULL && context->magic == DMCLK_CONTEXT_MAGIC);
+}
+
+static void process_events(dmdrvi_context_t context);
+
+/**
+ * @brief Lock the context, also while an asynchronous reconfiguration is pending
+ * 
+ * For the commands driving or observing the pending reconfiguration. The work the
+ * clock interrupts left for task context is done first, which also advances the
+ * pending reconfiguration - see process_events().
+ * 
+ * @param context DMDRVI context
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int lock_context_pending(dmdrvi_context_t context)
+{
+    if (Dmod_Mutex_Lock(context->mutex) != 0)
+    {
+        DMOD_LOG_ERROR("Failed to lock dmclk context\n");
+        return -EBUSY;
+    }
+    process_events(context);
+    return 0;
+}
+
+/**
+ * @brief Lock the context for writing
+ * 
+ * Writers are serialized with a mutex held for the whole reconfiguration, including
+ * the PLL lock. Readers never take it - see read_begin(). While an asynchronous
+ * reconfiguration is pending the hardware belongs to it and writers are refused.
+ * 
+ * @param context DMDRVI context
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int lock_context(dmdrvi_context_t context)
+{
+    int ret = lock_context_pending(context);
+    if (ret == 0 && context->async_status == dmclk_async_pending)
+    {
+        // Nothing completed above, so no completion callback is due
+        Dmod_Mutex_Unlock(context->mutex);
+        ret = -EBUSY;
+    }
+    return ret;
+}
+
+/**
+ * @brief Unlock the context after writing
+ * 
+ * The completion callback of an asynchronous reconfiguration finished while the
+ * context was locked runs here, after the mutex was released, so it may issue
+ * commands itself.
+ * 
+ * @param context DMDRVI context
+ */
+static void unlock_context(dmdrvi_context_t context)
+{
+    dmclk_async_request_t completed = context->async_completed;
+    int result = context->async_result;
+    dmclk_frequency_t frequency = context->async_frequency;
+
+    context->async_completed.callback = NULL;
+    Dmod_Mutex_Unlock(context->mutex);
+    if (completed.callback != NULL)
+    {
+        completed.callback(result, frequency, completed.user_data);
+    }
+}
+
+/**
+ * @brief Begin publishing new state to readers
+ * 
+ * Only plain memory updates may happen between write_begin() and write_end() -
+ * the section runs with interrupts disabled so readers never wait for it.
+ * 
+ * @param context DMDRVI context
+ */
+static void write_begin(dmdrvi_context_t context)
+{
+    Dmod_EnterCritical();
+    context->sequence++;
+    __sync_synchronize();
+}
+
+/**
+ * @brief Finish publishing new state to readers
+ * 
+ * @param context DMDRVI context
+ */
+static void write_end(dmdrvi_context_t context)
+{
+    __sync_synchronize();
+    context->sequence++;
+    Dmod_ExitCritical();
+}
+
+/**
+ * @brief Begin a lock-free read of the context state
+ * 
+ * @param context DMDRVI context
+ * 
+ * @return uint32_t Sequence to pass to read_retry()
+ */
+static uint32_t read_begin(dmdrvi_context_t context)
+{
+    uint32_t sequence;
+    while ((sequence = context->sequence) & 1U)
+    {
+        // Update in progress on another core
+    }
+    __sync_synchronize();
+    return sequence;
+}
+
+/**
+ * @brief Check whether a lock-free read has to be repeated
+ * 
+ * @param context DMDRVI context
+ * @param sequence Sequence returned by read_begin()
+ * 
+ * @return int non-zero if the state changed while reading
+ */
+static int read_retry(dmdrvi_context_t context, uint32_t sequence)
+{
+    __sync_synchronize();
+    return context->sequence != sequence;
+}
+
+/**
+ * @brief Convert clock source enum to string
+ * 
+ * @param source Clock source
+ * 
+ * @return const char* String representation of clock source
+ */
+static const char* source_to_string(dmclk_source_t source)
+{
+    switch (source)
+    {
+        case dmclk_source_internal:
+            return "internal";
+        case dmclk_source_external:
+            return "external";
+        case dmclk_source_hibernation:
+            return "hibernation";
+        default:
+            return "unknown";
+    }
+}
+
+/**
+ * @brief Convert clock output source enum to string
+ * 
+ * @param source Clock output source
+ * 
+ * @return const char* String representation of the source
+ */
+static const char* mco_source_to_string(dmclk_mco_source_t source)
+{
+    switch (source)
+    {
+        case dmclk_mco_source_sysclk:
+            return "sysclk";
+        case dmclk_mco_source_internal:
+            return "internal";
+        case dmclk_mco_source_external:
+            return "external";
+        case dmclk_mco_source_pll:
+            return "pll";
+        case dmclk_mco_source_plli2s:
+            return "plli2s";
+        default:
+            return "off";
+    }
+}
+
+/**
+ * @brief Convert string to clock source enum
+ * 
+ * @param source_str String representation of clock source
+ * 
+ * @return dmclk_source_t Clock source enum
+ */
+static dmclk_source_t string_to_source(const char* source_str)
+{
+    if (source_str != NULL)
+    {
+        if (strcmp(source_str, "internal") == 0)
+        {
+            return dmclk_source_internal;
+        }
+        else if (strcmp(source_str, "external") == 0)
+        {
+            return dmclk_source_external;
+        }
+        else if (strcmp(source_str, "hibernation") == 0)
+        {
+            return dmclk_source_hibernation;
+        }
+    }
+    return dmclk_source_unkown;
+}
+
+#ifndef DMCLK_STATIC_CONFIG
+/**
+ * @brief Convert bus policy enum to string
+ * 
+ * @param policy Bus policy
+ * 
+ * @return const char* String representation of bus policy
+ */
+static const char* bus_policy_to_string(dmclk_bus_policy_t policy)
+{
+    return (policy == dmclk_bus_policy_powersave) ? "powersave" : "performance";
+}
+
+/**
+ * @brief Convert string to bus policy enum
+ * 
+ * @param policy_str String representation of bus policy
+ * 
+ * @return int Bus policy or -1 if the string is not recognized
+ */
+static int string_to_bus_policy(const char* policy_str)
+{
+    if (policy_str == NULL || strcmp(policy_str, "performance") == 0)
+    {
+        return dmclk_bus_policy_performance;
+    }
+    else if (strcmp(policy_str, "powersave") == 0)
+    {
+        return dmclk_bus_policy_powersave;
+    }
+    return -1;
+}
+
+/**
+ * @brief Convert string to clock output source enum
+ * 
+ * @param source_str String representation of the source
+ * 
+ * @return int Clock output source or -1 if the string is not recognized
+ */
+static int string_to_mco_source(const char* source_str)
+{
+    static const dmclk_mco_source_t sources[] = {
+        dmclk_mco_source_off,
+        dmclk_mco_source_sysclk,
+        dmclk_mco_source_internal,
+        dmclk_mco_source_external,
+        dmclk_mco_source_pll,
+        dmclk_mco_source_plli2s,
+    };
+    if (source_str == NULL)
+    {
+        return dmclk_mco_source_off;
+    }
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++)
+    {
+        if (strcmp(source_str, mco_source_to_string(sources[i])) == 0)
+        {
+            return sources[i];
+        }
+    }
+    return -1;
+}
+#endif // DMCLK_STATIC_CONFIG
+
+/**
+ * @brief Check configuration parameters
+ * 
+ * @param context DMDRVI context
+ * 
+ * @return int 0 if valid, non-zero otherwise
+ */
+static int check_config_parameters(struct config* cfg)
+{
+    if (cfg->target_frequency == 0)
+    {
+        DMOD_LOG_ERROR("Target frequency not set in configuration\n");
+        return -EINVAL;
+    }
+    else if (cfg->tolerance == 0)
+    {
+        DMOD_LOG_ERROR("Tolerance not set in configuration\n");
+        return -EINVAL;
+    }
+    else if (cfg->source == dmclk_source_unkown)
+    {
+        DMOD_LOG_ERROR("Clock source not set or unknown in configuration\n");
+        return -EINVAL;
+    }
+    else if(cfg->source == dmclk_source_external && cfg->oscillator_frequency == 0)
+    {
+        DMOD_LOG_ERROR("Oscillator frequency not set in configuration for external source\n");
+        return -EINVAL;
+    }
+    return 0;
+}
+
+/**
+ * @brief Solve a configuration into a register plan without touching the hardware
+ * 
+ * @param cfg Configuration to solve
+ * @param plan Output plan
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int plan_configuration(const struct config* cfg, dmclk_port_plan_t* plan)
+{
+    int ret;
+    switch (cfg->source)
+    {
+        case dmclk_source_internal:
+            ret = dmclk_port_plan_internal(cfg->target_frequency, cfg->tolerance, cfg->bus_policy, plan);
+            break;
+        case dmclk_source_external:
+            ret = dmclk_port_plan_external(cfg->target_frequency, cfg->tolerance, cfg->oscillator_frequency, cfg->bus_policy, plan);
+            break;
+        case dmclk_source_hibernation:
+            ret = dmclk_port_plan_hibernation(cfg->target_frequency, cfg->tolerance, cfg->oscillator_frequency, plan);
+            break;
+        default:
+            DMOD_LOG_ERROR("Clock source %s cannot be planned\n", source_to_string(cfg->source));
+            return -EINVAL;
+    }
+    if (ret != 0)
+    {
+        DMOD_LOG_ERROR("No clock configuration reaches %llu Hz +/- %llu Hz\n", cfg->target_frequency, cfg->tolerance);
+        return -ERANGE;
+    }
+    return 0;
+}
+
+/**
+ * @brief Route a clock to a clock output pin
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ * @param mco Clock output configuration
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int set_mco(dmdrvi_context_t context, const dmclk_mco_config_t* mco)
+{
+    if (dmclk_port_configure_mco(mco->output, mco->source, mco->divider) != 0)
+    {
+        DMOD_LOG_ERROR("Clock output %u cannot output %s divided by %u\n", (unsigned int)mco->output,
+                       mco_source_to_string(mco->source), (unsigned int)mco->divider);
+        return -EINVAL;
+    }
+
+    write_begin(context);
+    context->mco[mco->output - 1] = *mco;
+    write_end(context);
+    return 0;
+}
+
+#ifndef DMCLK_STATIC_CONFIG
+/**
+ * @brief Read configuration parameters from Dmini context
+ * 
+ * @param context DMDRVI context
+ * @param config Dmini context with configuration data
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int read_config_parameters(dmdrvi_context_t context, dmini_context_t config)
+{   
+    context->config.target_frequency = (dmclk_frequency_t)dmini_get_int(config, "dmclk", "target_frequency", 0);
+    context->config.tolerance = (dmclk_frequency_t)dmini_get_int(config, "dmclk", "tolerance", 0);
+    context->config.oscillator_frequency = (dmclk_frequency_t)dmini_get_int(config, "dmclk", "oscillator_frequency", 0);
+    context->config.source = string_to_source(dmini_get_string(config, "dmclk", "source", NULL));
+    int bus_policy = string_to_bus_policy(dmini_get_string(config, "dmclk", "bus", NULL));
+    if (bus_policy < 0)
+    {
+        DMOD_LOG_ERROR("Unknown bus policy in configuration\n");
+        return -EINVAL;
+    }
+    context->config.bus_policy = (dmclk_bus_policy_t)bus_policy;
+    
+    int ret = check_config_parameters(&context->config);
+    if (ret == 0)
+    {
+        ret = dmclk_governor_read_config(&context->governor, config, context->config.target_frequency);
+    }
+    if (ret == 0)
+    {
+        // The governor owns the target from now on - see docs/configuration.md
+        dmclk_frequency_t target_frequency = dmclk_governor_initial_target(&context->governor, context->config.target_frequency);
+        if (target_frequency != context->config.target_frequency)
+        {
+            DMOD_LOG_INFO("Governor starts at %llu Hz instead of the configured %llu Hz\n", target_frequency, context->config.target_frequency);
+        }
+        context->config.target_frequency = target_frequency;
+    }
+    return ret;
+}
+
+/**
+ * @brief Read the [dmclk.plli2s] and [dmclk.pllsai] sections and pass them to the port
+ * 
+ * Must run before any plan is calculated - the dedicated PLLs share their input
+ * with the main PLL and are solved together with every plan.
+ * 
+ * @param config Dmini context with configuration data
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int read_peripheral_clocks(dmini_context_t config)
+{
+    dmclk_peripheral_clocks_t clocks;
+    clocks.i2s_frequency = (dmclk_frequency_t)dmini_get_int(config, "dmclk.plli2s", "target_frequency", 0);
+    clocks.i2s_tolerance = (dmclk_frequency_t)dmini_get_int(config, "dmclk.plli2s", "tolerance", 0);
+    clocks.sai_frequency = (dmclk_frequency_t)dmini_get_int(config, "dmclk.pllsai", "sai_frequency", 0);
+    clocks.lcd_frequency = (dmclk_frequency_t)dmini_get_int(config, "dmclk.pllsai", "lcd_frequency", 0);
+    clocks.pllsai_tolerance = (dmclk_frequency_t)dmini_get_int(config, "dmclk.pllsai", "tolerance", 0);
+
+    if (clocks.i2s_frequency == 0 && clocks.sai_frequency == 0 && clocks.lcd_frequency == 0)
+    {
+        dmclk_port_set_peripheral_clocks(NULL);
+        return 0;
+    }
+    if (dmclk_port_set_peripheral_clocks(&clocks) != 0)
+    {
+        DMOD_LOG_ERROR("PLLI2S / PLLSAI clocks are not supported by the port\n");
+        return -ENOTSUP;
+    }
+    DMOD_LOG_INFO("Peripheral clocks: I2S %llu Hz, SAI %llu Hz, LCD-TFT %llu Hz\n",
+                  clocks.i2s_frequency, clocks.sai_frequency, clocks.lcd_frequency);
+    return 0;
+}
+
+/**
+ * @brief Read and apply the [dmclk.mcoN] sections
+ * 
+ * Runs once the clock is configured, so the selected clocks are already running.
+ * 
+ * @param context DMDRVI context
+ * @param config Dmini context with configuration data
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int read_mcos(dmdrvi_context_t context, dmini_context_t config)
+{
+    char section[16];
+
+    for (uint32_t output = 1; output <= DMCLK_MCO_COUNT; output++)
+    {
+        Dmod_SnPrintf(section, sizeof(section), "dmclk.mco%u", (unsigned int)output);
+        int source = string_to_mco_source(dmini_get_string(config, section, "source", NULL));
+        if (source < 0)
+        {
+            DMOD_LOG_ERROR("Unknown clock output source in [%s]\n", section);
+            return -EINVAL;
+        }
+
+        dmclk_mco_config_t mco = {
+            .output = output,
+            .source = (dmclk_mco_source_t)source,
+            .divider = (uint32_t)dmini_get_int(config, section, "divider", 1),
+        };
+        context->mco[output - 1] = mco;
+        if (mco.source != dmclk_mco_source_off && set_mco(context, &mco) != 0)
+        {
+            return -EINVAL;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Read and solve operating points from the [dmclk.opp.N] sections
+ * 
+ * Sections are numbered from 0 and read until the first missing one. Missing
+ * keys default to the values from the [dmclk] section.
+ * 
+ * @param context DMDRVI context
+ * @param config Dmini context with configuration data
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int read_opps(dmdrvi_context_t context, dmini_context_t config)
+{
+    char section[24];
+    const struct config* defaults = &context->config;
+
+    context->opp_count = 0;
+    context->current_opp = DMCLK_OPP_NONE;
+    for (uint32_t i = 0; ; i++)
+    {
+        Dmod_SnPrintf(section, sizeof(section), "dmclk.opp.%u", (unsigned int)i);
+        const char* source = dmini_get_string(config, section, "source", NULL);
+        if (source == NULL)
+        {
+            break;
+        }
+        if (i >= DMCLK_MAX_OPPS)
+        {
+            DMOD_LOG_ERROR("Too many operating points, at most %d are supported\n", DMCLK_MAX_OPPS);
+            return -ENOSPC;
+        }
+
+        struct opp* opp = &context->opps[i];
+        opp->config.source = string_to_source(source);
+        opp->config.target_frequency = (dmclk_frequency_t)dmini_get_int(config, section, "target_frequency", 0);
+        opp->config.tolerance = (dmclk_frequency_t)dmini_get_int(config, section, "tolerance", (int)defaults->tolerance);
+        opp->config.oscillator_frequency = (dmclk_frequency_t)dmini_get_int(config, section, "oscillator_frequency", (int)defaults->oscillator_frequency);
+        int bus_policy = string_to_bus_policy(dmini_get_string(config, section, "bus", bus_policy_to_string(defaults->bus_policy)));
+        if (bus_policy < 0)
+        {
+            DMOD_LOG_ERROR("Unknown bus policy in [%s]\n", section);
+            return -EINVAL;
+        }
+        opp->config.bus_policy = (dmclk_bus_policy_t)bus_policy;
+
+        if (check_config_parameters(&opp->config) != 0
+         || plan_configuration(&opp->config, &opp->plan) != 0)
+        {
+            DMOD_LOG_ERROR("Invalid operating point [%s]\n", section);
+            return -EINVAL;
+        }
+        DMOD_LOG_INFO("Operating point %u: %llu Hz from %s source\n", (unsigned int)i,
+                      opp->plan.frequency, source_to_string(opp->config.source));
+        context->opp_count = i + 1;
+    }
+    return 0;
+}
+#endif // DMCLK_STATIC_CONFIG
+
+/**
+ * @brief Register a clock change notifier
+ * 
+ * The notifier is inserted after all notifiers with the same or higher priority,
+ * so notifiers of equal priority are called in registration order.
+ * 
+ * @param context DMDRVI context
+ * @param notifier Notifier block to register
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int register_notifier(dmdrvi_context_t context, dmclk_notifier_t* notifier)
+{
+    if (notifier->callback == NULL)
+    {
+        DMOD_LOG_ERROR("Notifier without callback cannot be registered\n");
+        return -EINVAL;
+    }
+
+    dmclk_notifier_t** link = &context->notifiers;
+    for (dmclk_notifier_t* it = context->notifiers; it != NULL; it = it->next)
+    {
+        if (it == notifier)
+        {
+            DMOD_LOG_ERROR("Notifier is already registered\n");
+            return -EEXIST;
+        }
+    }
+    while (*link != NULL && (*link)->priority >= notifier->priority)
+    {
+        link = &(*link)->next;
+    }
+    notifier->next = *link;
+    *link = notifier;
+    return 0;
+}
+
+/**
+ * @brief Unregister a clock change notifier
+ * 
+ * @param context DMDRVI context
+ * @param notifier Notifier block to unregister
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int unregister_notifier(dmdrvi_context_t context, dmclk_notifier_t* notifier)
+{
+    for (dmclk_notifier_t** link = &context->notifiers; *link != NULL; link = &(*link)->next)
+    {
+        if (*link == notifier)
+        {
+            *link = notifier->next;
+            notifier->next = NULL;
+            return 0;
+        }
+    }
+    DMOD_LOG_ERROR("Notifier is not registered\n");
+    return -ENOENT;
+}
+
+/**
+ * @brief Call clock change notifiers
+ * 
+ * Notifiers are called in priority order until @p last is reached (exclusive),
+ * which allows sending #dmclk_notify_abort only to the notifiers that already
+ * received #dmclk_notify_pre_change.
+ * 
+ * @param context DMDRVI context
+ * @param event Event to send
+ * @param data Event data
+ * @param last Notifier at which to stop (NULL to call all of them)
+ */
+static void call_notifiers(dmdrvi_context_t context, dmclk_notify_event_t event, const dmclk_notify_data_t* data, const dmclk_notifier_t* last)
+{
+    for (dmclk_notifier_t* it = context->notifiers; it != NULL && it != last; it = it->next)
+    {
+        it->callback(event, data, it->user_data);
+    }
+}
+
+/**
+ * @brief Send pre-change notification
+ * 
+ * If any notifier vetoes the change, the notifiers that were already called
+ * receive #dmclk_notify_abort.
+ * 
+ * @param context DMDRVI context
+ * @param data Event data
+ * 
+ * @return int 0 if the change may proceed, non-zero if it was vetoed
+ */
+static int notify_pre_change(dmdrvi_context_t context, const dmclk_notify_data_t* data)
+{
+    for (dmclk_notifier_t* it = context->notifiers; it != NULL; it = it->next)
+    {
+        if (it->callback(dmclk_notify_pre_change, data, it->user_data) != 0)
+        {
+            call_notifiers(context, dmclk_notify_abort, data, it);
+            return -EBUSY;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Handle notifier registration commands
+ * 
+ * @param context DMDRVI context
+ * @param command IOCTL command
+ * @param arg Notifier block
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int update_notifiers(dmdrvi_context_t context, int command, void* arg)
+{
+    if (command == dmclk_ioctl_cmd_register_notifier)
+    {
+        return register_notifier(context, (dmclk_notifier_t*)arg);
+    }
+    return unregister_notifier(context, (dmclk_notifier_t*)arg);
+}
+
+/**
+ * @brief Apply the QoS limits to a target frequency
+ * 
+ * @param context DMDRVI context
+ * @param target_frequency Requested target frequency
+ * 
+ * @return dmclk_frequency_t Target raised to the minimum and capped at the maximum limit
+ */
+static dmclk_frequency_t qos_target(dmdrvi_context_t context, dmclk_frequency_t target_frequency)
+{
+    if (target_frequency < context->qos_limits.min_frequency)
+    {
+        target_frequency = context->qos_limits.min_frequency;
+    }
+    if (target_frequency > context->qos_limits.max_frequency)
+    {
+        target_frequency = context->qos_limits.max_frequency;
+    }
+    return target_frequency;
+}
+
+/**
+ * @brief Aggregate the active QoS requests
+ * 
+ * @param context DMDRVI context
+ * @param limits Output limits
+ */
+static void aggregate_qos(dmdrvi_context_t context, dmclk_qos_limits_t* limits)
+{
+    limits->min_frequency = 0;
+    limits->max_frequency = DMCLK_QOS_NO_LIMIT;
+    for (const dmclk_qos_request_t* it = context->qos_requests; it != NULL; it = it->next)
+    {
+        if (it->type == dmclk_qos_min_frequency && it->frequency > limits->min_frequency)
+        {
+            limits->min_frequency = it->frequency;
+        }
+        else if (it->type == dmclk_qos_max_frequency && it->frequency < limits->max_frequency)
+        {
+            limits->max_frequency = it->frequency;
+        }
+    }
+}
+
+/**
+ * @brief Publish the clock tree the port reports as running
+ * 
+ * @param context DMDRVI context
+ */
+static void capture_clock_tree(dmdrvi_context_t context)
+{
+    dmclk_clock_tree_t clock_tree;
+    dmclk_shared_read(dmclk_port_get_shared(), &clock_tree);
+
+    write_begin(context);
+    context->clock_tree = clock_tree;
+    context->current_frequency = clock_tree.hclk;
+    context->clock_changes++;
+    write_end(context);
+}
+
+/**
+ * @brief Configure the clock based on context parameters
+ * 
+ * Registered notifiers receive #dmclk_notify_pre_change before the hardware is touched
+ * and #dmclk_notify_post_change afterwards. A failure sends #dmclk_notify_abort, or
+ * #dmclk_notify_post_change with the frequency that runs if the clock moved anyway.
+ * 
+ * @param context DMDRVI context
+ * @param plan Precomputed plan to apply, NULL to solve the context configuration
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int configure(dmdrvi_context_t context, const dmclk_port_plan_t* plan)
+{
+    dmclk_port_plan_t new_plan;
+    dmclk_notify_data_t notify_data = {
+        .old_frequency = context->current_frequency,
+        .new_frequency = context->config.target_frequency,
+    };
+    dmclk_frequency_t applied_target = qos_target(context, context->config.target_frequency);
+    int ret = 0;
+
+    // Solve before anyone is notified, so a failed solve does not disturb the drivers
+    if (plan == NULL)
+    {
+        struct config cfg = context->config;
+        if (cfg.source != dmclk_source_hibernation)
+        {
+            // Hibernation is an explicit low-power request, QoS limits do not apply to it
+            cfg.target_frequency = qos_target(context, cfg.target_frequency);
+        }
+        ret = plan_configuration(&cfg, &new_plan);
+        if (ret != 0)
+        {
+            return ret;
+        }
+        applied_target = cfg.target_frequency;
+        plan = &new_plan;
+    }
+    notify_data.new_frequency = plan->frequency;
+
+    ret = notify_pre_change(context, &notify_data);
+    if (ret != 0)
+    {
+        DMOD_LOG_ERROR("Clock change to %llu Hz vetoed by notifier\n", notify_data.new_frequency);
+        return ret;
+    }
+
+    ret = dmclk_port_apply_plan(plan);
+    if (ret == 0)
+    {
+        DMOD_LOG_INFO("Clock configured successfully with source %s\n", source_to_string(context->config.source));
+        // Only a target that reached the hardware counts as applied, so a vetoed QoS change is retried
+        context->applied_target = applied_target;
+        capture_clock_tree(context);
+
+        notify_data.new_frequency = context->current_frequency;
+        call_notifiers(context, dmclk_notify_post_change, &notify_data, NULL);
+    }
+    else 
+    {
+        DMOD_LOG_ERROR("Failed to configure clock with source %s\n", source_to_string(context->config.source));
+
+        // The port may have failed after SYSCLK left the old plan (PLL relock or switch timeout)
+        capture_clock_tree(context);
+        if (context->current_frequency != notify_data.old_frequency)
+        {
+            // No target selected the rate that runs now, the next QoS change must not be skipped
+            context->applied_target = context->current_frequency;
+            notify_data.new_frequency = context->current_frequency;
+            call_notifiers(context, dmclk_notify_post_change, &notify_data, NULL);
+        }
+        else
+        {
+            call_notifiers(context, dmclk_notify_abort, &notify_data, NULL);
+        }
+    }
+    return ret;
+}
+
+/**
+ * @brief Configure the clock when the context is created
+ * 
+ * The clock may already run the solved plan - applied by the boot code with
+ * dmclk_early_init() or left by a previous instance of the module. The port then
+ * adopts it and the hardware is not touched. Otherwise the running configuration
+ * is decoded and kept as well when it is equivalent to the solved plan and its
+ * frequency is within the configured tolerance, e.g. a PLL locked by a
+ * bootloader with other dividers. Nobody can be registered for notifications
+ * yet, so none are sent in either case.
+ * 
+ * @param context DMDRVI context
+ * @param plan Precomputed plan, NULL to solve the context configuration
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int configure_initial(dmdrvi_context_t context, const dmclk_port_plan_t* plan)
+{
+    dmclk_port_plan_t new_plan;
+    dmclk_port_plan_t live_plan;
+    dmclk_frequency_t target = context->config.target_frequency;
+
+    if (plan == NULL)
+    {
+        int ret = plan_configuration(&context->config, &new_plan);
+        if (ret != 0)
+        {
+            return ret;
+        }
+        context->applied_target = context->config.target_frequency;
+        plan = &new_plan;
+    }
+
+    if (dmclk_port_adopt_plan(plan) == 0)
+    {
+        DMOD_LOG_INFO("Adopted the running clock configuration with source %s\n", source_to_string(context->config.source));
+        capture_clock_tree(context);
+        return 0;
+    }
+    if (dmclk_port_read_active_plan(plan, &live_plan) == 0
+     && live_plan.frequency + context->config.tolerance >= target
+     && live_plan.frequency <= target + context->config.tolerance
+     && dmclk_port_adopt_plan(&live_plan) == 0)
+    {
+        DMOD_LOG_INFO("Adopted the running clock configuration at %llu Hz with source %s\n", live_plan.frequency, source_to_string(context->config.source));
+        capture_clock_tree(context);
+        return 0;
+    }
+    return configure(context, plan);
+}
+
+/**
+ * @brief Switch to a precomputed operating point
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ * @param index Operating point index
+ * @param target_frequency Target frequency to report - the one the operating point was selected for
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int switch_opp(dmdrvi_context_t context, uint32_t index, dmclk_frequency_t target_frequency)
+{
+    struct config previous_config = context->config;
+    uint32_t previous_opp = context->current_opp;
+    const struct opp* opp = &context->opps[index];
+
+    write_begin(context);
+    context->config = opp->config;
+    context->config.target_frequency = target_frequency;
+    context->current_opp = index;
+    write_end(context);
+
+    int ret = configure(context, &opp->plan);
+    if (ret != 0)
+    {
+        write_begin(context);
+        context->config = previous_config;
+        context->current_opp = previous_opp;
+        write_end(context);
+    }
+    return ret;
+}
+
+/**
+ * @brief Handle the set operating point command
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ * @param index Operating point index
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int set_opp(dmdrvi_context_t context, uint32_t index)
+{
+    if (index >= context->opp_count)
+    {
+        DMOD_LOG_ERROR("Invalid operating point %u, %u are configured\n", (unsigned int)index, (unsigned int)context->opp_count);
+        return -EINVAL;
+    }
+
+    dmclk_frequency_t frequency = context->opps[index].plan.frequency;
+    if (qos_target(context, frequency) != frequency)
+    {
+        DMOD_LOG_ERROR("Operating point %u violates the frequency QoS limits\n", (unsigned int)index);
+        return -ERANGE;
+    }
+    return switch_opp(context, index, context->opps[index].config.target_frequency);
+}
+
+/**
+ * @brief Find the operating point best matching a target frequency
+ * 
+ * Operating points above the QoS maximum are skipped unless none is below it.
+ * 
+ * @param context DMDRVI context
+ * @param target_frequency Requested frequency
+ * 
+ * @return uint32_t Slowest operating point reaching the target, or the fastest allowed one
+ */
+static uint32_t find_opp(dmdrvi_context_t context, dmclk_frequency_t target_frequency)
+{
+    uint32_t best = DMCLK_OPP_NONE;
+    uint32_t fastest = DMCLK_OPP_NONE;
+    uint32_t slowest = 0;
+    target_frequency = qos_target(context, target_frequency);
+    for (uint32_t i = 0; i < context->opp_count; i++)
+    {
+        dmclk_frequency_t frequency = context->opps[i].plan.frequency;
+        if (frequency < context->opps[slowest].plan.frequency)
+        {
+            slowest = i;
+        }
+        if (frequency > context->qos_limits.max_frequency)
+        {
+            continue;
+        }
+        if (frequency >= target_frequency
+         && (best == DMCLK_OPP_NONE || frequency < context->opps[best].plan.frequency))
+        {
+            best = i;
+        }
+        if (fastest == DMCLK_OPP_NONE || frequency > context->opps[fastest].plan.frequency)
+        {
+            fastest = i;
+        }
+    }
+    if (best != DMCLK_OPP_NONE)
+    {
+        return best;
+    }
+    return (fastest != DMCLK_OPP_NONE) ? fastest : slowest;
+}
+
+/**
+ * @brief Reconfigure after the QoS limits changed
+ * 
+ * Nothing is done if the target resulting from the new limits is already applied.
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int apply_qos(dmdrvi_context_t context)
+{
+    if (context->current_opp != DMCLK_OPP_NONE)
+    {
+        uint32_t index = find_opp(context, context->config.target_frequency);
+        return (index == context->current_opp) ? 0 : switch_opp(context, index, context->config.target_frequency);
+    }
+    if (context->config.source == dmclk_source_hibernation
+     || qos_target(context, context->config.target_frequency) == context->applied_target)
+    {
+        return 0;
+    }
+    return configure(context, NULL);
+}
+
+/**
+ * @brief Handle frequency QoS request commands
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ * @param command IOCTL command
+ * @param request QoS request block
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int update_qos(dmdrvi_context_t context, int command, dmclk_qos_request_t* request)
+{
+    dmclk_qos_request_t** link = &context->qos_requests;
+    while (*link != NULL && *link != request)
+    {
+        link = &(*link)->next;
+    }
+
+    if (command == dmclk_ioctl_cmd_add_qos_request)
+    {
+        if (*link != NULL)
+        {
+            DMOD_LOG_ERROR("QoS request is already active\n");
+            return -EEXIST;
+        }
+        if (request->type > dmclk_qos_max_frequency || request->frequency == 0)
+        {
+            DMOD_LOG_ERROR("Invalid QoS request\n");
+            return -EINVAL;
+        }
+        request->next = context->qos_requests;
+        context->qos_requests = request;
+    }
+    else if (*link == NULL)
+    {
+        DMOD_LOG_ERROR("QoS request is not active\n");
+        return -ENOENT;
+    }
+    else
+    {
+        *link = request->next;
+        request->next = NULL;
+    }
+
+    dmclk_qos_limits_t limits;
+    aggregate_qos(context, &limits);
+    if (limits.min_frequency == context->qos_limits.min_frequency
+     && limits.max_frequency == context->qos_limits.max_frequency)
+    {
+        return 0;
+    }
+
+    write_begin(context);
+    context->qos_limits = limits;
+    write_end(context);
+
+    int ret = apply_qos(context);
+    if (ret != 0)
+    {
+        DMOD_LOG_ERROR("Failed to apply frequency QoS limits %llu - %llu Hz\n", limits.min_frequency, limits.max_frequency);
+    }
+    return ret;
+}
+
+/**
+ * @brief Enter STOP mode
+ * 
+ * The port restores the active plan right after wakeup, without running the
+ * solver, so notifiers are not involved - the clock tree is the same as before.
+ * If the plan cannot be restored, the core stays on HSI and the drivers receive
+ * #dmclk_notify_post_change with that rate.
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ * 
+ * @return int 0 on success, non-zero if the clock could not be restored
+ */
+static int enter_stop(dmdrvi_context_t context)
+{
+    dmclk_notify_data_t notify_data = {
+        .old_frequency = context->current_frequency,
+    };
+    int ret = dmclk_port_enter_stop();
+    if (ret != 0)
+    {
+        DMOD_LOG_ERROR("Failed to restore clock after STOP mode\n");
+        capture_clock_tree(context);
+        if (context->current_frequency != notify_data.old_frequency)
+        {
+            context->applied_target = context->current_frequency;
+            notify_data.new_frequency = context->current_frequency;
+            call_notifiers(context, dmclk_notify_post_change, &notify_data, NULL);
+        }
+        ret = -EIO;
+    }
+    return ret;
+}
+
+/**
+ * @brief Start an asynchronous reconfiguration
+ * 
+ * Solves and announces the change like configure(), then hands the plan to the
+ * port, which starts the oscillator and PLL and returns. The reconfiguration is
+ * advanced and completed by the next commands - see process_events().
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ * @param request Request, copied
+ * 
+ * @return int 0 if the reconfiguration was started, non-zero on failure
+ */
+static int reconfigure_async(dmdrvi_context_t context, const dmclk_async_request_t* request)
+{
+    struct config cfg = context->config;
+    uint32_t opp = DMCLK_OPP_NONE;
+    dmclk_port_plan_t plan;
+    int ret = 0;
+
+    if (request->target_frequency != 0)
+    {
+        cfg.target_frequency = request->target_frequency;
+        ret = check_config_parameters(&cfg);
+    }
+    else if (context->current_opp != DMCLK_OPP_NONE)
+    {
+        opp = context->current_opp;
+    }
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    struct config solved = cfg;
+    if (opp != DMCLK_OPP_NONE)
+    {
+        plan = context->opps[opp].plan;
+        solved.target_frequency = context->applied_target;
+    }
+    else
+    {
+        if (solved.source != dmclk_source_hibernation)
+        {
+            solved.target_frequency = qos_target(context, solved.target_frequency);
+        }
+        ret = plan_configuration(&solved, &plan);
+        if (ret != 0)
+        {
+            return ret;
+        }
+    }
+
+    dmclk_notify_data_t notify_data = {
+        .old_frequency = context->current_frequency,
+        .new_frequency = plan.frequency,
+    };
+    ret = notify_pre_change(context, &notify_data);
+    if (ret != 0)
+    {
+        DMOD_LOG_ERROR("Clock change to %llu Hz vetoed by notifier\n", notify_data.new_frequency);
+        return ret;
+    }
+
+    write_begin(context);
+    context->async_status = dmclk_async_pending;
+    context->async_config = cfg;
+    context->async_opp = opp;
+    context->async_target = solved.target_frequency;
+    context->async_notify = notify_data;
+    context->async_request = *request;
+    write_end(context);
+
+    // Never completed from here, so the callback runs after this command returned
+    if (dmclk_port_apply_plan_async(&plan) != 0)
+    {
+        DMOD_LOG_ERROR("Failed to start asynchronous clock reconfiguration\n");
+        write_begin(context);
+        context->async_status = dmclk_async_failed;
+        write_end(context);
+        call_notifiers(context, dmclk_notify_abort, &notify_data, NULL);
+        return -EIO;
+    }
+    return 0;
+}
+
+/**
+ * @brief Finish the pending asynchronous reconfiguration
+ * 
+ * On success the configuration is committed and the drivers receive
+ * #dmclk_notify_post_change. On failure the configuration is kept; the drivers
+ * receive #dmclk_notify_abort, or #dmclk_notify_post_change when the clock did
+ * not stay at the old rate (the PLL relock had already moved SYSCLK to HSI).
+ * The completion callback is left to unlock_context().
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ * @param applied Non-zero if the port applied the plan
+ */
+static void complete_async(dmdrvi_context_t context, int applied)
+{
+    if (context->async_status != dmclk_async_pending)
+    {
+        return;
+    }
+
+    dmclk_notify_data_t notify_data = context->async_notify;
+    dmclk_async_request_t request = context->async_request;
+    capture_clock_tree(context);
+
+    write_begin(context);
+    if (applied)
+    {
+        context->config = context->async_config;
+        context->current_opp = context->async_opp;
+        context->applied_target = context->async_target;
+    }
+    else if (context->current_frequency != notify_data.old_frequency)
+    {
+        context->applied_target = context->current_frequency;
+    }
+    context->async_status = applied ? dmclk_async_done : dmclk_async_failed;
+    write_end(context);
+
+    if (applied || context->current_frequency != notify_data.old_frequency)
+    {
+        notify_data.new_frequency = context->current_frequency;
+        call_notifiers(context, dmclk_notify_post_change, &notify_data, NULL);
+    }
+    else
+    {
+        call_notifiers(context, dmclk_notify_abort, &notify_data, NULL);
+    }
+
+    if (applied)
+    {
+        DMOD_LOG_INFO("Clock reconfigured to %llu Hz\n", context->current_frequency);
+    }
+    else
+    {
+        DMOD_LOG_ERROR("Asynchronous clock reconfiguration failed, running at %llu Hz\n", context->current_frequency);
+    }
+    context->async_completed = request;
+    context->async_result = applied ? 0 : -EIO;
+    context->async_frequency = context->current_frequency;
+}
+
+/**
+ * @brief Handle asynchronous port events
+ * 
+ * Runs in the RCC interrupt. An external oscillator failure is only recorded - the
+ * writer mutex cannot be taken here, so the recovery is left to process_events().
+ * 
+ * @param event Port event
+ * @param user_data DMDRVI context
+ */
+static void port_event_handler(dmclk_port_event_t event, void* user_data)
+{
+    dmdrvi_context_t context = (dmdrvi_context_t)user_data;
+    if (is_valid_context(context) && event == dmclk_port_event_hse_failure)
+    {
+        __sync_fetch_and_or(&context->pending_events, DMCLK_EVENT_HSE_FAILURE);
+    }
+}
+
+/**
+ * @brief Recover from an external oscillator failure
+ * 
+ * The hardware already moved the core to the internal oscillator. The port
+ * re-plans near the lost frequency, then the context follows and the drivers
+ * are told the new rates.
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ */
+static void recover_hse(dmdrvi_context_t context)
+{
+    dmclk_notify_data_t notify_data = {
+        .old_frequency = context->current_frequency,
+    };
+    if (dmclk_port_css_recover() < 0)
+    {
+        return;
+    }
+    capture_clock_tree(context);
+
+    write_begin(context);
+    context->config.source = dmclk_source_internal;
+    context->current_opp = DMCLK_OPP_NONE;
+    context->applied_target = context->current_frequency;
+    context->hse_failures++;
+    write_end(context);
+
+    DMOD_LOG_ERROR("External oscillator failed, running from the internal one at %llu Hz\n", context->current_frequency);
+    notify_data.new_frequency = context->current_frequency;
+    call_notifiers(context, dmclk_notify_post_change, &notify_data, NULL);
+}
+
+/**
+ * @brief Do the work the clock interrupts left for task context
+ * 
+ * Recovers from an external oscillator failure and advances the pending
+ * asynchronous reconfiguration, completing it once the port finished or gave up.
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ */
+static void process_events(dmdrvi_context_t context)
+{
+    uint32_t events = __sync_fetch_and_and(&context->pending_events, 0U);
+    if (events & DMCLK_EVENT_HSE_FAILURE)
+    {
+        if (context->async_status == dmclk_async_pending)
+        {
+            // HSE and the PLL were stopped by the hardware, the switch cannot complete
+            dmclk_port_cancel_async();
+            complete_async(context, 0);
+        }
+        recover_hse(context);
+    }
+    if (context->async_status == dmclk_async_pending)
+    {
+        int ret = dmclk_port_advance_async();
+        if (ret <= 0)
+        {
+            complete_async(context, ret == 0);
+        }
+    }
+}
+
+/**
+ * @brief Update configuration parameters in context
+ *
+ * @param cfg Configuration structure to update
+ * @param command IOCTL command
+ * @param arg Argument for the command
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int update_configuration(struct config* cfg, int command, void* arg)
+{
+    int ret = 0;
+    switch (command)
+    {
+        case dmclk_ioctl_cmd_set_target_frequency:
+            cfg->target_frequency = *(dmclk_frequency_t*)arg;
+            break;
+        case dmclk_ioctl_cmd_set_tolerance:
+            cfg->tolerance = *(dmclk_frequency_t*)arg;
+            break;
+        case dmclk_ioctl_cmd_set_oscillator_frequency:
+            cfg->oscillator_frequency = *(dmclk_frequency_t*)arg;
+            break;
+        case dmclk_ioctl_cmd_set_source:
+            cfg->source = *(dmclk_source_t*)arg;
+            break;
+        default:
+            DMOD_LOG_ERROR("Invalid configuration command %d in update_configuration\n", command);
+            ret = -EINVAL;
+            break;
+    }
+    if (ret == 0)
+    {
+        ret = check_config_parameters(cfg);
+    }
+    return ret;
+}
+
+/**
+ * @brief Replace the configuration and reconfigure the clock
+ * 
+ * The previous configuration is restored if the clock could not be reconfigured.
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ * @param new_config Validated configuration
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int apply_configuration(dmdrvi_context_t context, const struct config* new_config)
+{
+    struct config previous_config = context->config;
+    uint32_t previous_opp = context->current_opp;
+
+    write_begin(context);
+    context->config = *new_config;
+    context->current_opp = DMCLK_OPP_NONE;
+    write_end(context);
+
+    int ret = configure(context, NULL);
+    if (ret == 0)
+    {
+        DMOD_LOG_INFO("Clock reconfigured to %llu Hz\n", context->current_frequency);
+    }
+    else
+    {
+        write_begin(context);
+        context->config = previous_config;
+        context->current_opp = previous_opp;
+        write_end(context);
+    }
+    return ret;
+}
+
+/**
+ * @brief Switch the target frequency on behalf of the governor
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ * @param target_frequency New target frequency
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int apply_governor_target(dmdrvi_context_t context, dmclk_frequency_t target_frequency)
+{
+    if (context->opp_count > 0)
+    {
+        // With an operating point table the governor only moves between its entries
+        uint32_t index = find_opp(context, target_frequency);
+        return (index == context->current_opp) ? 0 : switch_opp(context, index, target_frequency);
+    }
+
+    dmclk_frequency_t previous_target = context->config.target_frequency;
+    if (target_frequency == previous_target)
+    {
+        return 0;
+    }
+
+    write_begin(context);
+    context->config.target_frequency = target_frequency;
+    context->current_opp = DMCLK_OPP_NONE;
+    write_end(context);
+
+    int ret = configure(context, NULL);
+    if (ret != 0)
+    {
+        DMOD_LOG_ERROR("Governor failed to switch to %llu Hz\n", target_frequency);
+        write_begin(context);
+        context->config.target_frequency = previous_target;
+        write_end(context);
+    }
+    return ret;
+}
+
+/**
+ * @brief Handle governor commands
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ * @param command IOCTL command
+ * @param arg Argument for the command
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int update_governor(dmdrvi_context_t context, int command, void* arg)
+{
+    int ret = 0;
+    dmclk_frequency_t target_frequency = context->config.target_frequency;
+
+    if (command == dmclk_ioctl_cmd_set_governor)
+    {
+        ret = dmclk_governor_set_policy(&context->governor, *(dmclk_governor_t*)arg);
+        if (ret == 0)
+        {
+            target_frequency = dmclk_governor_initial_target(&context->governor, target_frequency);
+        }
+    }
+    else if (context->governor.policy == dmclk_governor_none)
+    {
+        DMOD_LOG_ERROR("Load sample received but no governor is enabled\n");
+        ret = -ENOTSUP;
+    }
+    else
+    {
+        dmclk_governor_sample(&context->governor, (const dmclk_load_sample_t*)arg, target_frequency, &target_frequency);
+    }
+
+    if (ret == 0)
+    {
+        ret = apply_governor_target(context, target_frequency);
+    }
+    return ret;
+}
+
+/**
+ * @brief Copy a single field of the context state
+ * 
+ * @param context DMDRVI context
+ * @param command IOCTL command
+ * @param arg Argument for the command
+ * 
+ * @return int 0 on success, -EINVAL if @p command is not a read command
+ */
+static int read_field(dmdrvi_context_t context, int command, void* arg)
+{
+    int ret = 0;
+    switch (command)
+    {
+        case dmclk_ioctl_cmd_get_target_frequency:
+            *(dmclk_frequency_t*)arg = context->config.target_frequency;
+            break;
+        case dmclk_ioctl_cmd_get_tolerance:
+            *(dmclk_frequency_t*)arg = context->config.tolerance;
+            break;
+        case dmclk_ioctl_cmd_get_oscillator_frequency:
+            *(dmclk_frequency_t*)arg = context->config.oscillator_frequency;
+            break;
+        case dmclk_ioctl_cmd_get_source:
+            *(dmclk_source_t*)arg = context->config.source;
+            break;
+        case dmclk_ioctl_cmd_get_frequency:
+            *(dmclk_frequency_t*)arg = context->current_frequency;
+            break;
+        case dmclk_ioctl_cmd_get_clock_tree:
+            memcpy(arg, &context->clock_tree, sizeof(dmclk_clock_tree_t));
+            break;
+        case dmclk_ioctl_cmd_get_shared:
+            *(const dmclk_shared_t**)arg = dmclk_port_get_shared();
+            break;
+        case dmclk_ioctl_cmd_get_governor:
+            *(dmclk_governor_t*)arg = context->governor.policy;
+            break;
+        case dmclk_ioctl_cmd_get_opp:
+            *(uint32_t*)arg = context->current_opp;
+            break;
+        case dmclk_ioctl_cmd_get_opp_count:
+            *(uint32_t*)arg = context->opp_count;
+            break;
+        case dmclk_ioctl_cmd_get_qos_limits:
+            memcpy(arg, &context->qos_limits, sizeof(dmclk_qos_limits_t));
+            break;
+        case dmclk_ioctl_cmd_get_hse_failures:
+            *(uint32_t*)arg = context->hse_failures;
+            break;
+        case dmclk_ioctl_cmd_get_mco:
+            memcpy(arg, &context->mco[((dmclk_mco_config_t*)arg)->output - 1], sizeof(dmclk_mco_config_t));
+            break;
+        case dmclk_ioctl_cmd_get_async_status:
+            *(dmclk_async_status_t*)arg = (dmclk_async_status_t)context->async_status;
+            break;
+        default:
+            ret = -EINVAL;
+            break;
+    }
+    return ret;
+}
+
+/**
+ * @brief Read configuration parameters from context
+ * 
+ * Lock-free: the value is copied again if a writer published new state meanwhile,
+ * so 64-bit values are never torn and readers never wait for a reconfiguration.
+ * 
+ * @param context DMDRVI context
+ * @param command IOCTL command
+ * @param arg Argument for the command
+ * 
+ * @return int 0 on success, -EINVAL if @p command is not a read command
+ */
+static int read_configuration(dmdrvi_context_t context, int command, void* arg)
+{
+    int ret;
+    uint32_t sequence;
+    do
+    {
+        sequence = read_begin(context);
+        ret = read_field(context, command, arg);
+    } while (ret == 0 && read_retry(context, sequence));
+    return ret;
+}
+
+/**
+ * @brief Apply a configuration write command
+ * 
+ * @param context DMDRVI context (locked by the caller)
+ * @param command IOCTL command
+ * @param arg Argument for the command
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+static int write_configuration(dmdrvi_context_t context, int command, void* arg)
+{
+    struct config new_config = context->config;
+
+    int ret = update_configuration(&new_config, command, arg);
+    if (ret == 0)
+    {
+        ret = apply_configuration(context, &new_config);
+    }
+    return ret;
+}
+
+/**
+ * @brief Compare a length-delimited token with a string
+ * 
+ * @param token Token, not terminated
+ * @param length Length of the token
+ * @param text String to compare with
+ * 
+ * @return int non-zero if they are equal
+ */
+static int token_equals(const char* token, size_t length, const char* text)
+{
+    return strlen(text) == length && memcmp(token, text, length) == 0;
+}
+
+/**
+ * @brief Parse a decimal frequency
+ * 
+ * @param value Value, not terminated
+ * @param length Length of the value
+ * @param frequency Parsed frequency
+ * 
+ * @return int 0 on success, non-zero if the value is not a decimal number
+ */
+static int parse_frequency(const char* value, size_t length, dmclk_frequency_t* frequency)
+{
+    dmclk_frequency_t result = 0;
+    if (length == 0)
+    {
+        return -EINVAL;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        if (value[i] < '0' || value[i] > '9' || result > (UINT64_MAX - 9) / 10)
+        {
+            return -EINVAL;
+        }
+        result = result * 10 + (dmclk_frequency_t)(value[i] - '0');
+    }
+    *frequency = result;
+    return 0;
+}
+
+/**
+ * @brief Parse a text command written to the device
+ * 
+ * The command uses the syntax of the info text: key=value pairs separated by
+ * ';' or new lines. Keys are target_frequency (or frequency, as printed by
+ * dmclk_dmdrvi_read()), tolerance, source, oscillator_frequency and opp. The
+ * whole command is parsed and validated before anything is applied; opp
+ * selects an operating point and cannot be combined with the other keys.
+ * 
+ * @param text Command, not terminated
+ * @param size Length of the command
+ * @param cfg Configuration to update, a copy of the current one
+ * @param opp Set to the requested operating point or DMCLK_OPP_NONE
+ * 
+ * @return int Number of key=value pairs, negative error code on failure
+ */
+static int parse_command(const char* text, size_t size, struct config* cfg, uint32_t* opp)
+{
+    int count = 0;
+    int config_keys = 0;
+    size_t position = 0;
+
+    *opp = DMCLK_OPP_NONE;
+    while (position < size)
+    {
+        size_t end = position;
+        while (end < size && text[end] != ';' && text[end] != '\n' && text[end] != '\0')
+        {
+            end++;
+        }
+        const char* pair = text + position;
+        size_t length = end - position;
+        position = end + 1;
+
+        while (length > 0 && (pair[0] == ' ' || pair[0] == '\t'))
+        {
+            pair++;
+            length--;
+        }
+        while (length > 0 && (pair[length - 1] == ' ' || pair[length - 1] == '\t' || pair[length - 1] == '\r'))
+        {
+            length--;
+        }
+        if (length == 0)
+        {
+            continue;
+        }
+
+        const char* separator = memchr(pair, '=', length);
+        if (separator == NULL)
+        {
+            DMOD_LOG_ERROR("Missing '=' in the dmclk command\n");
+            return -EINVAL;
+        }
+        size_t key_length = (size_t)(separator - pair);
+        const char* value = separator + 1;
+        size_t value_length = length - key_length - 1;
+        dmclk_frequency_t number = 0;
+        int ret = 0;
+
+        if (token_equals(pair, key_length, "target_frequency") || token_equals(pair, key_length, "frequency"))
+        {
+            ret = parse_frequency(value, value_length, &cfg->target_frequency);
+            config_keys++;
+        }
+        else if (token_equals(pair, key_length, "tolerance"))
+        {
+            ret = parse_frequency(value, value_length, &cfg->tolerance);
+            config_keys++;
+        }
+        else if (token_equals(pair, key_length, "oscillator_frequency"))
+        {
+            ret = parse_frequency(value, value_length, &cfg->oscillator_frequency);
+            config_keys++;
+        }
+        else if (token_equals(pair, key_length, "source"))
+        {
+            char source[16];
+            if (value_length >= sizeof(source))
+            {
+                ret = -EINVAL;
+            }
+            else
+            {
+                memcpy(source, value, value_length);
+                source[value_length] = '\0';
+                cfg->source = string_to_source(source);
+                ret = (cfg->source == dmclk_source_unkown) ? -EINVAL : 0;
+            }
+            config_keys++;
+        }
+        else if (token_equals(pair, key_length, "opp"))
+        {
+            ret = parse_frequency(value, value_length, &number);
+            if (ret == 0 && number >= DMCLK_OPP_NONE)
+            {
+                ret = -EINVAL;
+            }
+            *opp = (uint32_t)number;
+        }
+        else
+        {
+            DMOD_LOG_ERROR("Unknown key in the dmclk command\n");
+            return -EINVAL;
+        }
+        if (ret != 0)
+        {
+            DMOD_LOG_ERROR("Invalid value in the dmclk command\n");
+            return ret;
+        }
+        count++;
+    }
+
+    if (*opp != DMCLK_OPP_NONE && config_keys > 0)
+    {
+        DMOD_LOG_ERROR("An operating point cannot be combined with configuration keys\n");
+        return -EINVAL;
+    }
+    if (config_keys > 0)
+    {
+        int ret = check_config_parameters(cfg);
+        if (ret != 0)
+        {
+            return ret;
+        }
+    }
+    return count;
+}
+
+/**
+ * @brief Format the device info text
+ * 
+ * @param context DMDRVI context
+ * @param text Buffer of DMCLK_INFO_TEXT_SIZE bytes
+ * @param generation Set to the configuration generation the text describes
+ * 
+ * @return uint32_t Length of the text
+ */
+static uint32_t format_info(dmdrvi_context_t context, char* text, uint32_t* generation)
+{
+    int total;
+    uint32_t sequence;
+    do
+    {
+        sequence = read_begin(context);
+        total = Dmod_SnPrintf(text, DMCLK_INFO_TEXT_SIZE, "frequency=%llu;source=%s;oscillator_frequency=%llu",
+                      context->current_frequency,
+                      source_to_string(context->config.source),
+                      context->config.oscillator_frequency);
+    } while (read_retry(context, sequence));
+
+    *generation = sequence;
+    if (total <= 0)
+    {
+        return 0;
+    }
+    return ((uint32_t)total < DMCLK_INFO_TEXT_SIZE) ? (uint32_t)total : (DMCLK_INFO_TEXT_SIZE - 1);
 }
 
 /**
- * @brief Convert clock source enum to string
+ * @brief Copy part of the device data to the reader
  * 
- * @param source Clock source
+ * @param buffer Buffer to read data into, NULL to only learn the length
+ * @param size Size of the buffer
+ * @param offset Byte offset from the beginning of the device data
+ * @param data Device data
+ * @param length Length of the device data
  * 
- * @return const char* String representation of clock source
+ * @return size_t Number of bytes copied
  */
-static const char* source_to_string(dmclk_source_t source)
+static size_t copy_range(void* buffer, size_t size, uint32_t offset, const void* data, uint32_t length)
 {
-    switch (source)
+    if (buffer == NULL || length <= offset)
     {
-        case dmclk_source_internal:
-            return "internal";
-        case dmclk_source_external:
-            return "external";
-        case dmclk_source_hibernation:
-            return "hibernation";
-        default:
-            return "unknown";
+        return 0;
     }
+    size_t available = (size_t)(length - offset);
+    size_t to_copy = (available < size) ? available : size;
+    memcpy(buffer, (const char*)data + offset, to_copy);
+    return to_copy;
 }
 
 /**
- * @brief Convert string to clock source enum
+ * @brief Read the device info text
  * 
- * @param source_str String representation of clock source
+ * The text is formatted once per configuration generation and cached in the
+ * context, so a reader consuming it in small chunks does not format it again
+ * for every chunk. Readers stay lock-free: the first one to see a new generation
+ * publishes its copy, one that finds the cache being replaced serves its own.
  * 
- * @return dmclk_source_t Clock source enum
+ * @param context DMDRVI context
+ * @param buffer Buffer to read data into, NULL to only learn the length
+ * @param size Size of the buffer
+ * @param offset Byte offset from the beginning of the text
+ * @param length Set to the length of the whole text
+ * 
+ * @return size_t Number of bytes copied
  */
-static dmclk_source_t string_to_source(const char* source_str)
+static size_t read_info_text(dmdrvi_context_t context, void* buffer, size_t size, uint32_t offset, uint32_t* length)
 {
-    if (source_str != NULL)
+    char text[DMCLK_INFO_TEXT_SIZE];
+    uint32_t generation = context->info_generation;
+
+    if (generation == read_begin(context))
     {
-        if (strcmp(source_str, "internal") == 0)
-        {
-            return dmclk_source_internal;
-        }
-        else if (strcmp(source_str, "external") == 0)
-        {
-            return dmclk_source_external;
-        }
-        else if (strcmp(source_str, "hibernation") == 0)
+        *length = context->info_length;
+        size_t copied = copy_range(buffer, size, offset, context->info, *length);
+        __sync_synchronize();
+        if (context->info_generation == generation)
         {
-            return dmclk_source_hibernation;
+            return copied;
         }
     }
-    return dmclk_source_unkown;
+
+    *length = format_info(context, text, &generation);
+
+    uint32_t cached = context->info_generation;
+    if (cached != DMCLK_INFO_BUSY && cached != generation
+     && __sync_bool_compare_and_swap(&context->info_generation, cached, DMCLK_INFO_BUSY))
+    {
+        memcpy(context->info, text, *length);
+        context->info_length = *length;
+        __sync_synchronize();
+        context->info_generation = generation;
+    }
+    return copy_range(buffer, size, offset, text, *length);
 }
 
 /**
- * @brief Check configuration parameters
+ * @brief Take a consistent snapshot of the binary device record
  * 
  * @param context DMDRVI context
- * 
- * @return int 0 if valid, non-zero otherwise
+ * @param info Record to fill
  */
-static int check_config_parameters(struct config* cfg)
+static void read_info_record(dmdrvi_context_t context, dmclk_info_t* info)
 {
-    if (cfg->target_frequency == 0)
-    {
-        DMOD_LOG_ERROR("Target frequency not set in configuration\n");
-        return -EINVAL;
-    }
-    else if (cfg->tolerance == 0)
-    {
-        DMOD_LOG_ERROR("Tolerance not set in configuration\n");
-        return -EINVAL;
-    }
-    else if (cfg->source == dmclk_source_unkown)
+    uint32_t sequence;
+
+    memset(info, 0, sizeof(*info));
+    do
     {
-        DMOD_LOG_ERROR("Clock source not set or unknown in configuration\n");
-        return -EINVAL;
-    }
-    else if(cfg->source != dmclk_source_internal && cfg->oscillator_frequency == 0)
+        sequence = read_begin(context);
+        info->version = DMCLK_INFO_VERSION;
+        info->size = sizeof(*info);
+        info->generation = sequence;
+        info->source = (uint32_t)context->config.source;
+        info->bus_policy = (uint32_t)context->config.bus_policy;
+        info->current_opp = context->current_opp;
+        info->frequency = context->current_frequency;
+        info->target_frequency = context->config.target_frequency;
+        info->tolerance = context->config.tolerance;
+        info->oscillator_frequency = context->config.oscillator_frequency;
+        info->clock_tree = context->clock_tree;
+        info->clock_changes = context->clock_changes;
+        info->hse_failures = context->hse_failures;
+    } while (read_retry(context, sequence));
+}
+
+#ifdef DMCLK_STATIC_CONFIG
+/**
+ * @brief Take the statically allocated context
+ * 
+ * @return dmdrvi_context_t Zeroed context or NULL if it is already in use
+ */
+static dmdrvi_context_t new_context(void)
+{
+    if (static_context.magic == DMCLK_CONTEXT_MAGIC)
     {
-        DMOD_LOG_ERROR("Oscillator frequency not set in configuration for external or hibernation source\n");
-        return -EINVAL;
+        DMOD_LOG_ERROR("The static dmclk context is already in use\n");
+        return NULL;
     }
-    return 0;
+    memset(&static_context, 0, sizeof(static_context));
+    return &static_context;
 }
 
 /**
- * @brief Read configuration parameters from Dmini context
+ * @brief Release the statically allocated context
  * 
  * @param context DMDRVI context
- * @param config Dmini context with configuration data
- * 
- * @return int 0 on success, non-zero on failure
  */
-static int read_config_parameters(dmdrvi_context_t context, dmini_context_t config)
-{   
-    context->config.target_frequency = (dmclk_frequency_t)dmini_get_int(config, "dmclk", "target_frequency", 0);
-    context->config.tolerance = (dmclk_frequency_t)dmini_get_int(config, "dmclk", "tolerance", 0);
-    context->config.oscillator_frequency = (dmclk_frequency_t)dmini_get_int(config, "dmclk", "oscillator_frequency", 0);
-    context->config.source = string_to_source(dmini_get_string(config, "dmclk", "source", NULL));
-    
-    return check_config_parameters(&context->config);
+static void delete_context(dmdrvi_context_t context)
+{
+    context->magic = 0;
 }
 
 /**
- * @brief Configure the clock based on context parameters
+ * @brief Load the generated configuration and configure the clock with the precomputed plan
  * 
  * @param context DMDRVI context
+ * @param config Unused - the configuration was compiled in
  * 
  * @return int 0 on success, non-zero on failure
  */
-static int configure(dmdrvi_context_t context)
+static int load_configuration(dmdrvi_context_t context, dmini_context_t config)
 {
-    int ret = -1;
-    switch (context->config.source)
-    {
-        case dmclk_source_internal:
-            ret = dmclk_port_configure_internal(context->config.target_frequency, context->config.tolerance);
-            break;
-        case dmclk_source_external:
-            ret = dmclk_port_configure_external(context->config.target_frequency, context->config.tolerance, context->config.oscillator_frequency);
-            break;
-        case dmclk_source_hibernation:
-            ret = dmclk_port_configure_hibernatation(context->config.target_frequency, context->config.tolerance, context->config.oscillator_frequency);
-            break;
-        default:
-            DMOD_LOG_ERROR("Unknown clock source in configuration\n");
-            ret = -EINVAL;
-            break;
-    }
-    if (ret == 0)
+    (void)config;
+#ifdef DMCLK_STATIC_PERIPHERAL_CLOCKS
+    if (dmclk_port_set_peripheral_clocks(&static_peripheral_clocks) != 0)
     {
-        DMOD_LOG_INFO("Clock configured successfully with source %s\n", source_to_string(context->config.source));
-        context->current_frequency = dmclk_port_get_current_frequency();
+        DMOD_LOG_ERROR("PLLI2S / PLLSAI clocks are not supported by the port\n");
+        return -ENOTSUP;
     }
-    else 
+#else
+    dmclk_port_set_peripheral_clocks(NULL);
+#endif
+
+    context->config = static_config;
+    context->governor = static_governor;
+    memcpy(context->opps, static_opps, sizeof(context->opps));
+    context->opp_count = DMCLK_STATIC_OPP_COUNT;
+    context->current_opp = DMCLK_OPP_NONE;
+    context->applied_target = static_config.target_frequency;
+
+    int ret = configure_initial(context, &static_plan);
+    for (uint32_t i = 0; ret == 0 && i < DMCLK_MCO_COUNT; i++)
     {
-        DMOD_LOG_ERROR("Failed to configure clock with source %s\n", source_to_string(context->config.source));
+        context->mco[i] = static_mcos[i];
+        if (static_mcos[i].source != dmclk_mco_source_off)
+        {
+            ret = set_mco(context, &static_mcos[i]);
+        }
     }
     return ret;
 }
-
+#else
 /**
- * @brief Update configuration parameters in context
- *
- * @param cfg Configuration structure to update
- * @param command IOCTL command
- * @param arg Argument for the command
+ * @brief Allocate a context
  * 
- * @return int 0 on success, non-zero on failure
+ * @return dmdrvi_context_t Zeroed context or NULL if out of memory
  */
-static int update_configuration(struct config* cfg, int command, void* arg)
+static dmdrvi_context_t new_context(void)
 {
-    int ret = 0;
-    switch (command)
-    {
-        case dmclk_ioctl_cmd_set_target_frequency:
-            cfg->target_frequency = *(dmclk_frequency_t*)arg;
-            break;
-        case dmclk_ioctl_cmd_set_tolerance:
-            cfg->tolerance = *(dmclk_frequency_t*)arg;
-            break;
-        case dmclk_ioctl_cmd_set_oscillator_frequency:
-            cfg->oscillator_frequency = *(dmclk_frequency_t*)arg;
-            break;
-        case dmclk_ioctl_cmd_set_source:
-            cfg->source = *(dmclk_source_t*)arg;
-            break;
-        default:
-            DMOD_LOG_ERROR("Invalid configuration command %d in update_configuration\n", command);
-            ret = -EINVAL;
-            break;
-    }
-    if (ret == 0)
+    dmdrvi_context_t context = Dmod_Malloc(sizeof(struct dmdrvi_context));
+    if (context != NULL)
     {
-        ret = check_config_parameters(cfg);
+        memset(context, 0, sizeof(*context));
     }
-    return ret;
+    return context;
 }
 
 /**
- * @brief Read configuration parameters from context
+ * @brief Free a context
  * 
  * @param context DMDRVI context
- * @param command IOCTL command
- * @param arg Argument for the command
+ */
+static void delete_context(dmdrvi_context_t context)
+{
+    Dmod_Free(context);
+}
+
+/**
+ * @brief Read the configuration and configure the clock
+ * 
+ * @param context DMDRVI context
+ * @param config Dmini context with configuration data
  * 
  * @return int 0 on success, non-zero on failure
  */
-static int read_configuration(dmdrvi_context_t context, int command, void* arg)
+static int load_configuration(dmdrvi_context_t context, dmini_context_t config)
 {
-    int ret = 0;
-    switch (command)
+    if (config == NULL)
     {
-        case dmclk_ioctl_cmd_get_target_frequency:
-            *(dmclk_frequency_t*)arg = context->config.target_frequency;
-            break;
-        case dmclk_ioctl_cmd_get_tolerance:
-            *(dmclk_frequency_t*)arg = context->config.tolerance;
-            break;
-        case dmclk_ioctl_cmd_get_oscillator_frequency:
-            *(dmclk_frequency_t*)arg = context->config.oscillator_frequency;
-            break;
-        case dmclk_ioctl_cmd_get_source:
-            *(dmclk_source_t*)arg = context->config.source;
-            break;
-        case dmclk_ioctl_cmd_get_frequency:
-            *(dmclk_frequency_t*)arg = context->current_frequency;
-            break;
-        default:
-            DMOD_LOG_ERROR("Invalid configuration command %d in read_configuration\n", command);
-            ret = -EINVAL;
-            break;
+        DMOD_LOG_ERROR("Missing dmclk configuration\n");
+        return -EINVAL;
     }
-    return ret;
+    if (read_config_parameters(context, config) != 0
+     || read_peripheral_clocks(config) != 0
+     || read_opps(context, config) != 0
+     || configure_initial(context, NULL) != 0
+     || read_mcos(context, config) != 0)
+    {
+        return -EINVAL;
+    }
+    return 0;
 }
+#endif
 
 /**
  * @brief Initialize the DMDRVI module
@@ -288,7 +2123,8 @@ int dmod_deinit(void)
  */
 dmod_dmdrvi_dif_api_declaration(1.0, dmclk, dmdrvi_context_t, _create, ( dmini_context_t config, dmdrvi_dev_num_t* dev_num ))
 {
-    if(config == NULL || dev_num == NULL)
+    // config may be NULL in static configuration builds, load_configuration() checks it
+    if(dev_num == NULL)
     {
         DMOD_LOG_ERROR("Invalid parameters to dmclk_dmdrvi_create\n");
         return NULL;
@@ -299,21 +2135,35 @@ dmod_dmdrvi_dif_api_declaration(1.0, dmclk, dmdrvi_context_t, _create, ( dmini_c
     dev_num->minor = 0;
     dev_num->flags = DMDRVI_NUM_NONE;
 
-    dmdrvi_context_t context = Dmod_Malloc(sizeof(struct dmdrvi_context));
+    dmdrvi_context_t context = new_context();
     if (context != NULL)
     {
-        memset(context, 0, sizeof(*context));
         context->magic = DMCLK_CONTEXT_MAGIC;
-        if (read_config_parameters(context, config) != 0
-         || configure(context) != 0)
+        context->qos_limits.max_frequency = DMCLK_QOS_NO_LIMIT;
+        context->info_generation = DMCLK_INFO_NONE;
+        for (int i = 0; i < 2; i++)
+        {
+            context->handles[i].context = context;
+            context->handles[i].binary = i;
+        }
+        context->mutex = Dmod_Mutex_New(false);
+        if (context->mutex == NULL)
+        {
+            DMOD_LOG_ERROR("Failed to create dmclk context mutex\n");
+            delete_context(context);
+            return NULL;
+        }
+        if (load_configuration(context, config) != 0)
         {
             DMOD_LOG_ERROR("Failed to create DMDRVI context with provided configuration\n");
-            Dmod_Free(context);
+            Dmod_Mutex_Delete(context->mutex);
+            delete_context(context);
             return NULL;
         }
         else 
         {
             DMOD_LOG_INFO("Clock configured to %llu Hz\n", context->current_frequency);
+            dmclk_port_set_event_callback(port_event_handler, context);
         }
     }
     return context;
@@ -327,8 +2177,22 @@ dmod_dmdrvi_dif_api_declaration(1.0, dmclk, void, _free, ( dmdrvi_context_t cont
 {
     if (is_valid_context(context))
     {
+        dmclk_port_set_event_callback(NULL, NULL);
+        if (context->async_status == dmclk_async_pending)
+        {
+            DMOD_LOG_INFO("Abandoning the pending asynchronous clock reconfiguration\n");
+            dmclk_port_cancel_async();
+        }
+        for (uint32_t i = 0; i < DMCLK_MCO_COUNT; i++)
+        {
+            if (context->mco[i].source != dmclk_mco_source_off)
+            {
+                dmclk_port_configure_mco(i + 1, dmclk_mco_source_off, 1);
+            }
+        }
         context->magic = 0; // Invalidate context
-        Dmod_Free(context);
+        Dmod_Mutex_Delete(context->mutex);
+        delete_context(context);
     }
 }
 
@@ -347,12 +2211,12 @@ dmod_dmdrvi_dif_api_declaration(1.0, dmclk, void*, _open, ( dmdrvi_context_t con
         DMOD_LOG_ERROR("Invalid DMDRVI context in dmclk_dmdrvi_open\n");
         return NULL;
     }
-    if(flags & DMDRVI_O_WRONLY)
+    if((flags & DMDRVI_O_WRONLY) && (flags & DMCLK_O_BINARY))
     {
-        DMOD_LOG_ERROR("Write access is not supported in dmclk_dmdrvi_open\n");
+        DMOD_LOG_ERROR("The binary record is read-only in dmclk_dmdrvi_open\n");
         return NULL;
     }
-    return context;
+    return &context->handles[(flags & DMCLK_O_BINARY) ? 1 : 0];
 }
 
 /**
@@ -372,6 +2236,7 @@ dmod_dmdrvi_dif_api_declaration(1.0, dmclk, void, _close, ( dmdrvi_context_t con
  * 
  * The data is returned in the format:
  * "frequency=<current_frequency>;source=<source_string>;oscillator_frequency=<oscillator_frequency>"
+ * or, for handles opened with DMCLK_O_BINARY, as a dmclk_info_t record.
  * 
  * @param context DMDRVI context
  * @param handle Device handle
@@ -383,38 +2248,67 @@ dmod_dmdrvi_dif_api_declaration(1.0, dmclk, void, _close, ( dmdrvi_context_t con
  */
 dmod_dmdrvi_dif_api_declaration(1.0, dmclk, size_t, _read, ( dmdrvi_context_t context, void* handle, void* buffer, size_t size, uint32_t offset ))
 {
-    char temp[256];
-    int total = Dmod_SnPrintf(temp, sizeof(temp), "frequency=%llu;source=%s;oscillator_frequency=%llu",
-                  context->current_frequency,
-                  source_to_string(context->config.source),
-                  context->config.oscillator_frequency);
-    if (total <= 0 || (uint32_t)total <= offset)
+    const struct handle* device = (const struct handle*)handle;
+    uint32_t length;
+
+    if (!is_valid_context(context))
     {
         return 0;
     }
-    size_t available = (size_t)((uint32_t)total - offset);
-    size_t to_copy = (available < size) ? available : size;
-    memcpy(buffer, temp + offset, to_copy);
-    return to_copy;
+    if (device != NULL && device->context == context && device->binary)
+    {
+        dmclk_info_t info;
+        read_info_record(context, &info);
+        return copy_range(buffer, size, offset, &info, sizeof(info));
+    }
+    return read_info_text(context, buffer, size, offset, &length);
 }
 
 /**
  * @brief Write to the device
  * 
- * @note This function is not implemented as the clock device is read-only.
+ * Every write is one complete command in the format of the read data, e.g.
+ * "target_frequency=100000000;tolerance=1000;source=external" or "opp=2".
+ * The command is parsed and validated as a whole and applied with a single
+ * reconfiguration; nothing changes if any pair is invalid.
  * 
  * @param context DMDRVI context
  * @param handle Device handle
  * @param buffer Buffer with data to write
  * @param size Number of bytes to write
- * @param offset Byte offset from the beginning of the device to write to
+ * @param offset Ignored - every write is a separate command
  * 
- * @return size_t Number of bytes written
+ * @return size_t Number of bytes written, 0 if the command was empty, rejected or failed
  */
 dmod_dmdrvi_dif_api_declaration(1.0, dmclk, size_t, _write, ( dmdrvi_context_t context, void* handle, const void* buffer, size_t size, uint32_t offset ))
 {
-    // TODO: Implement _write function
-    return 0;
+    const struct handle* device = (const struct handle*)handle;
+    struct config new_config;
+    uint32_t opp;
+
+    if (!is_valid_context(context) || buffer == NULL || (device != NULL && device->binary))
+    {
+        DMOD_LOG_ERROR("Invalid parameters in dmclk_dmdrvi_write\n");
+        return 0;
+    }
+
+    int ret = lock_context(context);
+    if (ret == 0)
+    {
+        new_config = context->config;
+        ret = parse_command((const char*)buffer, size, &new_config, &opp);
+        if (ret > 0)
+        {
+            ret = (opp != DMCLK_OPP_NONE) ? set_opp(context, opp) : apply_configuration(context, &new_config);
+        }
+        else if (ret == 0)
+        {
+            DMOD_LOG_ERROR("Empty dmclk command\n");
+            ret = -EINVAL;
+        }
+        unlock_context(context);
+    }
+    return (ret == 0) ? size : 0;
 }
 
 /**
@@ -445,10 +2339,50 @@ dmod_dmdrvi_dif_api_declaration(1.0, dmclk, int, _ioctl, ( dmdrvi_context_t cont
     }
     else if(command == dmclk_ioctl_cmd_reconfigure)
     {
-        ret = configure(context);
+        ret = lock_context(context);
+        if (ret == 0)
+        {
+            ret = (context->current_opp != DMCLK_OPP_NONE)
+                ? configure(context, &context->opps[context->current_opp].plan)
+                : configure(context, NULL);
+            if (ret == 0)
+            {
+                DMOD_LOG_INFO("Clock reconfigured to %llu Hz\n", context->current_frequency);
+            }
+            unlock_context(context);
+        }
+    }
+    else if(command == dmclk_ioctl_cmd_enter_stop)
+    {
+        ret = lock_context(context);
+        if (ret == 0)
+        {
+            ret = enter_stop(context);
+            unlock_context(context);
+        }
+    }
+    else if(command == dmclk_ioctl_cmd_process_events)
+    {
+        // The deferred work, including a pending asynchronous reconfiguration, is done whenever the lock is taken
+        ret = lock_context_pending(context);
+        if (ret == 0)
+        {
+            unlock_context(context);
+        }
+    }
+    else if(command == dmclk_ioctl_cmd_cancel_async)
+    {
+        ret = lock_context_pending(context);
         if (ret == 0)
         {
-            DMOD_LOG_INFO("Clock reconfigured to %llu Hz\n", context->current_frequency);
+            ret = -ENOENT;
+            if (context->async_status == dmclk_async_pending && dmclk_port_cancel_async() == 0)
+            {
+                DMOD_LOG_INFO("Asynchronous clock reconfiguration cancelled\n");
+                complete_async(context, 0);
+                ret = 0;
+            }
+            unlock_context(context);
         }
     }
     else if(arg == NULL)  
@@ -456,26 +2390,52 @@ dmod_dmdrvi_dif_api_declaration(1.0, dmclk, int, _ioctl, ( dmdrvi_context_t cont
         DMOD_LOG_ERROR("Null argument for ioctl command %d in dmclk_dmdrvi_ioctl\n", command);
         return -EINVAL;
     }
+    else if((command == dmclk_ioctl_cmd_set_mco || command == dmclk_ioctl_cmd_get_mco)
+         && (((dmclk_mco_config_t*)arg)->output < 1 || ((dmclk_mco_config_t*)arg)->output > DMCLK_MCO_COUNT))
+    {
+        DMOD_LOG_ERROR("Invalid clock output %u\n", (unsigned int)((dmclk_mco_config_t*)arg)->output);
+        return -EINVAL;
+    }
+    else if(read_configuration(context, command, arg) == 0)
+    {
+        // Read operation - lock-free
+        ret = 0;
+    }
     else 
     {
-        struct config new_config = {0};
-        memcpy(&new_config, &context->config, sizeof(struct config));
-
-        ret = read_configuration(context, command, arg); 
-        if(ret != 0)
+        // Write operation - serialized with other writers
+        ret = lock_context(context);
+        if (ret == 0)
         {
-            // Write operation
-            ret = update_configuration(&new_config, command, arg);
-            if (ret == 0)
+            if(command == dmclk_ioctl_cmd_register_notifier || command == dmclk_ioctl_cmd_unregister_notifier)
+            {
+                ret = update_notifiers(context, command, arg);
+            }
+            else if(command == dmclk_ioctl_cmd_set_governor || command == dmclk_ioctl_cmd_governor_sample)
+            {
+                ret = update_governor(context, command, arg);
+            }
+            else if(command == dmclk_ioctl_cmd_add_qos_request || command == dmclk_ioctl_cmd_remove_qos_request)
+            {
+                ret = update_qos(context, command, (dmclk_qos_request_t*)arg);
+            }
+            else if(command == dmclk_ioctl_cmd_set_opp)
             {
-                // Apply new configuration
-                memcpy(&context->config, &new_config, sizeof(struct config));
-                ret = configure(context);
-                if (ret == 0)
-                {
-                    DMOD_LOG_INFO("Clock reconfigured to %llu Hz\n", context->current_frequency);
-                }
+                ret = set_opp(context, *(uint32_t*)arg);
             }
+            else if(command == dmclk_ioctl_cmd_set_mco)
+            {
+                ret = set_mco(context, (const dmclk_mco_config_t*)arg);
+            }
+            else if(command == dmclk_ioctl_cmd_reconfigure_async)
+            {
+                ret = reconfigure_async(context, (const dmclk_async_request_t*)arg);
+            }
+            else
+            {
+                ret = write_configuration(context, command, arg);
+            }
+            unlock_context(context);
         }
     }
 
@@ -512,13 +2472,9 @@ dmod_dmdrvi_dif_api_declaration(1.0, dmclk, int, _stat, ( dmdrvi_context_t conte
         return -EINVAL;
     }
 
-    char info_buffer[256];
-    int result = dmdrvi_dmclk_read(context, NULL, info_buffer, sizeof(info_buffer), 0);
-    if(result < 0)
-    {
-        return result;
-    }
-    stat->size = (uint32_t)result;
-    stat->mode = 0444; // Read-only permissions
+    uint32_t length;
+    read_info_text(context, NULL, 0, 0, &length);
+    stat->size = length;
+    stat->mode = 0644; // Commands can be written, see dmclk_dmdrvi_write()
     return 0;
 }
\ No newline at end of file
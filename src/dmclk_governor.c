@@ -0,0 +1,258 @@
+#include "dmclk_governor.h"
+#include <errno.h>
+#include <string.h>
+
+/* Targets proposed by the governor are rounded to this granularity, which every
+ * PLL input frequency used by the ports can reach exactly */
+#define GOVERNOR_GRANULARITY            1000000U
+
+#define GOVERNOR_DEFAULT_SAMPLING_MS    100
+#define GOVERNOR_DEFAULT_UP_THRESHOLD   80
+#define GOVERNOR_DEFAULT_DOWN_THRESHOLD 30
+#define GOVERNOR_DEFAULT_DOWN_SAMPLES   3
+
+#ifndef DMCLK_STATIC_CONFIG
+/**
+ * @brief Convert string to governor policy
+ * 
+ * @param policy_str String representation of the policy
+ * 
+ * @return int Governor policy or -1 if the string is not recognized
+ */
+static int string_to_governor(const char* policy_str)
+{
+    if (policy_str == NULL || strcmp(policy_str, "none") == 0)
+    {
+        return dmclk_governor_none;
+    }
+    else if (strcmp(policy_str, "performance") == 0)
+    {
+        return dmclk_governor_performance;
+    }
+    else if (strcmp(policy_str, "powersave") == 0)
+    {
+        return dmclk_governor_powersave;
+    }
+    else if (strcmp(policy_str, "ondemand") == 0)
+    {
+        return dmclk_governor_ondemand;
+    }
+    else if (strcmp(policy_str, "conservative") == 0)
+    {
+        return dmclk_governor_conservative;
+    }
+    return -1;
+}
+#endif // DMCLK_STATIC_CONFIG
+
+/**
+ * @brief Round frequency up to the governor granularity and clamp it to the governor range
+ * 
+ * @param governor Governor
+ * @param frequency Frequency to round
+ * 
+ * @return dmclk_frequency_t Rounded and clamped frequency
+ */
+static dmclk_frequency_t clamp_frequency(const struct dmclk_governor* governor, uint32_t frequency)
+{
+    uint32_t remainder = frequency % GOVERNOR_GRANULARITY;
+    if (remainder != 0)
+    {
+        frequency += GOVERNOR_GRANULARITY - remainder;
+    }
+    if (frequency < governor->min_frequency)
+    {
+        return governor->min_frequency;
+    }
+    if (frequency > governor->max_frequency)
+    {
+        return governor->max_frequency;
+    }
+    return frequency;
+}
+
+/**
+ * @brief Convert governor policy to string
+ */
+const char* dmclk_governor_to_string(dmclk_governor_t policy)
+{
+    switch (policy)
+    {
+        case dmclk_governor_performance:
+            return "performance";
+        case dmclk_governor_powersave:
+            return "powersave";
+        case dmclk_governor_ondemand:
+            return "ondemand";
+        case dmclk_governor_conservative:
+            return "conservative";
+        default:
+            return "none";
+    }
+}
+
+#ifndef DMCLK_STATIC_CONFIG
+/**
+ * @brief Read governor parameters from the [dmclk] section
+ */
+int dmclk_governor_read_config(struct dmclk_governor* governor, dmini_context_t config, dmclk_frequency_t target_frequency)
+{
+    memset(governor, 0, sizeof(*governor));
+
+    int policy = string_to_governor(dmini_get_string(config, "dmclk", "governor", NULL));
+    if (policy < 0)
+    {
+        DMOD_LOG_ERROR("Unknown governor in configuration\n");
+        return -EINVAL;
+    }
+    governor->policy = (dmclk_governor_t)policy;
+
+    governor->max_frequency = (dmclk_frequency_t)dmini_get_int(config, "dmclk", "governor_max_frequency", (int)target_frequency);
+    governor->min_frequency = (dmclk_frequency_t)dmini_get_int(config, "dmclk", "governor_min_frequency", (int)(governor->max_frequency / 4));
+    governor->step = (dmclk_frequency_t)dmini_get_int(config, "dmclk", "governor_step", (int)(governor->max_frequency / 10));
+    governor->sampling_period_us = (uint32_t)dmini_get_int(config, "dmclk", "governor_sampling_ms", GOVERNOR_DEFAULT_SAMPLING_MS) * 1000U;
+    governor->up_threshold = (uint32_t)dmini_get_int(config, "dmclk", "governor_up_threshold", GOVERNOR_DEFAULT_UP_THRESHOLD);
+    governor->down_threshold = (uint32_t)dmini_get_int(config, "dmclk", "governor_down_threshold", GOVERNOR_DEFAULT_DOWN_THRESHOLD);
+    governor->down_samples = (uint32_t)dmini_get_int(config, "dmclk", "governor_down_samples", GOVERNOR_DEFAULT_DOWN_SAMPLES);
+
+    if (governor->policy == dmclk_governor_none)
+    {
+        return 0;
+    }
+    if (governor->min_frequency == 0 || governor->min_frequency > governor->max_frequency)
+    {
+        DMOD_LOG_ERROR("Invalid governor frequency range %llu - %llu Hz\n", governor->min_frequency, governor->max_frequency);
+        return -EINVAL;
+    }
+    if (governor->sampling_period_us == 0
+     || governor->up_threshold == 0 || governor->up_threshold > 100
+     || governor->down_threshold >= governor->up_threshold)
+    {
+        DMOD_LOG_ERROR("Invalid governor sampling parameters\n");
+        return -EINVAL;
+    }
+    if (governor->step < GOVERNOR_GRANULARITY)
+    {
+        governor->step = GOVERNOR_GRANULARITY;
+    }
+    DMOD_LOG_INFO("Governor %s enabled in range %llu - %llu Hz\n", dmclk_governor_to_string(governor->policy),
+                  governor->min_frequency, governor->max_frequency);
+    return 0;
+}
+#endif // DMCLK_STATIC_CONFIG
+
+/**
+ * @brief Change the governor policy
+ */
+int dmclk_governor_set_policy(struct dmclk_governor* governor, dmclk_governor_t policy)
+{
+    if (policy > dmclk_governor_conservative)
+    {
+        DMOD_LOG_ERROR("Invalid governor policy %d\n", (int)policy);
+        return -EINVAL;
+    }
+    if (policy != dmclk_governor_none && governor->sampling_period_us == 0)
+    {
+        DMOD_LOG_ERROR("Governor parameters not configured\n");
+        return -EINVAL;
+    }
+    governor->policy = policy;
+    governor->busy_us = 0;
+    governor->period_us = 0;
+    governor->low_count = 0;
+    return 0;
+}
+
+/**
+ * @brief Get the target the governor wants to start from
+ */
+dmclk_frequency_t dmclk_governor_initial_target(const struct dmclk_governor* governor, dmclk_frequency_t current_target)
+{
+    switch (governor->policy)
+    {
+        case dmclk_governor_performance:
+            return governor->max_frequency;
+        case dmclk_governor_powersave:
+            return governor->min_frequency;
+        case dmclk_governor_ondemand:
+        case dmclk_governor_conservative:
+            return clamp_frequency(governor, (uint32_t)current_target);
+        default:
+            return current_target;
+    }
+}
+
+/**
+ * @brief Feed a load sample to the governor
+ */
+int dmclk_governor_sample(struct dmclk_governor* governor, const dmclk_load_sample_t* sample, dmclk_frequency_t current_target, dmclk_frequency_t* new_target)
+{
+    *new_target = current_target;
+
+    governor->busy_us += (sample->busy_us < sample->period_us) ? sample->busy_us : sample->period_us;
+    governor->period_us += sample->period_us;
+    if (governor->period_us < governor->sampling_period_us)
+    {
+        return 0;
+    }
+
+    /* Period is at least 1 ms here, so the 32-bit division is exact enough */
+    uint32_t load = governor->busy_us / (governor->period_us / 100U);
+    governor->busy_us = 0;
+    governor->period_us = 0;
+
+    uint32_t current = (uint32_t)current_target;
+    int lower = 0;
+    if (load >= governor->up_threshold)
+    {
+        governor->low_count = 0;
+    }
+    else if (load < governor->down_threshold)
+    {
+        if (++governor->low_count >= governor->down_samples)
+        {
+            governor->low_count = 0;
+            lower = 1;
+        }
+    }
+    else
+    {
+        governor->low_count = 0;
+    }
+
+    switch (governor->policy)
+    {
+        case dmclk_governor_performance:
+            *new_target = governor->max_frequency;
+            break;
+        case dmclk_governor_powersave:
+            *new_target = governor->min_frequency;
+            break;
+        case dmclk_governor_ondemand:
+            if (load >= governor->up_threshold)
+            {
+                *new_target = governor->max_frequency;
+            }
+            else if (lower)
+            {
+                /* Lowest frequency at which the same work keeps the load just under up_threshold */
+                *new_target = clamp_frequency(governor, (current / governor->up_threshold) * load);
+            }
+            break;
+        case dmclk_governor_conservative:
+            if (load >= governor->up_threshold)
+            {
+                *new_target = clamp_frequency(governor, current + (uint32_t)governor->step);
+            }
+            else if (lower)
+            {
+                uint32_t step = (uint32_t)governor->step;
+                *new_target = clamp_frequency(governor, (current > step) ? (current - step) : 0U);
+            }
+            break;
+        default:
+            break;
+    }
+
+    return (*new_target != current_target) ? 1 : 0;
+}
@@ -0,0 +1,86 @@
+#ifndef DMCLK_GOVERNOR_H
+#define DMCLK_GOVERNOR_H
+
+#include "dmclk.h"
+#include "dmini.h"
+
+/**
+ * @brief Load-driven frequency governor state
+ *
+ * The governor is pure policy: it accumulates load samples and proposes a new
+ * target frequency. Applying it is left to the caller, which goes through the
+ * regular configure() path.
+ */
+struct dmclk_governor
+{
+    dmclk_governor_t policy;                /**< Active policy */
+    dmclk_frequency_t min_frequency;        /**< Lowest target the governor may select */
+    dmclk_frequency_t max_frequency;        /**< Highest target the governor may select */
+    dmclk_frequency_t step;                 /**< Frequency step of the conservative policy */
+    uint32_t sampling_period_us;            /**< Load is evaluated once this much time was sampled */
+    uint32_t up_threshold;                  /**< Load in percent at or above which the frequency is raised */
+    uint32_t down_threshold;                /**< Load in percent below which the frequency may be lowered */
+    uint32_t down_samples;                  /**< Consecutive low-load periods required before lowering */
+    uint32_t busy_us;                       /**< Busy time accumulated in the current period */
+    uint32_t period_us;                     /**< Time accumulated in the current period */
+    uint32_t low_count;                     /**< Number of consecutive low-load periods */
+};
+
+#ifndef DMCLK_STATIC_CONFIG
+/**
+ * @brief Read governor parameters from the [dmclk] section
+ *
+ * Not available in static configuration builds, where tools/plangen reads them
+ * at build time.
+ *
+ * @param governor Governor to initialize
+ * @param config Dmini context with configuration data
+ * @param target_frequency Configured target frequency, used for defaults
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+int dmclk_governor_read_config(struct dmclk_governor* governor, dmini_context_t config, dmclk_frequency_t target_frequency);
+#endif
+
+/**
+ * @brief Change the governor policy
+ *
+ * @param governor Governor
+ * @param policy New policy
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+int dmclk_governor_set_policy(struct dmclk_governor* governor, dmclk_governor_t policy);
+
+/**
+ * @brief Get the target the governor wants to start from
+ *
+ * @param governor Governor
+ * @param current_target Current target frequency
+ *
+ * @return dmclk_frequency_t Initial target frequency for the active policy
+ */
+dmclk_frequency_t dmclk_governor_initial_target(const struct dmclk_governor* governor, dmclk_frequency_t current_target);
+
+/**
+ * @brief Feed a load sample to the governor
+ *
+ * @param governor Governor
+ * @param sample Load sample
+ * @param current_target Current target frequency
+ * @param new_target Output target frequency proposed by the governor
+ *
+ * @return int 1 if the proposed target differs from @p current_target, 0 otherwise
+ */
+int dmclk_governor_sample(struct dmclk_governor* governor, const dmclk_load_sample_t* sample, dmclk_frequency_t current_target, dmclk_frequency_t* new_target);
+
+/**
+ * @brief Convert governor policy to string
+ *
+ * @param policy Governor policy
+ *
+ * @return const char* String representation of the policy
+ */
+const char* dmclk_governor_to_string(dmclk_governor_t policy);
+
+#endif // DMCLK_GOVERNOR_H
@@ -0,0 +1,7 @@
+# The simulation port is built by the host projects (tests/dmclk-sim-test,
+# tools/plangen), which only take DMCLK_PORT_DEFINITIONS from here. The tools
+# name is only used by a DMOD module build, which CI does not run for sim.
+set(DMOD_TOOLS_NAME	"arch/x86_64" CACHE STRING "Name of the tools configuration")
+# The register polling loops of stm32_common advance the simulated hardware
+# and its register accesses are counted and traced
+set(DMCLK_PORT_DEFINITIONS STM32_POLL_HOOK_ENABLED STM32_REG_ACCESS_HOOKED)
@@ -0,0 +1,561 @@
+#include <string.h>
+#include "dmclk_port.h"
+#include "../stm32_common/stm32_common.h"
+#include "port/stm32_common_regs.h"
+#include "port/stm32f7_regs.h"
+#include "port/dmclk_sim.h"
+
+/*
+ * Simulation port
+ *
+ * The RCC, FLASH, PWR and GPIO registers of an STM32F7 live in RAM and the
+ * unmodified STM32 common code programs them. stm32_poll_hook(), called from
+ * every register polling loop of the common code, plays the hardware: it
+ * raises the ready flags after the modelled start-up times, follows SW with
+ * SWS and checks the running configuration against the limits of the part.
+ * stm32_reg_read()/stm32_reg_write() count and trace the accesses.
+ * The port API is the common one (stm32_port.c), driven by stm32_family below.
+ */
+
+/* Register file of the modelled part */
+static RCC_TypeDef sim_rcc;
+static FLASH_TypeDef sim_flash;
+static PWR_TypeDef sim_pwr;
+static GPIO_TypeDef sim_gpioa;
+static GPIO_TypeDef sim_gpioc;
+
+#define SIM_RCC_BASE        ((uintptr_t)&sim_rcc)
+#define SIM_FLASH_BASE      ((uintptr_t)&sim_flash)
+#define SIM_PWR_BASE        ((uintptr_t)&sim_pwr)
+#define SIM_GPIOA_BASE      ((uintptr_t)&sim_gpioa)
+#define SIM_GPIOC_BASE      ((uintptr_t)&sim_gpioc)
+
+/* Reset values (RM0385) */
+#define SIM_RCC_CR_RESET        (RCC_CR_HSION | RCC_CR_HSIRDY)
+#define SIM_RCC_PLLCFGR_RESET   0x24003010U
+#define SIM_PWR_CR1_RESET       STM32F7_PWR_VOS_PERFORMANCE
+
+/* HCLK limit of voltage scale 3 */
+#define SIM_MAX_HCLK_LOW_POWER  144000000U
+
+/* State of the modelled hardware that is not visible in the registers */
+typedef struct
+{
+    uint32_t hsi_timer;
+    uint32_t hse_timer;
+    uint32_t pll_timer;
+    uint32_t plli2s_timer;
+    uint32_t pllsai_timer;
+    uint32_t overdrive_timer;
+    uint32_t switch_timer;
+    uint32_t locked_pllcfgr;        /* RCC_PLLCFGR seen when the PLL locked */
+    uint32_t hse_frequency;         /* Crystal fitted on the modelled board */
+    int hse_failed;
+    int pll_failed;                 /* The main PLL does not lock */
+    int rcc_irq_pending;            /* RCC interrupt set pending by software (NVIC) */
+    uint32_t cycles;                /* Core cycles, stands in for DWT CYCCNT */
+    uint32_t active_violations;     /* Violations of the current configuration */
+    dmclk_sim_stats_t stats;
+} sim_state_t;
+
+static sim_state_t sim;
+
+/* Trace of the register accesses of the common code */
+static dmclk_sim_trace_entry_t *trace_buffer = NULL;
+static uint32_t trace_capacity = 0;
+static uint32_t trace_count = 0;
+
+/**
+ * @brief Model an oscillator or PLL: the ready flag follows the enable bit after a delay
+ *
+ * @return int 1 when the ready flag has just been raised, 0 otherwise
+ */
+static int sim_oscillator(uint32_t on_bit, uint32_t ready_bit, uint32_t *timer, uint32_t ticks, int can_run)
+{
+    if (!(sim_rcc.CR & on_bit) || !can_run) {
+        sim_rcc.CR &= ~ready_bit;
+        *timer = 0;
+        return 0;
+    }
+    if (!(sim_rcc.CR & ready_bit) && ++(*timer) >= ticks) {
+        sim_rcc.CR |= ready_bit;
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Check whether the oscillator selected by a SW value is ready
+ */
+static int sim_source_ready(uint32_t sw)
+{
+    switch (sw) {
+        case RCC_CFGR_SW_HSI: return (sim_rcc.CR & RCC_CR_HSIRDY) != 0;
+        case RCC_CFGR_SW_HSE: return (sim_rcc.CR & RCC_CR_HSERDY) != 0;
+        case RCC_CFGR_SW_PLL: return (sim_rcc.CR & RCC_CR_PLLRDY) != 0;
+        default:              return 0;
+    }
+}
+
+/**
+ * @brief Switch SYSCLK to HSI and stop the PLL, as the hardware does on an HSE failure
+ */
+static void sim_fall_back_to_hsi(void)
+{
+    sim_rcc.CR &= ~(RCC_CR_PLLON | RCC_CR_PLLRDY);
+    sim_rcc.CFGR &= ~(RCC_CFGR_SW_Msk | RCC_CFGR_SWS_Msk);
+    sim.pll_timer = 0;
+}
+
+/**
+ * @brief Check the running configuration against the limits of the part
+ *
+ * Also counts the core cycles of the tick - a tick stands for one microsecond.
+ */
+static uint32_t sim_check_limits(void)
+{
+    dmclk_clock_tree_t tree;
+    uint32_t violations = 0;
+
+    if (stm32_get_clock_tree(SIM_RCC_BASE, HSI_VALUE, sim.hse_frequency, &tree) != 0) {
+        return 0;
+    }
+    sim.cycles += (uint32_t)(tree.hclk / 1000000U);
+
+    uint32_t latency = (sim_flash.ACR & FLASH_ACR_LATENCY_Msk) >> FLASH_ACR_LATENCY_Pos;
+    if (latency < stm32_calculate_flash_latency((uint32_t)tree.hclk, &stm32_family.limits)) {
+        violations |= DMCLK_SIM_VIOLATION_FLASH_LATENCY;
+    }
+    if (tree.hclk > STM32F7_MAX_SYSCLK_NO_OVERDRIVE && !(sim_pwr.CSR1 & PWR_CSR1_ODSWRDY)) {
+        violations |= DMCLK_SIM_VIOLATION_OVERDRIVE;
+    }
+    if ((sim_pwr.CR1 & STM32F7_PWR_VOS_Msk) == STM32F7_PWR_VOS_LOW_POWER && tree.hclk > SIM_MAX_HCLK_LOW_POWER) {
+        violations |= DMCLK_SIM_VIOLATION_VOLTAGE_SCALE;
+    }
+    if (tree.pclk1 > STM32F7_MAX_PCLK1 || tree.pclk2 > STM32F7_MAX_PCLK2) {
+        violations |= DMCLK_SIM_VIOLATION_APB_LIMIT;
+    }
+    return violations;
+}
+
+/**
+ * @brief Record violations
+ *
+ * Sequence violations are events, limit violations last as long as the
+ * configuration does and are counted once from their onset.
+ */
+static void sim_report(uint32_t events, uint32_t limits)
+{
+    uint32_t counted = events | (limits & ~sim.active_violations);
+
+    for (uint32_t bit = counted; bit != 0U; bit &= bit - 1U) {
+        sim.stats.violations++;
+    }
+    sim.stats.violation_mask |= events | limits;
+    sim.active_violations = limits;
+}
+
+/* Register blocks indexed by dmclk_sim_block_t */
+static const struct {
+    const volatile void *base;
+    size_t size;
+} sim_blocks[] = {
+    [dmclk_sim_block_rcc]   = { &sim_rcc,   sizeof(sim_rcc) },
+    [dmclk_sim_block_flash] = { &sim_flash, sizeof(sim_flash) },
+    [dmclk_sim_block_pwr]   = { &sim_pwr,   sizeof(sim_pwr) },
+    [dmclk_sim_block_gpioa] = { &sim_gpioa, sizeof(sim_gpioa) },
+    [dmclk_sim_block_gpioc] = { &sim_gpioc, sizeof(sim_gpioc) },
+};
+
+/**
+ * @brief Find the register block and offset of an address
+ */
+static dmclk_sim_block_t sim_decode(const volatile uint32_t *reg, uint16_t *offset)
+{
+    uintptr_t address = (uintptr_t)reg;
+
+    for (uint32_t i = 0; i < sizeof(sim_blocks) / sizeof(sim_blocks[0]); i++) {
+        uintptr_t base = (uintptr_t)sim_blocks[i].base;
+        if (address >= base && address < base + sim_blocks[i].size) {
+            *offset = (uint16_t)(address - base);
+            return (dmclk_sim_block_t)i;
+        }
+    }
+    *offset = 0;
+    return dmclk_sim_block_unknown;
+}
+
+/**
+ * @brief Record a register access
+ */
+static void sim_trace(int write, const volatile uint32_t *reg, uint32_t value)
+{
+    if (write) {
+        sim.stats.reg_writes++;
+    } else {
+        sim.stats.reg_reads++;
+    }
+
+    if (trace_buffer == NULL) {
+        return;
+    }
+    if (trace_count < trace_capacity) {
+        dmclk_sim_trace_entry_t *entry = &trace_buffer[trace_count];
+        entry->sequence = trace_count;
+        entry->write = (uint8_t)write;
+        entry->block = (uint8_t)sim_decode(reg, &entry->offset);
+        entry->value = value;
+    }
+    trace_count++;
+}
+
+/**
+ * @brief Register read of the common code
+ */
+uint32_t stm32_reg_read(const volatile uint32_t *reg)
+{
+    uint32_t value = *reg;
+    sim_trace(0, reg, value);
+    return value;
+}
+
+/**
+ * @brief Register write of the common code
+ */
+void stm32_reg_write(volatile uint32_t *reg, uint32_t value)
+{
+    sim_trace(1, reg, value);
+    *reg = value;
+}
+
+/**
+ * @brief Advance the model by one tick - called from the register polling loops
+ */
+void stm32_poll_hook(void)
+{
+    uint32_t events = 0;
+    uint32_t sws = (sim_rcc.CFGR & RCC_CFGR_SWS_Msk) >> RCC_CFGR_SWS_Pos;
+
+    sim.stats.ticks++;
+
+    /* The PLL cannot be stopped while it drives SYSCLK. The hardware keeps
+     * PLLON set, which would make the caller wait forever - report it and
+     * fall back to HSI instead so the run can go on. */
+    if (!(sim_rcc.CR & RCC_CR_PLLON) && (sim_rcc.CR & RCC_CR_PLLRDY) && sws == RCC_CFGR_SW_PLL) {
+        events |= DMCLK_SIM_VIOLATION_PLL_IN_USE;
+        sim_fall_back_to_hsi();
+        sws = RCC_CFGR_SW_HSI;
+    }
+
+    /* Only PLLON may be changed while the PLL runs, RCC_PLLCFGR writes are ignored */
+    if ((sim_rcc.CR & RCC_CR_PLLRDY) && sim_rcc.PLLCFGR != sim.locked_pllcfgr) {
+        events |= DMCLK_SIM_VIOLATION_PLL_RECONFIGURED;
+        sim.locked_pllcfgr = sim_rcc.PLLCFGR;
+    }
+
+    int pll_input_ready = (sim_rcc.PLLCFGR & RCC_PLLCFGR_PLLSRC) ? (sim_rcc.CR & RCC_CR_HSERDY) != 0
+                                                                 : (sim_rcc.CR & RCC_CR_HSIRDY) != 0;
+
+    sim_oscillator(RCC_CR_HSION, RCC_CR_HSIRDY, &sim.hsi_timer, DMCLK_SIM_HSI_STARTUP_TICKS, 1);
+    if (sim_oscillator(RCC_CR_HSEON, RCC_CR_HSERDY, &sim.hse_timer, DMCLK_SIM_HSE_STARTUP_TICKS, !sim.hse_failed)) {
+        sim.stats.hse_startups++;
+        if (sim_rcc.CIR & RCC_CIR_HSERDYIE) {
+            sim_rcc.CIR |= RCC_CIR_HSERDYF;
+        }
+    }
+    /* A failed PLL keeps running while it is locked, it only does not lock again */
+    int pll_can_lock = pll_input_ready && (!sim.pll_failed || (sim_rcc.CR & RCC_CR_PLLRDY));
+    if (sim_oscillator(RCC_CR_PLLON, RCC_CR_PLLRDY, &sim.pll_timer, DMCLK_SIM_PLL_LOCK_TICKS, pll_can_lock)) {
+        sim.locked_pllcfgr = sim_rcc.PLLCFGR;
+        sim.stats.pll_locks++;
+        if (sim_rcc.CIR & RCC_CIR_PLLRDYIE) {
+            sim_rcc.CIR |= RCC_CIR_PLLRDYF;
+        }
+    }
+    sim_oscillator(RCC_CR_PLLI2SON, RCC_CR_PLLI2SRDY, &sim.plli2s_timer, DMCLK_SIM_PLL_LOCK_TICKS, pll_input_ready);
+    sim_oscillator(RCC_CR_PLLSAION, RCC_CR_PLLSAIRDY, &sim.pllsai_timer, DMCLK_SIM_PLL_LOCK_TICKS, pll_input_ready);
+
+    /* Over-Drive */
+    if (!(sim_pwr.CR1 & PWR_CR1_ODEN)) {
+        sim_pwr.CSR1 &= ~(PWR_CSR1_ODRDY | PWR_CSR1_ODSWRDY);
+        sim.overdrive_timer = 0;
+    } else if (!(sim_pwr.CSR1 & PWR_CSR1_ODRDY) && ++sim.overdrive_timer >= DMCLK_SIM_OVERDRIVE_TICKS) {
+        sim_pwr.CSR1 |= PWR_CSR1_ODRDY;
+    }
+    if ((sim_pwr.CR1 & PWR_CR1_ODSWEN) && (sim_pwr.CSR1 & PWR_CSR1_ODRDY)) {
+        sim_pwr.CSR1 |= PWR_CSR1_ODSWRDY;
+    }
+
+    /* SWS follows SW once the selected oscillator is ready */
+    uint32_t sw = (sim_rcc.CFGR & RCC_CFGR_SW_Msk) >> RCC_CFGR_SW_Pos;
+    if (sw == sws || !sim_source_ready(sw)) {
+        sim.switch_timer = 0;
+    } else if (++sim.switch_timer >= DMCLK_SIM_CLOCKSWITCH_TICKS) {
+        sim_rcc.CFGR = (sim_rcc.CFGR & ~RCC_CFGR_SWS_Msk) | (sw << RCC_CFGR_SWS_Pos);
+        sim.switch_timer = 0;
+        sim.stats.clock_switches++;
+    }
+
+    /* CSSC acknowledges the HSE failure */
+    if (sim_rcc.CIR & RCC_CIR_CSSC) {
+        sim_rcc.CIR &= ~(RCC_CIR_CSSC | RCC_CIR_CSSF);
+    }
+
+    /* HSERDYC / PLLRDYC acknowledge the ready interrupts */
+    if (sim_rcc.CIR & RCC_CIR_HSERDYC) {
+        sim_rcc.CIR &= ~(RCC_CIR_HSERDYC | RCC_CIR_HSERDYF);
+    }
+    if (sim_rcc.CIR & RCC_CIR_PLLRDYC) {
+        sim_rcc.CIR &= ~(RCC_CIR_PLLRDYC | RCC_CIR_PLLRDYF);
+    }
+
+    sim_report(events, sim_check_limits());
+}
+
+/**
+ * @brief Return the registers to their reset values and clear the counters
+ */
+void dmclk_sim_reset(void)
+{
+    memset(&sim_rcc, 0, sizeof(sim_rcc));
+    memset(&sim_flash, 0, sizeof(sim_flash));
+    memset(&sim_pwr, 0, sizeof(sim_pwr));
+    memset(&sim_gpioa, 0, sizeof(sim_gpioa));
+    memset(&sim_gpioc, 0, sizeof(sim_gpioc));
+    memset(&sim, 0, sizeof(sim));
+
+    sim_rcc.CR = SIM_RCC_CR_RESET;
+    sim_rcc.PLLCFGR = SIM_RCC_PLLCFGR_RESET;
+    sim_pwr.CR1 = SIM_PWR_CR1_RESET;
+
+    stm32_port_reset();
+}
+
+/**
+ * @brief Take the RCC interrupt if a ready flag or the NVIC has it pending
+ */
+static void sim_deliver_rcc_irq(void)
+{
+    if (sim.rcc_irq_pending || (sim_rcc.CIR & (RCC_CIR_HSERDYF | RCC_CIR_PLLRDYF))) {
+        sim.rcc_irq_pending = 0;
+        sim.stats.rcc_interrupts++;
+        dmclk_port_rcc_irq_handler();
+    }
+}
+
+/**
+ * @brief Advance the model
+ */
+void dmclk_sim_tick(uint32_t ticks)
+{
+    for (uint32_t i = 0; i < ticks; i++) {
+        stm32_poll_hook();
+
+        /* The polling loops run with the RCC interrupt masked - only here it can be taken */
+        sim_deliver_rcc_irq();
+    }
+}
+
+/**
+ * @brief Read the counters collected by the model
+ */
+void dmclk_sim_get_stats(dmclk_sim_stats_t* stats)
+{
+    if (stats != NULL) {
+        *stats = sim.stats;
+    }
+}
+
+/**
+ * @brief Read a register of the modelled part
+ */
+uint32_t dmclk_sim_read_register(dmclk_sim_block_t block, uint16_t offset)
+{
+    if ((uint32_t)block >= sizeof(sim_blocks) / sizeof(sim_blocks[0])
+     || offset + sizeof(uint32_t) > sim_blocks[block].size) {
+        return 0;
+    }
+    return *(const volatile uint32_t *)((uintptr_t)sim_blocks[block].base + offset);
+}
+
+/**
+ * @brief Record the register accesses of the common code
+ */
+void dmclk_sim_trace_start(dmclk_sim_trace_entry_t* buffer, uint32_t capacity)
+{
+    trace_buffer = buffer;
+    trace_capacity = (buffer != NULL) ? capacity : 0;
+    trace_count = 0;
+}
+
+/**
+ * @brief Stop recording
+ */
+uint32_t dmclk_sim_trace_stop(void)
+{
+    trace_buffer = NULL;
+    trace_capacity = 0;
+    return trace_count;
+}
+
+/**
+ * @brief Make the external oscillator fail
+ */
+void dmclk_sim_inject_hse_failure(void)
+{
+    uint32_t sws = (sim_rcc.CFGR & RCC_CFGR_SWS_Msk) >> RCC_CFGR_SWS_Pos;
+    int hse_was_ready = (sim_rcc.CR & RCC_CR_HSERDY) != 0;
+
+    sim.hse_failed = 1;
+    sim_rcc.CR &= ~RCC_CR_HSERDY;
+    sim.hse_timer = 0;
+
+    if (!hse_was_ready || !(sim_rcc.CR & RCC_CR_CSSON)) {
+        /* Without CSS nothing notices - the next polling loop times out */
+        return;
+    }
+
+    /* CSS: HSE is switched off and SYSCLK taken over by HSI if it ran from HSE */
+    sim_rcc.CR &= ~RCC_CR_HSEON;
+    sim_rcc.CIR |= RCC_CIR_CSSF;
+    if (sws == RCC_CFGR_SW_HSE || (sws == RCC_CFGR_SW_PLL && (sim_rcc.PLLCFGR & RCC_PLLCFGR_PLLSRC))) {
+        sim_fall_back_to_hsi();
+    }
+
+    /* The NMI, then the RCC interrupt it pends */
+    dmclk_port_css_irq_handler();
+    sim_deliver_rcc_irq();
+}
+
+/**
+ * @brief Allow the external oscillator to start again
+ */
+void dmclk_sim_repair_hse(void)
+{
+    sim.hse_failed = 0;
+}
+
+/**
+ * @brief Make the main PLL fail to lock
+ */
+void dmclk_sim_inject_pll_failure(void)
+{
+    sim.pll_failed = 1;
+}
+
+/**
+ * @brief Allow the main PLL to lock again
+ */
+void dmclk_sim_repair_pll(void)
+{
+    sim.pll_failed = 0;
+}
+
+/**
+ * @brief Take the crystal of the modelled board from the plan
+ *
+ * External plans then work with any oscillator frequency from the configuration.
+ */
+static void sim_apply_plan(const dmclk_port_plan_t *plan)
+{
+    if (STM32_PLAN_CONST(plan)->hse_freq != 0) {
+        sim.hse_frequency = STM32_PLAN_CONST(plan)->hse_freq;
+    }
+}
+
+/**
+ * @brief Set the RCC interrupt pending in the modelled NVIC
+ */
+static void sim_pend_rcc_irq(void)
+{
+    sim.rcc_irq_pending = 1;
+}
+
+/**
+ * @brief Model STOP mode
+ *
+ * The model wakes up immediately in the state the hardware leaves behind:
+ * HSE and all PLLs off, Over-Drive off and SYSCLK running from HSI.
+ */
+static void sim_enter_stop(void)
+{
+    sim_rcc.CR &= ~(RCC_CR_HSEON | RCC_CR_HSERDY | RCC_CR_PLLON | RCC_CR_PLLRDY |
+                    RCC_CR_PLLI2SON | RCC_CR_PLLI2SRDY | RCC_CR_PLLSAION | RCC_CR_PLLSAIRDY);
+    sim_rcc.CR |= RCC_CR_HSION | RCC_CR_HSIRDY;
+    sim_rcc.CFGR &= ~(RCC_CFGR_SW_Msk | RCC_CFGR_SWS_Msk);
+    sim_pwr.CR1 &= ~(PWR_CR1_ODEN | PWR_CR1_ODSWEN);
+    sim_pwr.CSR1 &= ~(PWR_CSR1_ODRDY | PWR_CSR1_ODSWRDY);
+}
+
+/**
+ * @brief Delay for a specified time in microseconds
+ *
+ * Nothing runs from the modelled clocks, so the time is only accounted.
+ */
+static void sim_delay_us(dmclk_time_us_t time_us)
+{
+    sim.stats.delay_us += time_us;
+}
+
+/**
+ * @brief Busy-wait delay
+ *
+ * Returns the cycle count the modelled core would have spent without
+ * waiting, so measurements built on it finish instantly on the host.
+ */
+static uint64_t sim_delay(uint32_t seconds, uint32_t hclk)
+{
+    sim.stats.delay_us += (uint64_t)seconds * 1000000U;
+    return (uint64_t)hclk * (uint64_t)seconds;
+}
+
+/**
+ * @brief Cycle counter of the modelled core
+ */
+static uint32_t sim_cycle_count(void)
+{
+    return sim.cycles;
+}
+
+static const stm32_port_hooks_t sim_hooks = {
+    .init = dmclk_sim_reset,
+    .apply_plan = sim_apply_plan,
+    .enter_stop = sim_enter_stop,
+    .delay_us = sim_delay_us,
+    .delay = sim_delay,
+    .pend_rcc_irq = sim_pend_rcc_irq,
+    .cycle_count = sim_cycle_count,
+};
+
+/* The modelled part: an STM32F7 whose registers live in RAM */
+const stm32_family_t stm32_family = {
+    .name = "simulation",
+    .rcc_base = SIM_RCC_BASE,
+    .flash_base = SIM_FLASH_BASE,
+    .pwr_base = SIM_PWR_BASE,
+    .gpioa_base = SIM_GPIOA_BASE,
+    .gpioc_base = SIM_GPIOC_BASE,
+    .limits = {
+        .max_sysclk = STM32F7_MAX_SYSCLK,
+        .max_hclk = STM32F7_MAX_HCLK,
+        .max_pclk1 = STM32F7_MAX_PCLK1,
+        .max_pclk2 = STM32F7_MAX_PCLK2,
+        .vco_min = STM32F7_VCO_MIN,
+        .vco_max = STM32F7_VCO_MAX,
+        .pll_in_min = STM32F7_PLL_IN_MIN,
+        .pll_in_max = STM32F7_PLL_IN_MAX,
+        .pllm_min = STM32F7_PLLM_MIN,
+        .pllm_max = STM32F7_PLLM_MAX,
+        .plln_min = STM32F7_PLLN_MIN,
+        .plln_max = STM32F7_PLLN_MAX,
+        .pllp_min = STM32F7_PLLP_MIN,
+        .pllp_max = STM32F7_PLLP_MAX,
+        .max_sysclk_no_overdrive = STM32F7_MAX_SYSCLK_NO_OVERDRIVE,
+        .vos_msk = STM32F7_PWR_VOS_Msk,
+        .vos_performance = STM32F7_PWR_VOS_PERFORMANCE,
+        .vos_low_power = STM32F7_PWR_VOS_LOW_POWER,
+        .flash_latency_table = stm32f7_flash_latency,
+        .flash_latency_count = STM32F7_FLASH_LATENCY_COUNT,
+    },
+    .hooks = &sim_hooks,
+};
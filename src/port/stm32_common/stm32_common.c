@@ -16,6 +16,39 @@
 #define ARM_DWT_CYCCNT                  (*(volatile uint32_t *)ARM_DWT_CYCCNT_ADDR)
 #define ARM_DWT_LAR                     (*(volatile uint32_t *)ARM_DWT_LAR_ADDR)
 
+/* System Control Register - selects STOP (deep sleep) for WFI */
+#define ARM_SCB_SCR_ADDR                0xE000ED10UL
+#define ARM_SCB_SCR_SLEEPDEEP_Msk       (1UL << 2)
+#define ARM_SCB_SCR                     (*(volatile uint32_t *)ARM_SCB_SCR_ADDR)
+
+/* AHB prescaler divisors indexed by RCC_CFGR.HPRE (0xxx = not divided) */
+static const uint16_t stm32_ahb_divisors[16] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 2, 4, 8, 16, 64, 128, 256, 512
+};
+
+/* APB prescaler divisors indexed by RCC_CFGR.PPREx (0xx = not divided) */
+static const uint8_t stm32_apb_divisors[8] = {
+    1, 1, 1, 1, 2, 4, 8, 16
+};
+
+/* LCD-TFT post-divider values indexed by RCC_DCKCFGR.PLLSAIDIVR */
+static const uint8_t stm32_pllsai_divr[4] = {
+    2, 4, 8, 16
+};
+
+/**
+ * @brief Requested output of a dedicated PLL and the dividers found for it
+ */
+typedef struct {
+    uint32_t target;            /* Requested frequency in Hz, 0 if the output is unused */
+    uint32_t div_min;           /* Range of the PLL output divider */
+    uint32_t div_max;
+    const uint8_t *post;        /* Post-divider values by register code, NULL for 1, 2, 3, ... */
+    uint32_t post_count;        /* Number of post-divider codes, 1 if there is none */
+    uint32_t div;               /* Found PLL output divider */
+    uint32_t post_code;         /* Found post-divider register code */
+} stm32_pll_output_t;
+
 static int stm32_dwt_cyccnt_is_running(void)
 {
     uint32_t probe_start = ARM_DWT_CYCCNT;
@@ -23,6 +56,21 @@ static int stm32_dwt_cyccnt_is_running(void)
     return (ARM_DWT_CYCCNT != probe_start);
 }
 
+/**
+ * @brief Smallest main PLL Q divider keeping the 48 MHz domain within its limit
+ */
+static uint32_t stm32_pll48_divider(uint32_t vco)
+{
+    uint32_t pllq = (vco + PLL48_MAX_FREQ - 1U) / PLL48_MAX_FREQ;
+    if (pllq < RCC_PLLxCFGR_PLLQ_MIN) {
+        pllq = RCC_PLLxCFGR_PLLQ_MIN;
+    }
+    if (pllq > RCC_PLLxCFGR_PLLQ_MAX) {
+        pllq = RCC_PLLxCFGR_PLLQ_MAX;
+    }
+    return pllq;
+}
+
 /**
  * @brief Calculate PLL parameters for target frequency
  */
@@ -96,7 +144,7 @@ int stm32_calculate_pll_config(dmclk_frequency_t target_freq,
                 best_config.pllm = pllm;
                 best_config.plln = plln;
                 best_config.pllp = pllp;
-                best_config.pllq = 4; /* Default value for USB, can be optimized */
+                best_config.pllq = stm32_pll48_divider(vco);
                 found = 1;
 
                 /* Perfect match found */
@@ -123,37 +171,206 @@ int stm32_calculate_pll_config(dmclk_frequency_t target_freq,
 }
 
 /**
- * @brief Configure Flash latency based on system clock frequency
+ * @brief Find the dividers bringing a VCO frequency closest to an output target
+ *
+ * @return uint32_t Error of the best dividers in Hz
+ */
+static uint32_t stm32_best_pll_output(uint32_t vco, stm32_pll_output_t *output)
+{
+    uint32_t best_error = 0xFFFFFFFFU;
+
+    for (uint32_t code = 0; code < output->post_count; code++) {
+        uint32_t post = (output->post != NULL) ? output->post[code] : (code + 1U);
+        /* Only the two dividers around the ideal ratio can be the closest */
+        uint32_t ideal = (uint32_t)(vco / ((uint64_t)post * output->target));
+        for (uint32_t div = ideal; div <= ideal + 1U; div++) {
+            if (div < output->div_min || div > output->div_max) {
+                continue;
+            }
+            uint32_t freq = vco / (div * post);
+            uint32_t error = (freq > output->target) ? (freq - output->target) : (output->target - freq);
+            if (error < best_error) {
+                best_error = error;
+                output->div = div;
+                output->post_code = code;
+            }
+        }
+    }
+    return best_error;
+}
+
+/**
+ * @brief Calculate PLLN of a dedicated PLL for a fixed input frequency
+ *
+ * Same search as stm32_calculate_pll_config(), except that PLLM is owned by the
+ * main PLL: only the multiplier and the output dividers are free, and all
+ * requested outputs of the PLL must be met by the same VCO.
+ *
+ * @return int 0 on success, non-zero if an output cannot be reached
  */
-int stm32_configure_flash_latency(uint32_t sysclk_freq,
-                                   uintptr_t flash_base,
-                                   const void *latency_table,
-                                   uint32_t table_size)
+static int stm32_calculate_dedicated_pll(uint32_t pll_in,
+                                         uint32_t tolerance,
+                                         const clock_limits_t *limits,
+                                         stm32_pll_output_t *outputs,
+                                         uint32_t output_count,
+                                         uint32_t *plln)
 {
-    if (latency_table == NULL) {
+    stm32_pll_output_t best_outputs[2];
+    uint64_t best_error = UINT64_MAX;
+
+    if (output_count > 2U) {
         return -1;
     }
 
-    volatile FLASH_TypeDef *FLASH = (FLASH_TypeDef *)flash_base;
-    const struct { uint32_t max_freq; uint32_t latency; } *table = 
-        (const struct { uint32_t max_freq; uint32_t latency; } *)latency_table;
+    for (uint32_t n = limits->plln_min; n <= limits->plln_max; n++) {
+        uint32_t vco = pll_in * n;
+        if (vco < limits->vco_min || vco > limits->vco_max) {
+            continue;
+        }
+
+        uint64_t error = 0;
+        int valid = 1;
+        for (uint32_t i = 0; i < output_count && valid; i++) {
+            if (outputs[i].target == 0) {
+                continue;
+            }
+            uint32_t output_error = stm32_best_pll_output(vco, &outputs[i]);
+            valid = (output_error <= tolerance);
+            error += output_error;
+        }
+
+        if (valid && error < best_error) {
+            best_error = error;
+            *plln = n;
+            for (uint32_t i = 0; i < output_count; i++) {
+                best_outputs[i] = outputs[i];
+            }
+            if (error == 0) {
+                break;
+            }
+        }
+    }
+
+    if (best_error == UINT64_MAX) {
+        return -1;
+    }
+    for (uint32_t i = 0; i < output_count; i++) {
+        outputs[i] = best_outputs[i];
+    }
+    return 0;
+}
+
+/**
+ * @brief Check whether any PLLI2S / PLLSAI output is requested
+ */
+static int stm32_peripheral_clocks_used(const dmclk_peripheral_clocks_t *peripheral)
+{
+    return peripheral != NULL
+        && (peripheral->i2s_frequency != 0 || peripheral->sai_frequency != 0 || peripheral->lcd_frequency != 0);
+}
+
+/**
+ * @brief Plan PLLI2S and PLLSAI for a PLL input frequency
+ *
+ * Outputs that are not requested get their largest divider and stay unused.
+ *
+ * @return int 0 on success, non-zero if a requested output cannot be reached
+ */
+static int stm32_plan_dedicated_plls(uint32_t pll_in,
+                                     const dmclk_peripheral_clocks_t *peripheral,
+                                     const clock_limits_t *limits,
+                                     stm32_plan_t *stm32_plan)
+{
+    uint32_t plln = 0;
+
+    stm32_plan->flags &= ~(STM32_PLAN_PLLI2S | STM32_PLAN_PLLSAI);
+    stm32_plan->plli2scfgr = 0;
+    stm32_plan->pllsaicfgr = 0;
+    stm32_plan->dckcfgr = 0;
+
+    if (peripheral->i2s_frequency != 0) {
+        stm32_pll_output_t i2s = {
+            .target = (uint32_t)peripheral->i2s_frequency,
+            .div_min = RCC_PLLxCFGR_PLLR_MIN,
+            .div_max = RCC_PLLxCFGR_PLLR_MAX,
+            .post = NULL,
+            .post_count = 1,
+        };
+        if (stm32_calculate_dedicated_pll(pll_in, (uint32_t)peripheral->i2s_tolerance, limits, &i2s, 1, &plln) != 0) {
+            return -1;
+        }
+        stm32_plan->plli2scfgr = (plln << RCC_PLLxCFGR_PLLN_Pos)
+                               | (RCC_PLLxCFGR_PLLQ_MAX << RCC_PLLxCFGR_PLLQ_Pos)
+                               | (i2s.div << RCC_PLLxCFGR_PLLR_Pos);
+        stm32_plan->flags |= STM32_PLAN_PLLI2S;
+    }
+
+    if (peripheral->sai_frequency != 0 || peripheral->lcd_frequency != 0) {
+        stm32_pll_output_t outputs[2] = {
+            {   /* SAI: Q output and PLLSAIDIVQ */
+                .target = (uint32_t)peripheral->sai_frequency,
+                .div_min = RCC_PLLxCFGR_PLLQ_MIN,
+                .div_max = RCC_PLLxCFGR_PLLQ_MAX,
+                .post = NULL,
+                .post_count = RCC_DCKCFGR_PLLSAIDIVQ_MAX,
+                .div = RCC_PLLxCFGR_PLLQ_MAX,
+            },
+            {   /* LCD-TFT: R output and PLLSAIDIVR */
+                .target = (uint32_t)peripheral->lcd_frequency,
+                .div_min = RCC_PLLxCFGR_PLLR_MIN,
+                .div_max = RCC_PLLxCFGR_PLLR_MAX,
+                .post = stm32_pllsai_divr,
+                .post_count = sizeof(stm32_pllsai_divr) / sizeof(stm32_pllsai_divr[0]),
+                .div = RCC_PLLxCFGR_PLLR_MAX,
+            },
+        };
+        if (stm32_calculate_dedicated_pll(pll_in, (uint32_t)peripheral->pllsai_tolerance, limits, outputs, 2, &plln) != 0) {
+            return -1;
+        }
+        stm32_plan->pllsaicfgr = (plln << RCC_PLLxCFGR_PLLN_Pos)
+                               | (outputs[0].div << RCC_PLLxCFGR_PLLQ_Pos)
+                               | (outputs[1].div << RCC_PLLxCFGR_PLLR_Pos);
+        stm32_plan->dckcfgr = (outputs[0].post_code << RCC_DCKCFGR_PLLSAIDIVQ_Pos)
+                            | (outputs[1].post_code << RCC_DCKCFGR_PLLSAIDIVR_Pos);
+        stm32_plan->flags |= STM32_PLAN_PLLSAI;
+    }
 
+    return 0;
+}
+
+/**
+ * @brief Calculate Flash latency for a system clock frequency
+ */
+uint32_t stm32_calculate_flash_latency(uint32_t sysclk_freq, const clock_limits_t *limits)
+{
+    const stm32_flash_latency_t *table = (const stm32_flash_latency_t *)limits->flash_latency_table;
     uint32_t latency = 0;
-    for (uint32_t i = 0; i < table_size; i++) {
+
+    for (uint32_t i = 0; i < limits->flash_latency_count; i++) {
+        latency = table[i].latency;
         if (sysclk_freq <= table[i].max_freq) {
-            latency = table[i].latency;
             break;
         }
     }
 
+    return latency;
+}
+
+/**
+ * @brief Set Flash latency
+ */
+int stm32_set_flash_latency(uintptr_t flash_base, uint32_t latency)
+{
+    volatile FLASH_TypeDef *FLASH = (FLASH_TypeDef *)flash_base;
+
     /* Set Flash latency */
-    uint32_t acr = FLASH->ACR;
+    uint32_t acr = STM32_REG_READ(FLASH->ACR);
     acr &= ~FLASH_ACR_LATENCY_Msk;
     acr |= (latency << FLASH_ACR_LATENCY_Pos);
-    FLASH->ACR = acr;
+    STM32_REG_WRITE(FLASH->ACR, acr);
 
     /* Verify that the latency was set correctly */
-    if ((FLASH->ACR & FLASH_ACR_LATENCY_Msk) != (latency << FLASH_ACR_LATENCY_Pos)) {
+    if ((STM32_REG_READ(FLASH->ACR) & FLASH_ACR_LATENCY_Msk) != (latency << FLASH_ACR_LATENCY_Pos)) {
         return -1;
     }
 
@@ -168,7 +385,8 @@ int stm32_wait_clock_ready(uintptr_t rcc_base, uint32_t ready_bit, uint32_t time
     volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
     uint32_t counter = 0;
 
-    while (!(RCC->CR & ready_bit)) {
+    while (!(STM32_REG_READ(RCC->CR) & ready_bit)) {
+        STM32_POLL_HOOK();
         if (++counter > timeout) {
             return -1;
         }
@@ -186,17 +404,18 @@ int stm32_switch_sysclk(uintptr_t rcc_base, uint32_t source)
     uint32_t expected_sws;
 
     /* Set the system clock source */
-    uint32_t cfgr = RCC->CFGR;
+    uint32_t cfgr = STM32_REG_READ(RCC->CFGR);
     cfgr &= ~RCC_CFGR_SW_Msk;
     cfgr |= (source << RCC_CFGR_SW_Pos);
-    RCC->CFGR = cfgr;
+    STM32_REG_WRITE(RCC->CFGR, cfgr);
 
     /* Calculate expected SWS value */
     expected_sws = source << RCC_CFGR_SWS_Pos;
 
     /* Wait for clock switch to complete */
     uint32_t counter = 0;
-    while ((RCC->CFGR & RCC_CFGR_SWS_Msk) != expected_sws) {
+    while ((STM32_REG_READ(RCC->CFGR) & RCC_CFGR_SWS_Msk) != expected_sws) {
+        STM32_POLL_HOOK();
         if (++counter > CLOCKSWITCH_TIMEOUT) {
             return -1;
         }
@@ -206,156 +425,1250 @@ int stm32_switch_sysclk(uintptr_t rcc_base, uint32_t source)
 }
 
 /**
- * @brief Configure bus prescalers
+ * @brief Calculate the prescaler code of one APB bus
+ * 
+ * @param hclk AHB clock frequency
+ * @param max_pclk Maximum allowed APB clock frequency
+ * @param policy Bus clock policy
+ * @param prescaler Output RCC_CFGR.PPREx code
+ * 
+ * @return int 0 on success, non-zero if the limit cannot be met
+ */
+static int stm32_calculate_apb_prescaler(uint32_t hclk, uint32_t max_pclk,
+                                         dmclk_bus_policy_t policy, uint32_t *prescaler)
+{
+    if (policy == dmclk_bus_policy_powersave) {
+        *prescaler = 7; /* Division by 16 */
+        return 0;
+    }
+
+    uint32_t div = 1;
+    uint32_t code = 0; /* No division */
+
+    while ((hclk / div) > max_pclk) {
+        div *= 2;
+        code++;
+        if (code > 4) { /* Max division is /16 (code = 4) */
+            return -1;
+        }
+    }
+
+    if (code > 0) {
+        code += 3; /* 1->4 (div2), 2->5 (div4), 3->6 (div8), 4->7 (div16) */
+    }
+
+    *prescaler = code;
+    return 0;
+}
+
+/**
+ * @brief Calculate bus prescalers
  */
-int stm32_configure_bus_prescalers(uintptr_t rcc_base, 
-                                    uint32_t sysclk_freq,
-                                    const clock_limits_t *limits)
+int stm32_calculate_bus_prescalers(uint32_t sysclk_freq,
+                                   const clock_limits_t *limits,
+                                   dmclk_bus_policy_t policy,
+                                   uint32_t *cfgr_bits)
 {
-    if (limits == NULL) {
+    if (limits == NULL || cfgr_bits == NULL) {
         return -1;
     }
 
-    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
-    uint32_t cfgr = RCC->CFGR;
-
-    /* Configure AHB prescaler (HCLK) - typically 1:1 with SYSCLK */
-    cfgr &= ~RCC_CFGR_HPRE_Msk;
-    cfgr |= (0U << RCC_CFGR_HPRE_Pos); /* Division by 1 */
-
-    /* Configure APB1 prescaler (low-speed bus) */
-    uint32_t apb1_div = 1;
-    uint32_t apb1_prescaler = 0; /* No division */
-    
-    while ((sysclk_freq / apb1_div) > limits->max_pclk1) {
-        apb1_div *= 2;
-        apb1_prescaler++;
-        if (apb1_prescaler > 4) { /* Max division is /16 (prescaler = 4) */
+    uint32_t ppre1;
+    uint32_t ppre2;
+
+    /* AHB prescaler (HCLK) is 1:1 with SYSCLK, only APB buses are divided */
+    if (stm32_calculate_apb_prescaler(sysclk_freq, limits->max_pclk1, policy, &ppre1) != 0
+     || stm32_calculate_apb_prescaler(sysclk_freq, limits->max_pclk2, policy, &ppre2) != 0) {
+        return -1;
+    }
+
+    *cfgr_bits = (0U << RCC_CFGR_HPRE_Pos)
+               | (ppre1 << RCC_CFGR_PPRE1_Pos)
+               | (ppre2 << RCC_CFGR_PPRE2_Pos);
+    return 0;
+}
+
+/**
+ * @brief Plan a SYSCLK configuration driven by the main PLL
+ */
+int stm32_plan_pll(dmclk_frequency_t target_freq,
+                   dmclk_frequency_t tolerance,
+                   uint32_t hse_freq,
+                   const clock_limits_t *limits,
+                   dmclk_bus_policy_t policy,
+                   const dmclk_peripheral_clocks_t *peripheral,
+                   dmclk_port_plan_t *plan)
+{
+    if (limits == NULL || plan == NULL) {
+        return -1;
+    }
+
+    stm32_plan_t *stm32_plan = STM32_PLAN(plan);
+    uint32_t source_freq = (hse_freq != 0) ? hse_freq : HSI_VALUE;
+    pll_config_t pll_config;
+    uint32_t actual_freq = 0;
+    uint32_t bus_bits = 0;
+
+    stm32_plan->flags = 0;
+    stm32_plan->plli2scfgr = 0;
+    stm32_plan->pllsaicfgr = 0;
+    stm32_plan->dckcfgr = 0;
+    if (!stm32_peripheral_clocks_used(peripheral)) {
+        if (stm32_calculate_pll_config(target_freq, tolerance, source_freq,
+                                       limits, &pll_config, &actual_freq) != 0) {
+            return -1;
+        }
+    } else {
+        /* PLLM is shared - only division factors reaching every dedicated PLL output qualify */
+        uint32_t target_freq_32 = (uint32_t)target_freq;
+        uint32_t best_error = 0xFFFFFFFFU;
+        stm32_plan_t dedicated;
+
+        for (uint32_t pllm = limits->pllm_min; pllm <= limits->pllm_max && best_error != 0; pllm++) {
+            uint32_t pll_in = source_freq / pllm;
+            if (pll_in < limits->pll_in_min || pll_in > limits->pll_in_max) {
+                continue;
+            }
+            if (stm32_plan_dedicated_plls(pll_in, peripheral, limits, &dedicated) != 0) {
+                continue;
+            }
+
+            clock_limits_t fixed_m = *limits;
+            pll_config_t candidate;
+            uint32_t candidate_freq;
+            fixed_m.pllm_min = pllm;
+            fixed_m.pllm_max = pllm;
+            if (stm32_calculate_pll_config(target_freq, tolerance, source_freq,
+                                           &fixed_m, &candidate, &candidate_freq) != 0) {
+                continue;
+            }
+
+            uint32_t error = (candidate_freq > target_freq_32) ? (candidate_freq - target_freq_32)
+                                                               : (target_freq_32 - candidate_freq);
+            if (error < best_error) {
+                best_error = error;
+                pll_config = candidate;
+                actual_freq = candidate_freq;
+                stm32_plan->plli2scfgr = dedicated.plli2scfgr;
+                stm32_plan->pllsaicfgr = dedicated.pllsaicfgr;
+                stm32_plan->dckcfgr = dedicated.dckcfgr;
+                stm32_plan->flags = dedicated.flags & (STM32_PLAN_PLLI2S | STM32_PLAN_PLLSAI);
+            }
+        }
+        if (best_error == 0xFFFFFFFFU) {
             return -1;
         }
     }
-    
-    if (apb1_prescaler > 0) {
-        apb1_prescaler += 3; /* 0->4 (div2), 1->5 (div4), 2->6 (div8), 3->7 (div16) */
+    if (stm32_calculate_bus_prescalers(actual_freq, limits, policy, &bus_bits) != 0) {
+        return -1;
+    }
+
+    uint32_t pllcfgr = 0;
+    pllcfgr |= (pll_config.pllm << RCC_PLLCFGR_PLLM_Pos) & RCC_PLLCFGR_PLLM_Msk;
+    pllcfgr |= (pll_config.plln << RCC_PLLCFGR_PLLN_Pos) & RCC_PLLCFGR_PLLN_Msk;
+    pllcfgr |= (((pll_config.pllp / 2) - 1) << RCC_PLLCFGR_PLLP_Pos) & RCC_PLLCFGR_PLLP_Msk;
+    pllcfgr |= (pll_config.pllq << RCC_PLLCFGR_PLLQ_Pos) & RCC_PLLCFGR_PLLQ_Msk;
+    if (hse_freq != 0) {
+        pllcfgr |= RCC_PLLCFGR_PLLSRC; /* PLL source is HSE (bit 22 = 1) */
+    }
+
+    stm32_plan->sysclk = actual_freq;
+    stm32_plan->hclk = actual_freq;
+    stm32_plan->hse_freq = hse_freq;
+    stm32_plan->pllcfgr = pllcfgr;
+    stm32_plan->cfgr = bus_bits | (RCC_CFGR_SW_PLL << RCC_CFGR_SW_Pos);
+    stm32_plan->flash_latency = stm32_calculate_flash_latency(actual_freq, limits);
+    stm32_plan->vos = limits->vos_performance;
+    stm32_plan->vos_msk = limits->vos_msk;
+    stm32_plan->flags |= STM32_PLAN_PLL;
+    stm32_plan->tolerance = (uint32_t)tolerance;
+    stm32_plan->bus_policy = (uint32_t)policy;
+    if (hse_freq != 0) {
+        stm32_plan->flags |= STM32_PLAN_HSE;
+    }
+    if (limits->max_sysclk_no_overdrive != 0 && actual_freq > limits->max_sysclk_no_overdrive) {
+        stm32_plan->flags |= STM32_PLAN_OVERDRIVE;
+    }
+
+    plan->frequency = actual_freq;
+    return 0;
+}
+
+/**
+ * @brief Plan a SYSCLK configuration running directly from HSI or HSE
+ */
+int stm32_plan_direct(dmclk_frequency_t target_freq,
+                      dmclk_frequency_t tolerance,
+                      uint32_t hse_freq,
+                      const clock_limits_t *limits,
+                      dmclk_bus_policy_t policy,
+                      const dmclk_peripheral_clocks_t *peripheral,
+                      dmclk_port_plan_t *plan)
+{
+    if (limits == NULL || plan == NULL) {
+        return -1;
+    }
+
+    stm32_plan_t *stm32_plan = STM32_PLAN(plan);
+    uint32_t source_freq = (hse_freq != 0) ? hse_freq : HSI_VALUE;
+    uint32_t best_hpre = 0;
+    uint64_t best_error = UINT64_MAX;
+
+    for (uint32_t hpre = 0; hpre < 16; hpre++) {
+        /* Codes 1..7 repeat the undivided clock */
+        if (hpre > 0 && hpre < 8) {
+            continue;
+        }
+        uint64_t hclk = source_freq / stm32_ahb_divisors[hpre];
+        uint64_t error = (hclk > target_freq) ? (hclk - target_freq) : (target_freq - hclk);
+        if (error <= tolerance && error < best_error) {
+            best_error = error;
+            best_hpre = hpre;
+        }
+    }
+    if (best_error == UINT64_MAX) {
+        return -1;
+    }
+
+    uint32_t hclk = source_freq / stm32_ahb_divisors[best_hpre];
+    uint32_t bus_bits = 0;
+    if (stm32_calculate_bus_prescalers(hclk, limits, policy, &bus_bits) != 0) {
+        return -1;
     }
-    
-    cfgr &= ~RCC_CFGR_PPRE1_Msk;
-    cfgr |= (apb1_prescaler << RCC_CFGR_PPRE1_Pos);
 
-    /* Configure APB2 prescaler (high-speed bus) */
-    uint32_t apb2_div = 1;
-    uint32_t apb2_prescaler = 0; /* No division */
-    
-    while ((sysclk_freq / apb2_div) > limits->max_pclk2) {
-        apb2_div *= 2;
-        apb2_prescaler++;
-        if (apb2_prescaler > 4) { /* Max division is /16 (prescaler = 4) */
+    stm32_plan->sysclk = source_freq;
+    stm32_plan->hclk = hclk;
+    stm32_plan->hse_freq = hse_freq;
+    stm32_plan->pllcfgr = 0;
+    stm32_plan->cfgr = (bus_bits & ~RCC_CFGR_HPRE_Msk)
+                     | (best_hpre << RCC_CFGR_HPRE_Pos)
+                     | (((hse_freq != 0) ? RCC_CFGR_SW_HSE : RCC_CFGR_SW_HSI) << RCC_CFGR_SW_Pos);
+    stm32_plan->flash_latency = stm32_calculate_flash_latency(hclk, limits);
+    stm32_plan->vos = 0;
+    stm32_plan->vos_msk = 0;    /* Direct clocks run in any voltage scale */
+    stm32_plan->flags = 0;
+    stm32_plan->plli2scfgr = 0;
+    stm32_plan->pllsaicfgr = 0;
+    stm32_plan->dckcfgr = 0;
+    stm32_plan->tolerance = (uint32_t)tolerance;
+    stm32_plan->bus_policy = (uint32_t)policy;
+
+    if (stm32_peripheral_clocks_used(peripheral)) {
+        /* The main PLL stays off, but its PLLM and source still feed PLLI2S and PLLSAI */
+        uint32_t pllm;
+        for (pllm = limits->pllm_min; pllm <= limits->pllm_max; pllm++) {
+            uint32_t pll_in = source_freq / pllm;
+            if (pll_in >= limits->pll_in_min && pll_in <= limits->pll_in_max
+             && stm32_plan_dedicated_plls(pll_in, peripheral, limits, stm32_plan) == 0) {
+                break;
+            }
+        }
+        if (pllm > limits->pllm_max) {
             return -1;
         }
+        stm32_plan->pllcfgr = (pllm << RCC_PLLCFGR_PLLM_Pos) | ((hse_freq != 0) ? RCC_PLLCFGR_PLLSRC : 0U);
     }
-    
-    if (apb2_prescaler > 0) {
-        apb2_prescaler += 3; /* 0->4 (div2), 1->5 (div4), 2->6 (div8), 3->7 (div16) */
+    if (hse_freq != 0) {
+        stm32_plan->flags |= STM32_PLAN_HSE;
+    }
+
+    plan->frequency = hclk;
+    return 0;
+}
+
+/**
+ * @brief Plan the cheapest configuration reaching the target
+ */
+int stm32_plan_clock(dmclk_frequency_t target_freq,
+                     dmclk_frequency_t tolerance,
+                     uint32_t hse_freq,
+                     const clock_limits_t *limits,
+                     dmclk_bus_policy_t policy,
+                     const dmclk_peripheral_clocks_t *peripheral,
+                     dmclk_port_plan_t *plan)
+{
+    /* A divided oscillator switches instantly and draws no PLL current */
+    if (stm32_plan_direct(target_freq, tolerance, hse_freq, limits, policy, peripheral, plan) == 0) {
+        return 0;
     }
-    
-    cfgr &= ~RCC_CFGR_PPRE2_Msk;
-    cfgr |= (apb2_prescaler << RCC_CFGR_PPRE2_Pos);
+    return stm32_plan_pll(target_freq, tolerance, hse_freq, limits, policy, peripheral, plan);
+}
 
-    RCC->CFGR = cfgr;
+/**
+ * @brief Plan a low-power configuration running directly from HSI or HSE
+ */
+int stm32_plan_low_power(dmclk_frequency_t target_freq,
+                         dmclk_frequency_t tolerance,
+                         uint32_t hse_freq,
+                         const clock_limits_t *limits,
+                         dmclk_port_plan_t *plan)
+{
+    /* HSI first - running from it allows HSE to be switched off */
+    /* Dedicated PLLs are stopped in hibernation, so no peripheral clocks are passed */
+    if (stm32_plan_direct(target_freq, tolerance, 0, limits, dmclk_bus_policy_powersave, NULL, plan) != 0
+     && (hse_freq == 0
+      || stm32_plan_direct(target_freq, tolerance, hse_freq, limits, dmclk_bus_policy_powersave, NULL, plan) != 0)) {
+        return -1;
+    }
 
+    stm32_plan_t *stm32_plan = STM32_PLAN(plan);
+    stm32_plan->vos = limits->vos_low_power;
+    stm32_plan->vos_msk = limits->vos_msk;
+    stm32_plan->flags |= STM32_PLAN_LOW_POWER;
     return 0;
 }
 
 /**
- * @brief Enable PWR Over-Drive mode
+ * @brief Write the bus prescalers of a plan
  */
-int stm32_enable_overdrive(uintptr_t rcc_base, uintptr_t pwr_base, uint32_t timeout)
+static void stm32_write_prescalers(volatile RCC_TypeDef *RCC, const stm32_plan_t *stm32_plan)
+{
+    const uint32_t msk = RCC_CFGR_HPRE_Msk | RCC_CFGR_PPRE1_Msk | RCC_CFGR_PPRE2_Msk;
+    STM32_REG_MODIFY(RCC->CFGR, msk, stm32_plan->cfgr & msk);
+}
+
+/**
+ * @brief Set the regulator voltage scale requested by a plan
+ */
+static void stm32_write_vos(uintptr_t rcc_base, uintptr_t pwr_base, const stm32_plan_t *stm32_plan)
 {
+    if (pwr_base == 0 || stm32_plan->vos_msk == 0) {
+        return;
+    }
+
     volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
     volatile PWR_TypeDef *PWR = (PWR_TypeDef *)pwr_base;
-    uint32_t counter;
 
-    RCC->APB1ENR |= RCC_APB1ENR_PWREN;
+    STM32_REG_SET(RCC->APB1ENR, RCC_APB1ENR_PWREN);
+    STM32_REG_MODIFY(PWR->CR1, stm32_plan->vos_msk, stm32_plan->vos);
+}
 
-    PWR->CR1 |= PWR_CR1_ODEN;
-    counter = 0;
-    while (!(PWR->CSR1 & PWR_CSR1_ODRDY)) {
-        if (++counter > timeout) {
-            return -1;
+/**
+ * @brief Stop PLLI2S and / or PLLSAI
+ */
+static void stm32_stop_dedicated_plls(volatile RCC_TypeDef *RCC, uint32_t on_bits, uint32_t ready_bits)
+{
+    if (STM32_REG_READ(RCC->CR) & on_bits) {
+        STM32_REG_CLEAR(RCC->CR, on_bits);
+        while (STM32_REG_READ(RCC->CR) & ready_bits) {
+            /* Wait for the PLLs to stop */
+            STM32_POLL_HOOK();
         }
     }
+}
+
+/**
+ * @brief Check whether a plan changes the PLLM / source pair feeding the dedicated PLLs
+ */
+static int stm32_dedicated_input_changes(volatile RCC_TypeDef *RCC, const stm32_plan_t *stm32_plan)
+{
+    const uint32_t msk = RCC_PLLCFGR_PLLM_Msk | RCC_PLLCFGR_PLLSRC;
+    return (STM32_REG_READ(RCC->PLLCFGR) & msk) != (stm32_plan->pllcfgr & msk);
+}
+
+/**
+ * @brief Check whether the main PLL has to be relocked for a plan
+ */
+static int stm32_main_pll_changes(volatile RCC_TypeDef *RCC, uintptr_t pwr_base, const stm32_plan_t *stm32_plan)
+{
+    const uint32_t msk = RCC_PLLCFGR_PLLM_Msk | RCC_PLLCFGR_PLLN_Msk | RCC_PLLCFGR_PLLP_Msk
+                       | RCC_PLLCFGR_PLLSRC | RCC_PLLCFGR_PLLQ_Msk;
+
+    if (!(STM32_REG_READ(RCC->CR) & RCC_CR_PLLRDY)
+     || (STM32_REG_READ(RCC->PLLCFGR) & msk) != (stm32_plan->pllcfgr & msk)) {
+        return 1;
+    }
 
+    /* The voltage scale can only change while the PLL is off */
+    if (pwr_base != 0 && stm32_plan->vos_msk != 0) {
+        volatile PWR_TypeDef *PWR = (PWR_TypeDef *)pwr_base;
+        return (STM32_REG_READ(PWR->CR1) & stm32_plan->vos_msk) != stm32_plan->vos;
+    }
     return 0;
 }
 
 /**
- * @brief Get current system clock frequency
+ * @brief Start a dedicated PLL unless it already runs with the requested configuration
  */
-uint32_t stm32_get_sysclk_freq(uintptr_t rcc_base, uint32_t hsi_value)
+static int stm32_start_dedicated_pll(uintptr_t rcc_base,
+                                     volatile uint32_t *pllcfgr,
+                                     uint32_t image,
+                                     uint32_t on_bit,
+                                     uint32_t ready_bit)
 {
     volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
-    uint32_t sysclk = 0;
-    uint32_t sws = (RCC->CFGR & RCC_CFGR_SWS_Msk) >> RCC_CFGR_SWS_Pos;
+    const uint32_t msk = RCC_PLLxCFGR_PLLN_Msk | RCC_PLLxCFGR_PLLQ_Msk | RCC_PLLxCFGR_PLLR_Msk;
 
-    switch (sws) {
-        case 0: /* HSI */
-            sysclk = hsi_value;
-            break;
-            
-        case 1: /* HSE */
-            /* Note: HSE value must be stored by port implementation in current_hse_freq */
-            sysclk = 0;
-            break;
-            
-        case 2: /* PLL */
-        {
-            uint32_t pllcfgr = RCC->PLLCFGR;
-            uint32_t pllm = (pllcfgr & RCC_PLLCFGR_PLLM_Msk) >> RCC_PLLCFGR_PLLM_Pos;
-            uint32_t plln = (pllcfgr & RCC_PLLCFGR_PLLN_Msk) >> RCC_PLLCFGR_PLLN_Pos;
-            uint32_t pllp_bits = (pllcfgr & RCC_PLLCFGR_PLLP_Msk) >> RCC_PLLCFGR_PLLP_Pos;
-            uint32_t pllp = (pllp_bits + 1) * 2; /* 0=2, 1=4, 2=6, 3=8 */
-            uint32_t pllsrc = (pllcfgr & RCC_PLLCFGR_PLLSRC) ? 1 : 0;
-            
-            uint32_t pll_input;
-            if (pllsrc == 0) {
-                pll_input = hsi_value;
-            } else {
-                /* HSE - Note: HSE value must be stored by port implementation in current_hse_freq */
-                pll_input = 0;
-            }
-            
-            if (pll_input > 0 && pllm > 0) {
-                uint32_t vco = (pll_input / pllm) * plln;
-                sysclk = vco / pllp;
-            }
-            break;
+    /* Restarting would glitch the audio / pixel clock for nothing */
+    if ((STM32_REG_READ(RCC->CR) & ready_bit) && (STM32_REG_READ(*pllcfgr) & msk) == image) {
+        return 0;
+    }
+
+    stm32_stop_dedicated_plls(RCC, on_bit, ready_bit);
+    STM32_REG_MODIFY(*pllcfgr, msk, image);
+    STM32_REG_SET(RCC->CR, on_bit);
+    return stm32_wait_clock_ready(rcc_base, ready_bit, PLL_STARTUP_TIMEOUT);
+}
+
+/**
+ * @brief Bring PLLI2S and PLLSAI to the state requested by a plan
+ *
+ * Must be called once PLLCFGR holds the PLLM and source of the plan.
+ */
+static int stm32_apply_dedicated_plls(uintptr_t rcc_base, const stm32_plan_t *stm32_plan)
+{
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+
+    if (stm32_plan->flags & STM32_PLAN_PLLI2S) {
+        if (stm32_start_dedicated_pll(rcc_base, &RCC->PLLI2SCFGR, stm32_plan->plli2scfgr,
+                                      RCC_CR_PLLI2SON, RCC_CR_PLLI2SRDY) != 0) {
+            return -1;
         }
-            
-        default:
-            sysclk = 0;
-            break;
+    } else {
+        stm32_stop_dedicated_plls(RCC, RCC_CR_PLLI2SON, RCC_CR_PLLI2SRDY);
+    }
+
+    if (stm32_plan->flags & STM32_PLAN_PLLSAI) {
+        const uint32_t msk = RCC_DCKCFGR_PLLSAIDIVQ_Msk | RCC_DCKCFGR_PLLSAIDIVR_Msk;
+        STM32_REG_MODIFY(RCC->DCKCFGR, msk, stm32_plan->dckcfgr);
+        if (stm32_start_dedicated_pll(rcc_base, &RCC->PLLSAICFGR, stm32_plan->pllsaicfgr,
+                                      RCC_CR_PLLSAION, RCC_CR_PLLSAIRDY) != 0) {
+            return -1;
+        }
+    } else {
+        stm32_stop_dedicated_plls(RCC, RCC_CR_PLLSAION, RCC_CR_PLLSAIRDY);
     }
 
-    return sysclk;
+    return 0;
 }
 
-int stm32_delay_cycles_dwt(uint64_t target_cycles, uint64_t *elapsed_cycles)
+/**
+ * @brief Apply a precomputed clock plan
+ */
+int stm32_apply_plan(uintptr_t rcc_base,
+                     uintptr_t flash_base,
+                     uintptr_t pwr_base,
+                     uint32_t current_hclk,
+                     const dmclk_port_plan_t *plan)
 {
-    if (elapsed_cycles == NULL) {
+    if (plan == NULL) {
         return -1;
     }
 
-    *elapsed_cycles = 0U;
-    if (target_cycles == 0U) {
-        return 0;
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+    volatile FLASH_TypeDef *FLASH = (FLASH_TypeDef *)flash_base;
+    const stm32_plan_t *stm32_plan = STM32_PLAN_CONST(plan);
+    uint32_t current_latency = (STM32_REG_READ(FLASH->ACR) & FLASH_ACR_LATENCY_Msk) >> FLASH_ACR_LATENCY_Pos;
+    int speed_up = (stm32_plan->hclk > current_hclk);
+
+    /* Start the oscillator feeding the plan */
+    if (stm32_plan->flags & STM32_PLAN_HSE) {
+        STM32_REG_SET(RCC->CR, RCC_CR_HSEON);
+        if (stm32_wait_clock_ready(rcc_base, RCC_CR_HSERDY, HSE_STARTUP_TIMEOUT) != 0) {
+            return -1;
+        }
+        /* On HSE failure the hardware falls back to HSI and raises the NMI */
+        STM32_REG_SET(RCC->CR, RCC_CR_CSSON);
+    } else {
+        STM32_REG_SET(RCC->CR, RCC_CR_HSION);
+        if (stm32_wait_clock_ready(rcc_base, RCC_CR_HSIRDY, HSI_STARTUP_TIMEOUT) != 0) {
+            return -1;
+        }
+    }
+
+    /* Flash wait states must be raised before the frequency goes up */
+    if (stm32_plan->flash_latency > current_latency) {
+        if (stm32_set_flash_latency(flash_base, stm32_plan->flash_latency) != 0) {
+            return -1;
+        }
     }
 
-    /* Enable tracing + DWT cycle counter */
-    ARM_DEMCR |= ARM_DEMCR_TRCENA_Msk;
-    ARM_DWT_LAR = ARM_DWT_LAR_UNLOCK_KEY;
-    ARM_DWT_CYCCNT = 0U;
-    ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA_Msk;
+    /* A PLL already locked to the plan keeps running, only the dividers change */
+    if ((stm32_plan->flags & STM32_PLAN_PLL) && stm32_main_pll_changes(RCC, pwr_base, stm32_plan)) {
+        /* PLLON cannot be cleared while the PLL drives SYSCLK - run from HSI meanwhile */
+        if (((STM32_REG_READ(RCC->CFGR) & RCC_CFGR_SWS_Msk) >> RCC_CFGR_SWS_Pos) == RCC_CFGR_SW_PLL) {
+            STM32_REG_SET(RCC->CR, RCC_CR_HSION);
+            if (stm32_wait_clock_ready(rcc_base, RCC_CR_HSIRDY, HSI_STARTUP_TIMEOUT) != 0
+             || stm32_switch_sysclk(rcc_base, RCC_CFGR_SW_HSI) != 0) {
+                return -1;
+            }
+        }
+
+        /* Disable PLL before configuration */
+        STM32_REG_CLEAR(RCC->CR, RCC_CR_PLLON);
+        while (STM32_REG_READ(RCC->CR) & RCC_CR_PLLRDY) {
+            /* Wait for PLL to unlock */
+            STM32_POLL_HOOK();
+        }
+
+        /* Voltage scale can only be changed while the PLL is off */
+        stm32_write_vos(rcc_base, pwr_base, stm32_plan);
+
+        /* PLLM and the source can only change while the dedicated PLLs are off too */
+        if (stm32_dedicated_input_changes(RCC, stm32_plan)) {
+            stm32_stop_dedicated_plls(RCC, RCC_CR_PLLI2SON | RCC_CR_PLLSAION, RCC_CR_PLLI2SRDY | RCC_CR_PLLSAIRDY);
+        }
+        STM32_REG_WRITE(RCC->PLLCFGR, stm32_plan->pllcfgr);
+
+        /* Enable PLL */
+        STM32_REG_SET(RCC->CR, RCC_CR_PLLON);
+        if (stm32_wait_clock_ready(rcc_base, RCC_CR_PLLRDY, PLL_STARTUP_TIMEOUT) != 0) {
+            return -1;
+        }
+    }
+
+    /* Over-Drive must be enabled before the core actually starts running at
+     * the higher HCLK, i.e. before switching SYSCLK below. */
+    if (stm32_plan->flags & STM32_PLAN_OVERDRIVE) {
+        if (stm32_enable_overdrive(rcc_base, pwr_base, OVERDRIVE_STARTUP_TIMEOUT) != 0) {
+            return -1;
+        }
+    }
+
+    /* Bus limits must hold before and after the switch: dividers are
+     * changed first when speeding up and last when slowing down */
+    if (speed_up) {
+        stm32_write_prescalers(RCC, stm32_plan);
+    }
+
+    /* Switch system clock */
+    if (stm32_switch_sysclk(rcc_base, (stm32_plan->cfgr & RCC_CFGR_SW_Msk) >> RCC_CFGR_SW_Pos) != 0) {
+        return -1;
+    }
+
+    if (!speed_up) {
+        stm32_write_prescalers(RCC, stm32_plan);
+    }
+
+    if (!(stm32_plan->flags & STM32_PLAN_PLL)) {
+        /* Nothing runs from the PLL anymore - stop it and the unused oscillator */
+        STM32_REG_CLEAR(RCC->CR, RCC_CR_PLLON);
+        while (STM32_REG_READ(RCC->CR) & RCC_CR_PLLRDY) {
+            /* Wait for PLL to stop */
+            STM32_POLL_HOOK();
+        }
+        if (!(stm32_plan->flags & STM32_PLAN_HSE)) {
+            STM32_REG_CLEAR(RCC->CR, RCC_CR_HSEON);
+        }
+        stm32_disable_overdrive(rcc_base, pwr_base);
+        stm32_write_vos(rcc_base, pwr_base, stm32_plan);
+
+        /* The dedicated PLLs still need PLLM and the source of the plan */
+        if ((stm32_plan->flags & (STM32_PLAN_PLLI2S | STM32_PLAN_PLLSAI))
+         && stm32_dedicated_input_changes(RCC, stm32_plan)) {
+            const uint32_t msk = RCC_PLLCFGR_PLLM_Msk | RCC_PLLCFGR_PLLSRC;
+            stm32_stop_dedicated_plls(RCC, RCC_CR_PLLI2SON | RCC_CR_PLLSAION, RCC_CR_PLLI2SRDY | RCC_CR_PLLSAIRDY);
+            STM32_REG_MODIFY(RCC->PLLCFGR, msk, stm32_plan->pllcfgr & msk);
+        }
+    }
+
+    if (stm32_apply_dedicated_plls(rcc_base, stm32_plan) != 0) {
+        return -1;
+    }
+
+    /* Flash wait states can only be lowered once the frequency went down */
+    if (stm32_plan->flash_latency < current_latency) {
+        if (stm32_set_flash_latency(flash_base, stm32_plan->flash_latency) != 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Enable a ready interrupt and check whether the clock is already ready
+ */
+static int stm32_clock_ready_or_arm(volatile RCC_TypeDef *RCC, uint32_t ready_bit, uint32_t interrupt)
+{
+    /* Ready flags are only raised with the interrupt enabled - arm it before looking */
+    STM32_REG_SET(RCC->CIR, interrupt);
+    if (STM32_REG_READ(RCC->CR) & ready_bit) {
+        STM32_REG_CLEAR(RCC->CIR, interrupt);
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Start the oscillator and main PLL of a plan without waiting for them
+ */
+int stm32_prepare_plan(uintptr_t rcc_base,
+                       uintptr_t pwr_base,
+                       const dmclk_port_plan_t *plan)
+{
+    if (plan == NULL) {
+        return -1;
+    }
+
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+    const stm32_plan_t *stm32_plan = STM32_PLAN_CONST(plan);
+    const uint32_t msk = RCC_PLLCFGR_PLLM_Msk | RCC_PLLCFGR_PLLN_Msk | RCC_PLLCFGR_PLLP_Msk
+                       | RCC_PLLCFGR_PLLSRC | RCC_PLLCFGR_PLLQ_Msk;
+
+    STM32_REG_SET(RCC->CIR, RCC_CIR_HSERDYC | RCC_CIR_PLLRDYC);
+
+    /* The PLL input must be stable before the PLL is started */
+    if (stm32_plan->flags & STM32_PLAN_HSE) {
+        STM32_REG_SET(RCC->CR, RCC_CR_HSEON);
+        if (!stm32_clock_ready_or_arm(RCC, RCC_CR_HSERDY, RCC_CIR_HSERDYIE)) {
+            return 1;
+        }
+    } else {
+        STM32_REG_SET(RCC->CR, RCC_CR_HSION);
+        if (stm32_wait_clock_ready(rcc_base, RCC_CR_HSIRDY, HSI_STARTUP_TIMEOUT) != 0) {
+            return -1;
+        }
+    }
+
+    if (!(stm32_plan->flags & STM32_PLAN_PLL) || !stm32_main_pll_changes(RCC, pwr_base, stm32_plan)) {
+        return 0;
+    }
+
+    /* Called again from the PLL ready interrupt - the PLL is still locking to this plan */
+    if ((STM32_REG_READ(RCC->CR) & RCC_CR_PLLON) && !(STM32_REG_READ(RCC->CR) & RCC_CR_PLLRDY)
+     && (STM32_REG_READ(RCC->PLLCFGR) & msk) == (stm32_plan->pllcfgr & msk)) {
+        return stm32_clock_ready_or_arm(RCC, RCC_CR_PLLRDY, RCC_CIR_PLLRDYIE) ? 0 : 1;
+    }
+
+    /* Same sequence as stm32_apply_plan(), SYSCLK runs from HSI while the PLL locks */
+    if (((STM32_REG_READ(RCC->CFGR) & RCC_CFGR_SWS_Msk) >> RCC_CFGR_SWS_Pos) == RCC_CFGR_SW_PLL) {
+        STM32_REG_SET(RCC->CR, RCC_CR_HSION);
+        if (stm32_wait_clock_ready(rcc_base, RCC_CR_HSIRDY, HSI_STARTUP_TIMEOUT) != 0
+         || stm32_switch_sysclk(rcc_base, RCC_CFGR_SW_HSI) != 0) {
+            return -1;
+        }
+    }
+
+    STM32_REG_CLEAR(RCC->CR, RCC_CR_PLLON);
+    while (STM32_REG_READ(RCC->CR) & RCC_CR_PLLRDY) {
+        /* Wait for PLL to unlock */
+        STM32_POLL_HOOK();
+    }
+
+    stm32_write_vos(rcc_base, pwr_base, stm32_plan);
+    if (stm32_dedicated_input_changes(RCC, stm32_plan)) {
+        stm32_stop_dedicated_plls(RCC, RCC_CR_PLLI2SON | RCC_CR_PLLSAION, RCC_CR_PLLI2SRDY | RCC_CR_PLLSAIRDY);
+    }
+    STM32_REG_WRITE(RCC->PLLCFGR, stm32_plan->pllcfgr);
+
+    STM32_REG_SET(RCC->CR, RCC_CR_PLLON);
+    return stm32_clock_ready_or_arm(RCC, RCC_CR_PLLRDY, RCC_CIR_PLLRDYIE) ? 0 : 1;
+}
+
+/**
+ * @brief Stop waiting for the ready interrupts armed by stm32_prepare_plan()
+ */
+void stm32_cancel_prepare(uintptr_t rcc_base)
+{
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+
+    STM32_REG_CLEAR(RCC->CIR, RCC_CIR_HSERDYIE | RCC_CIR_PLLRDYIE);
+    STM32_REG_SET(RCC->CIR, RCC_CIR_HSERDYC | RCC_CIR_PLLRDYC);
+}
+
+/**
+ * @brief Check whether the hardware already runs a plan
+ */
+int stm32_plan_is_active(uintptr_t rcc_base,
+                         uintptr_t flash_base,
+                         uintptr_t pwr_base,
+                         const dmclk_port_plan_t *plan)
+{
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+    volatile FLASH_TypeDef *FLASH = (FLASH_TypeDef *)flash_base;
+    const stm32_plan_t *stm32_plan = STM32_PLAN_CONST(plan);
+    const uint32_t cfgr_msk = RCC_CFGR_HPRE_Msk | RCC_CFGR_PPRE1_Msk | RCC_CFGR_PPRE2_Msk;
+    const uint32_t pllcfgr_msk = RCC_PLLCFGR_PLLM_Msk | RCC_PLLCFGR_PLLN_Msk | RCC_PLLCFGR_PLLP_Msk
+                               | RCC_PLLCFGR_PLLSRC | RCC_PLLCFGR_PLLQ_Msk;
+    const uint32_t pllx_msk = RCC_PLLxCFGR_PLLN_Msk | RCC_PLLxCFGR_PLLQ_Msk | RCC_PLLxCFGR_PLLR_Msk;
+    uint32_t cr = STM32_REG_READ(RCC->CR);
+    uint32_t cfgr = STM32_REG_READ(RCC->CFGR);
+    uint32_t sws = (stm32_plan->cfgr & RCC_CFGR_SW_Msk) << (RCC_CFGR_SWS_Pos - RCC_CFGR_SW_Pos);
+
+    if ((cfgr & RCC_CFGR_SWS_Msk) != sws
+     || (cfgr & cfgr_msk) != (stm32_plan->cfgr & cfgr_msk)
+     || ((STM32_REG_READ(FLASH->ACR) & FLASH_ACR_LATENCY_Msk) >> FLASH_ACR_LATENCY_Pos) != stm32_plan->flash_latency) {
+        return 0;
+    }
+    if ((stm32_plan->flags & STM32_PLAN_HSE) && !(cr & RCC_CR_HSERDY)) {
+        return 0;
+    }
+
+    /* A running PLL the plan does not use would be stopped by stm32_apply_plan() */
+    if (stm32_plan->flags & STM32_PLAN_PLL) {
+        if (!(cr & RCC_CR_PLLRDY) || (STM32_REG_READ(RCC->PLLCFGR) & pllcfgr_msk) != (stm32_plan->pllcfgr & pllcfgr_msk)) {
+            return 0;
+        }
+    } else if (cr & RCC_CR_PLLON) {
+        return 0;
+    }
+
+    if (stm32_plan->flags & STM32_PLAN_PLLI2S) {
+        if (!(cr & RCC_CR_PLLI2SRDY) || (STM32_REG_READ(RCC->PLLI2SCFGR) & pllx_msk) != stm32_plan->plli2scfgr) {
+            return 0;
+        }
+    } else if (cr & RCC_CR_PLLI2SON) {
+        return 0;
+    }
+
+    if (stm32_plan->flags & STM32_PLAN_PLLSAI) {
+        const uint32_t dckcfgr_msk = RCC_DCKCFGR_PLLSAIDIVQ_Msk | RCC_DCKCFGR_PLLSAIDIVR_Msk;
+        if (!(cr & RCC_CR_PLLSAIRDY)
+         || (STM32_REG_READ(RCC->PLLSAICFGR) & pllx_msk) != stm32_plan->pllsaicfgr
+         || (STM32_REG_READ(RCC->DCKCFGR) & dckcfgr_msk) != stm32_plan->dckcfgr) {
+            return 0;
+        }
+    } else if (cr & RCC_CR_PLLSAION) {
+        return 0;
+    }
+
+    /* PWR reads as zero while its clock is off, which only costs a needless re-apply */
+    if (pwr_base != 0) {
+        volatile PWR_TypeDef *PWR = (PWR_TypeDef *)pwr_base;
+        if (stm32_plan->vos_msk != 0 && (STM32_REG_READ(PWR->CR1) & stm32_plan->vos_msk) != stm32_plan->vos) {
+            return 0;
+        }
+        if ((stm32_plan->flags & STM32_PLAN_OVERDRIVE) && !(STM32_REG_READ(PWR->CSR1) & PWR_CSR1_ODSWRDY)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/**
+ * @brief Decode the running clock configuration into a plan
+ */
+int stm32_read_plan(uintptr_t rcc_base,
+                    uintptr_t flash_base,
+                    uintptr_t pwr_base,
+                    const clock_limits_t *limits,
+                    const dmclk_port_plan_t *request,
+                    dmclk_port_plan_t *plan)
+{
+    if (limits == NULL || request == NULL || plan == NULL) {
+        return -1;
+    }
+
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+    volatile FLASH_TypeDef *FLASH = (FLASH_TypeDef *)flash_base;
+    const stm32_plan_t *wanted = STM32_PLAN_CONST(request);
+    stm32_plan_t *stm32_plan = STM32_PLAN(plan);
+    const uint32_t pllcfgr_msk = RCC_PLLCFGR_PLLM_Msk | RCC_PLLCFGR_PLLN_Msk | RCC_PLLCFGR_PLLP_Msk
+                               | RCC_PLLCFGR_PLLSRC | RCC_PLLCFGR_PLLQ_Msk;
+    const uint32_t input_msk = RCC_PLLCFGR_PLLM_Msk | RCC_PLLCFGR_PLLSRC;
+    const uint32_t pllx_msk = RCC_PLLxCFGR_PLLN_Msk | RCC_PLLxCFGR_PLLQ_Msk | RCC_PLLxCFGR_PLLR_Msk;
+    const uint32_t ppre_msk = RCC_CFGR_PPRE1_Msk | RCC_CFGR_PPRE2_Msk;
+    const uint32_t match_flags = STM32_PLAN_HSE | STM32_PLAN_PLLI2S | STM32_PLAN_PLLSAI;
+    uint32_t cr = STM32_REG_READ(RCC->CR);
+    uint32_t cfgr = STM32_REG_READ(RCC->CFGR);
+    uint32_t sw = (cfgr & RCC_CFGR_SWS_Msk) >> RCC_CFGR_SWS_Pos;
+    uint32_t bus_bits = 0;
+    dmclk_clock_tree_t tree;
+
+    /* Hibernation dividers and regulator scale look like any other plan */
+    if (wanted->flags & STM32_PLAN_LOW_POWER) {
+        return -1;
+    }
+
+    stm32_plan->pllcfgr = STM32_REG_READ(RCC->PLLCFGR) & pllcfgr_msk;
+    stm32_plan->cfgr = (cfgr & (RCC_CFGR_HPRE_Msk | ppre_msk)) | (sw << RCC_CFGR_SW_Pos);
+    stm32_plan->flash_latency = (STM32_REG_READ(FLASH->ACR) & FLASH_ACR_LATENCY_Msk) >> FLASH_ACR_LATENCY_Pos;
+    stm32_plan->vos = 0;
+    stm32_plan->vos_msk = 0;    /* The regulator stays as it was found */
+    stm32_plan->flags = 0;
+    stm32_plan->tolerance = wanted->tolerance;
+    stm32_plan->bus_policy = wanted->bus_policy;
+    stm32_plan->plli2scfgr = 0;
+    stm32_plan->pllsaicfgr = 0;
+    stm32_plan->dckcfgr = 0;
+
+    switch (sw) {
+        case RCC_CFGR_SW_HSI:
+            break;
+        case RCC_CFGR_SW_HSE:
+            stm32_plan->flags |= STM32_PLAN_HSE;
+            break;
+        case RCC_CFGR_SW_PLL:
+            stm32_plan->flags |= STM32_PLAN_PLL;
+            break;
+        default:
+            return -1;
+    }
+    if (cr & RCC_CR_PLLI2SON) {
+        stm32_plan->flags |= STM32_PLAN_PLLI2S;
+        stm32_plan->plli2scfgr = STM32_REG_READ(RCC->PLLI2SCFGR) & pllx_msk;
+    }
+    if (cr & RCC_CR_PLLSAION) {
+        stm32_plan->flags |= STM32_PLAN_PLLSAI;
+        stm32_plan->pllsaicfgr = STM32_REG_READ(RCC->PLLSAICFGR) & pllx_msk;
+        stm32_plan->dckcfgr = STM32_REG_READ(RCC->DCKCFGR) & (RCC_DCKCFGR_PLLSAIDIVQ_Msk | RCC_DCKCFGR_PLLSAIDIVR_Msk);
+    }
+    if ((stm32_plan->flags & (STM32_PLAN_PLL | STM32_PLAN_PLLI2S | STM32_PLAN_PLLSAI))
+     && (stm32_plan->pllcfgr & RCC_PLLCFGR_PLLSRC)) {
+        stm32_plan->flags |= STM32_PLAN_HSE;
+    }
+
+    /* Same oscillator and the same audio / pixel clocks as the request */
+    if ((stm32_plan->flags & match_flags) != (wanted->flags & match_flags)
+     || ((stm32_plan->flags & STM32_PLAN_PLLI2S) && stm32_plan->plli2scfgr != wanted->plli2scfgr)
+     || ((stm32_plan->flags & STM32_PLAN_PLLSAI)
+      && (stm32_plan->pllsaicfgr != wanted->pllsaicfgr || stm32_plan->dckcfgr != wanted->dckcfgr))
+     || ((stm32_plan->flags & (STM32_PLAN_PLLI2S | STM32_PLAN_PLLSAI))
+      && (stm32_plan->pllcfgr & input_msk) != (wanted->pllcfgr & input_msk))) {
+        return -1;
+    }
+
+    stm32_plan->hse_freq = (stm32_plan->flags & STM32_PLAN_HSE) ? wanted->hse_freq : 0;
+    if (stm32_get_clock_tree(rcc_base, HSI_VALUE, stm32_plan->hse_freq, &tree) != 0) {
+        return -1;
+    }
+    stm32_plan->sysclk = (uint32_t)tree.sysclk;
+    stm32_plan->hclk = (uint32_t)tree.hclk;
+
+    /* The 48 MHz domain (USB, SDIO, RNG) must run at the rate the request gives it */
+    if (stm32_plan->flags & STM32_PLAN_PLL) {
+        uint32_t pllm = (wanted->pllcfgr & RCC_PLLCFGR_PLLM_Msk) >> RCC_PLLCFGR_PLLM_Pos;
+        uint32_t plln = (wanted->pllcfgr & RCC_PLLCFGR_PLLN_Msk) >> RCC_PLLCFGR_PLLN_Pos;
+        uint32_t pllq = (wanted->pllcfgr & RCC_PLLCFGR_PLLQ_Msk) >> RCC_PLLCFGR_PLLQ_Pos;
+        uint32_t pll_input = (wanted->pllcfgr & RCC_PLLCFGR_PLLSRC) ? wanted->hse_freq : HSI_VALUE;
+        uint32_t pll_q = (pllm > 0 && pllq > 0) ? ((pll_input / pllm) * plln / pllq) : 0;
+        if (!(wanted->flags & STM32_PLAN_PLL) || tree.pll_q != pll_q) {
+            return -1;
+        }
+    }
+
+    /* Whoever configured the clock may have used other limits or another policy */
+    if (tree.sysclk == 0
+     || tree.sysclk > limits->max_sysclk || tree.hclk > limits->max_hclk
+     || tree.pclk1 > limits->max_pclk1 || tree.pclk2 > limits->max_pclk2
+     || stm32_plan->flash_latency < stm32_calculate_flash_latency(stm32_plan->hclk, limits)
+     || stm32_calculate_bus_prescalers(stm32_plan->hclk, limits, (dmclk_bus_policy_t)wanted->bus_policy, &bus_bits) != 0
+     || (cfgr & ppre_msk) != (bus_bits & ppre_msk)) {
+        return -1;
+    }
+
+    if (pwr_base != 0 && (stm32_plan->flags & STM32_PLAN_PLL)) {
+        volatile PWR_TypeDef *PWR = (PWR_TypeDef *)pwr_base;
+        if (STM32_REG_READ(PWR->CSR1) & PWR_CSR1_ODRDY) {
+            stm32_plan->flags |= STM32_PLAN_OVERDRIVE;
+        } else if (limits->max_sysclk_no_overdrive != 0 && stm32_plan->sysclk > limits->max_sysclk_no_overdrive) {
+            return -1;
+        }
+    }
+
+    /* A PLL running next to another SYSCLK source belongs to no plan */
+    if (!stm32_plan_is_active(rcc_base, flash_base, pwr_base, plan)) {
+        return -1;
+    }
+
+    plan->frequency = stm32_plan->hclk;
+    return 0;
+}
+
+/**
+ * @brief Acknowledge a Clock Security System event
+ */
+int stm32_css_acknowledge(uintptr_t rcc_base)
+{
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+
+    if (!(STM32_REG_READ(RCC->CIR) & RCC_CIR_CSSF)) {
+        return -1;
+    }
+    /* CSSF is read-only, so writing back the enables cannot clear another flag */
+    STM32_REG_SET(RCC->CIR, RCC_CIR_CSSC);
+    return 0;
+}
+
+/**
+ * @brief Recover from a Clock Security System event
+ */
+int stm32_css_recover(uintptr_t rcc_base,
+                      uintptr_t flash_base,
+                      uintptr_t pwr_base,
+                      const clock_limits_t *limits,
+                      const dmclk_peripheral_clocks_t *peripheral,
+                      const dmclk_port_plan_t *failed_plan,
+                      dmclk_port_plan_t *plan)
+{
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+    dmclk_clock_tree_t tree;
+
+    /* The hardware already switched SYSCLK to HSI and stopped HSE and the PLL */
+    STM32_REG_CLEAR(RCC->CR, RCC_CR_CSSON);
+    if (stm32_get_clock_tree(rcc_base, HSI_VALUE, 0, &tree) != 0) {
+        return 1;
+    }
+    uint32_t hclk = (uint32_t)tree.hclk;
+
+    if (failed_plan == NULL) {
+        return 1;
+    }
+
+    /* Stay as close to the lost frequency as HSI allows, widening the tolerance step by step.
+     * The dedicated PLLs are only given up if no frequency works with them. */
+    const stm32_plan_t *failed = STM32_PLAN_CONST(failed_plan);
+    uint64_t tolerance = failed->hclk;
+    for (int attempt = 0; attempt < 2 && tolerance >= failed->hclk; attempt++) {
+        const dmclk_peripheral_clocks_t *attempt_peripheral = (attempt == 0) ? peripheral : NULL;
+        tolerance = (failed->tolerance != 0) ? failed->tolerance : 1U;
+        while (tolerance < failed->hclk) {
+            if (stm32_plan_clock(failed->hclk, tolerance, 0, limits,
+                                 (dmclk_bus_policy_t)failed->bus_policy, attempt_peripheral, plan) == 0) {
+                break;
+            }
+            tolerance *= 10U;
+        }
+    }
+    if (tolerance >= failed->hclk) {
+        return 1;
+    }
+
+    if (stm32_apply_plan(rcc_base, flash_base, pwr_base, hclk, plan) != 0) {
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Restore a plan after wakeup from STOP mode
+ */
+int stm32_resume_plan(uintptr_t rcc_base,
+                      uintptr_t pwr_base,
+                      const dmclk_port_plan_t *plan)
+{
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+    const stm32_plan_t *stm32_plan = STM32_PLAN_CONST(plan);
+    uint32_t sws = (stm32_plan->cfgr & RCC_CFGR_SW_Msk) << (RCC_CFGR_SWS_Pos - RCC_CFGR_SW_Pos);
+
+    /* Already restored, e.g. from the wakeup interrupt */
+    if ((STM32_REG_READ(RCC->CFGR) & RCC_CFGR_SWS_Msk) == sws) {
+        return 0;
+    }
+
+    /* Flash latency, prescalers and PLLCFGR are retained in STOP mode and the
+     * core runs from HSI, so only the oscillators have to be restarted. */
+    if (stm32_plan->flags & STM32_PLAN_HSE) {
+        STM32_REG_SET(RCC->CR, RCC_CR_HSEON);
+        if (stm32_wait_clock_ready(rcc_base, RCC_CR_HSERDY, HSE_STARTUP_TIMEOUT) != 0) {
+            return -1;
+        }
+    }
+
+    if ((stm32_plan->flags & STM32_PLAN_PLL) && !(STM32_REG_READ(RCC->CR) & RCC_CR_PLLRDY)) {
+        STM32_REG_WRITE(RCC->PLLCFGR, stm32_plan->pllcfgr);
+        STM32_REG_SET(RCC->CR, RCC_CR_PLLON);
+        if (stm32_wait_clock_ready(rcc_base, RCC_CR_PLLRDY, PLL_STARTUP_TIMEOUT) != 0) {
+            return -1;
+        }
+    }
+
+    /* Over-Drive is switched off by the STOP entry */
+    if (stm32_plan->flags & STM32_PLAN_OVERDRIVE) {
+        if (stm32_enable_overdrive(rcc_base, pwr_base, OVERDRIVE_STARTUP_TIMEOUT) != 0) {
+            return -1;
+        }
+    }
+
+    /* The dedicated PLLs are stopped in STOP mode too, their configuration is retained */
+    if (stm32_plan->flags & STM32_PLAN_PLLI2S) {
+        STM32_REG_SET(RCC->CR, RCC_CR_PLLI2SON);
+        if (stm32_wait_clock_ready(rcc_base, RCC_CR_PLLI2SRDY, PLL_STARTUP_TIMEOUT) != 0) {
+            return -1;
+        }
+    }
+    if (stm32_plan->flags & STM32_PLAN_PLLSAI) {
+        STM32_REG_SET(RCC->CR, RCC_CR_PLLSAION);
+        if (stm32_wait_clock_ready(rcc_base, RCC_CR_PLLSAIRDY, PLL_STARTUP_TIMEOUT) != 0) {
+            return -1;
+        }
+    }
+
+    return stm32_switch_sysclk(rcc_base, (stm32_plan->cfgr & RCC_CFGR_SW_Msk) >> RCC_CFGR_SW_Pos);
+}
+
+/**
+ * @brief Enter STOP mode and wait for a wakeup event
+ */
+void stm32_enter_stop(uintptr_t rcc_base, uintptr_t pwr_base)
+{
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+    volatile PWR_TypeDef *PWR = (PWR_TypeDef *)pwr_base;
+
+    STM32_REG_SET(RCC->APB1ENR, RCC_APB1ENR_PWREN);
+
+    /* STOP with the low-power regulator, not STANDBY */
+    uint32_t cr = STM32_REG_READ(PWR->CR1);
+    cr &= ~PWR_CR1_PDDS;
+    cr |= PWR_CR1_LPDS;
+    STM32_REG_WRITE(PWR->CR1, cr);
+
+#if defined(__arm__)
+    ARM_SCB_SCR |= ARM_SCB_SCR_SLEEPDEEP_Msk;
+    __asm__ volatile ("dsb\n\twfi\n\tisb" ::: "memory");
+    ARM_SCB_SCR &= ~ARM_SCB_SCR_SLEEPDEEP_Msk;
+#endif
+}
+
+/**
+ * @brief Route a clock to MCO1 (PA8) or MCO2 (PC9)
+ */
+int stm32_configure_mco(uintptr_t rcc_base,
+                        uintptr_t gpio_base,
+                        uint32_t output,
+                        dmclk_mco_source_t source,
+                        uint32_t divider)
+{
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+    volatile GPIO_TypeDef *GPIO = (GPIO_TypeDef *)gpio_base;
+    uint32_t pin;
+    uint32_t gpio_enable;
+    uint32_t select;
+    uint32_t cfgr_msk;
+    uint32_t cfgr_bits;
+    int valid = 1;
+
+    if (divider < 1U || divider > RCC_CFGR_MCOPRE_MAX) {
+        return -1;
+    }
+    uint32_t prescaler = (divider == 1U) ? 0U : (0x4U | (divider - 2U));
+
+    if (output == 1U) {
+        pin = MCO1_PIN;
+        gpio_enable = RCC_AHB1ENR_GPIOAEN;
+        switch (source) {
+            case dmclk_mco_source_internal: select = RCC_CFGR_MCO1_HSI; break;
+            case dmclk_mco_source_external: select = RCC_CFGR_MCO1_HSE; break;
+            case dmclk_mco_source_pll:      select = RCC_CFGR_MCO1_PLL; break;
+            default:                        select = 0; valid = (source == dmclk_mco_source_off); break;
+        }
+        cfgr_msk = RCC_CFGR_MCO1_Msk | RCC_CFGR_MCO1PRE_Msk;
+        cfgr_bits = (select << RCC_CFGR_MCO1_Pos) | (prescaler << RCC_CFGR_MCO1PRE_Pos);
+    } else if (output == 2U) {
+        pin = MCO2_PIN;
+        gpio_enable = RCC_AHB1ENR_GPIOCEN;
+        switch (source) {
+            case dmclk_mco_source_sysclk:   select = RCC_CFGR_MCO2_SYSCLK; break;
+            case dmclk_mco_source_plli2s:   select = RCC_CFGR_MCO2_PLLI2S; break;
+            case dmclk_mco_source_external: select = RCC_CFGR_MCO2_HSE; break;
+            case dmclk_mco_source_pll:      select = RCC_CFGR_MCO2_PLL; break;
+            default:                        select = 0; valid = (source == dmclk_mco_source_off); break;
+        }
+        cfgr_msk = RCC_CFGR_MCO2_Msk | RCC_CFGR_MCO2PRE_Msk;
+        cfgr_bits = (select << RCC_CFGR_MCO2_Pos) | (prescaler << RCC_CFGR_MCO2PRE_Pos);
+    } else {
+        return -1;
+    }
+    if (!valid) {
+        return -1;
+    }
+
+    STM32_REG_SET(RCC->AHB1ENR, gpio_enable);
+
+    if (source == dmclk_mco_source_off) {
+        STM32_REG_MODIFY(GPIO->MODER, 0x3U << (pin * 2U), GPIO_MODER_INPUT << (pin * 2U));
+        return 0;
+    }
+
+    STM32_REG_MODIFY(RCC->CFGR, cfgr_msk, cfgr_bits);
+
+    /* Push-pull alternate function without pulls, fast enough for the PLL output */
+    STM32_REG_CLEAR(GPIO->OTYPER, 1U << pin);
+    STM32_REG_CLEAR(GPIO->PUPDR, 0x3U << (pin * 2U));
+    STM32_REG_SET(GPIO->OSPEEDR, GPIO_OSPEEDR_VERY_HIGH << (pin * 2U));
+    STM32_REG_MODIFY(GPIO->AFR[pin / 8U], 0xFU << ((pin % 8U) * 4U), GPIO_AF_MCO << ((pin % 8U) * 4U));
+    STM32_REG_MODIFY(GPIO->MODER, 0x3U << (pin * 2U), GPIO_MODER_AF << (pin * 2U));
+    return 0;
+}
+
+/**
+ * @brief Enable PWR Over-Drive mode
+ */
+int stm32_enable_overdrive(uintptr_t rcc_base, uintptr_t pwr_base, uint32_t timeout)
+{
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+    volatile PWR_TypeDef *PWR = (PWR_TypeDef *)pwr_base;
+    uint32_t counter;
+
+    STM32_REG_SET(RCC->APB1ENR, RCC_APB1ENR_PWREN);
+
+    STM32_REG_SET(PWR->CR1, PWR_CR1_ODEN);
+    counter = 0;
+    while (!(STM32_REG_READ(PWR->CSR1) & PWR_CSR1_ODRDY)) {
+        STM32_POLL_HOOK();
+        if (++counter > timeout) {
+            return -1;
+        }
+    }
+
+    /* The regulator only runs in Over-Drive once the switch is done */
+    STM32_REG_SET(PWR->CR1, PWR_CR1_ODSWEN);
+    counter = 0;
+    while (!(STM32_REG_READ(PWR->CSR1) & PWR_CSR1_ODSWRDY)) {
+        STM32_POLL_HOOK();
+        if (++counter > timeout) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Disable PWR Over-Drive mode
+ */
+void stm32_disable_overdrive(uintptr_t rcc_base, uintptr_t pwr_base)
+{
+    if (pwr_base == 0) {
+        return;
+    }
+
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+    volatile PWR_TypeDef *PWR = (PWR_TypeDef *)pwr_base;
+
+    STM32_REG_SET(RCC->APB1ENR, RCC_APB1ENR_PWREN);
+    if (STM32_REG_READ(PWR->CR1) & PWR_CR1_ODEN) {
+        STM32_REG_CLEAR(PWR->CR1, PWR_CR1_ODSWEN | PWR_CR1_ODEN);
+    }
+}
+
+/**
+ * @brief Get current system clock frequency
+ */
+uint32_t stm32_get_sysclk_freq(uintptr_t rcc_base, uint32_t hsi_value, uint32_t hse_value)
+{
+    dmclk_clock_tree_t tree;
+
+    if (stm32_get_clock_tree(rcc_base, hsi_value, hse_value, &tree) != 0) {
+        return 0;
+    }
+    return (uint32_t)tree.sysclk;
+}
+
+/**
+ * @brief Decode the clock tree from the RCC registers
+ */
+int stm32_get_clock_tree(uintptr_t rcc_base, uint32_t hsi_value, uint32_t hse_value, dmclk_clock_tree_t *tree)
+{
+    if (tree == NULL) {
+        return -1;
+    }
+
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)rcc_base;
+    uint32_t cr = STM32_REG_READ(RCC->CR);
+    uint32_t cfgr = STM32_REG_READ(RCC->CFGR);
+    uint32_t pllcfgr = STM32_REG_READ(RCC->PLLCFGR);
+    uint32_t vco = 0;
+    uint32_t pll_p = 0;
+    uint32_t pll_q = 0;
+
+    if (cr & RCC_CR_PLLRDY) {
+        uint32_t pllm = (pllcfgr & RCC_PLLCFGR_PLLM_Msk) >> RCC_PLLCFGR_PLLM_Pos;
+        uint32_t plln = (pllcfgr & RCC_PLLCFGR_PLLN_Msk) >> RCC_PLLCFGR_PLLN_Pos;
+        uint32_t pllp = ((((pllcfgr & RCC_PLLCFGR_PLLP_Msk) >> RCC_PLLCFGR_PLLP_Pos) + 1) * 2);
+        uint32_t pllq = (pllcfgr & RCC_PLLCFGR_PLLQ_Msk) >> RCC_PLLCFGR_PLLQ_Pos;
+        uint32_t pll_input = (pllcfgr & RCC_PLLCFGR_PLLSRC) ? hse_value : hsi_value;
+
+        if (pllm > 0) {
+            vco = (pll_input / pllm) * plln;
+            pll_p = vco / pllp;
+            pll_q = (pllq > 0) ? (vco / pllq) : 0;
+        }
+    }
+
+    /* PLLI2S and PLLSAI run from the main PLL input */
+    uint32_t i2s = 0;
+    uint32_t sai = 0;
+    uint32_t lcd = 0;
+    if (cr & (RCC_CR_PLLI2SRDY | RCC_CR_PLLSAIRDY)) {
+        uint32_t pllm = (pllcfgr & RCC_PLLCFGR_PLLM_Msk) >> RCC_PLLCFGR_PLLM_Pos;
+        uint32_t pll_in = (pllm > 0) ? (((pllcfgr & RCC_PLLCFGR_PLLSRC) ? hse_value : hsi_value) / pllm) : 0;
+
+        if (cr & RCC_CR_PLLI2SRDY) {
+            uint32_t plli2scfgr = STM32_REG_READ(RCC->PLLI2SCFGR);
+            uint32_t n = (plli2scfgr & RCC_PLLxCFGR_PLLN_Msk) >> RCC_PLLxCFGR_PLLN_Pos;
+            uint32_t r = (plli2scfgr & RCC_PLLxCFGR_PLLR_Msk) >> RCC_PLLxCFGR_PLLR_Pos;
+            i2s = (r > 0) ? (pll_in * n / r) : 0;
+        }
+        if (cr & RCC_CR_PLLSAIRDY) {
+            uint32_t pllsaicfgr = STM32_REG_READ(RCC->PLLSAICFGR);
+            uint32_t dckcfgr = STM32_REG_READ(RCC->DCKCFGR);
+            uint32_t n = (pllsaicfgr & RCC_PLLxCFGR_PLLN_Msk) >> RCC_PLLxCFGR_PLLN_Pos;
+            uint32_t q = (pllsaicfgr & RCC_PLLxCFGR_PLLQ_Msk) >> RCC_PLLxCFGR_PLLQ_Pos;
+            uint32_t r = (pllsaicfgr & RCC_PLLxCFGR_PLLR_Msk) >> RCC_PLLxCFGR_PLLR_Pos;
+            uint32_t divq = ((dckcfgr & RCC_DCKCFGR_PLLSAIDIVQ_Msk) >> RCC_DCKCFGR_PLLSAIDIVQ_Pos) + 1U;
+            uint32_t divr = stm32_pllsai_divr[(dckcfgr & RCC_DCKCFGR_PLLSAIDIVR_Msk) >> RCC_DCKCFGR_PLLSAIDIVR_Pos];
+            sai = (q > 0) ? (pll_in * n / (q * divq)) : 0;
+            lcd = (r > 0) ? (pll_in * n / (r * divr)) : 0;
+        }
+    }
+
+    uint32_t sysclk;
+    switch ((cfgr & RCC_CFGR_SWS_Msk) >> RCC_CFGR_SWS_Pos) {
+        case RCC_CFGR_SW_HSI:
+            sysclk = hsi_value;
+            break;
+        case RCC_CFGR_SW_HSE:
+            sysclk = hse_value;
+            break;
+        case RCC_CFGR_SW_PLL:
+            sysclk = pll_p;
+            break;
+        default:
+            sysclk = 0;
+            break;
+    }
+
+    uint32_t hclk = sysclk / stm32_ahb_divisors[(cfgr & RCC_CFGR_HPRE_Msk) >> RCC_CFGR_HPRE_Pos];
+    uint32_t apb1_div = stm32_apb_divisors[(cfgr & RCC_CFGR_PPRE1_Msk) >> RCC_CFGR_PPRE1_Pos];
+    uint32_t apb2_div = stm32_apb_divisors[(cfgr & RCC_CFGR_PPRE2_Msk) >> RCC_CFGR_PPRE2_Pos];
+
+    tree->sysclk = sysclk;
+    tree->hclk = hclk;
+    tree->pclk1 = hclk / apb1_div;
+    tree->pclk2 = hclk / apb2_div;
+    tree->apb1_timer = (apb1_div == 1) ? tree->pclk1 : (tree->pclk1 * 2);
+    tree->apb2_timer = (apb2_div == 1) ? tree->pclk2 : (tree->pclk2 * 2);
+    tree->pll_vco = vco;
+    tree->pll_q = pll_q;
+    tree->i2s = i2s;
+    tree->sai = sai;
+    tree->lcd = lcd;
+    tree->oscillators = ((cr & RCC_CR_HSIRDY) ? DMCLK_OSC_INTERNAL : 0U)
+                      | ((cr & RCC_CR_HSERDY) ? DMCLK_OSC_EXTERNAL : 0U)
+                      | ((cr & RCC_CR_PLLRDY) ? DMCLK_OSC_PLL : 0U)
+                      | ((cr & RCC_CR_PLLI2SRDY) ? DMCLK_OSC_PLLI2S : 0U)
+                      | ((cr & RCC_CR_PLLSAIRDY) ? DMCLK_OSC_PLLSAI : 0U);
+
+    return 0;
+}
+
+uint32_t stm32_cycle_count(void)
+{
+    if (!(ARM_DWT_CTRL & ARM_DWT_CTRL_CYCCNTENA_Msk)) {
+        /* Enable tracing + DWT cycle counter */
+        ARM_DEMCR |= ARM_DEMCR_TRCENA_Msk;
+        ARM_DWT_LAR = ARM_DWT_LAR_UNLOCK_KEY;
+        ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA_Msk;
+    }
+    return ARM_DWT_CYCCNT;
+}
+
+int stm32_delay_cycles_dwt(uint64_t target_cycles, uint64_t *elapsed_cycles)
+{
+    if (elapsed_cycles == NULL) {
+        return -1;
+    }
+
+    *elapsed_cycles = 0U;
+    if (target_cycles == 0U) {
+        return 0;
+    }
 
+    /* CYCCNT is not reset - it also times the asynchronous switches, see stm32_cycle_count() */
+    stm32_cycle_count();
     if (!stm32_dwt_cyccnt_is_running()) {
         return -1;
     }
@@ -5,6 +5,49 @@
 #include <stddef.h>
 #include "dmclk_port.h"
 
+/**
+ * @brief Hook called in every register polling loop
+ *
+ * Hardware needs none. Ports modelling the peripherals in RAM (see port/sim) define
+ * STM32_POLL_HOOK_ENABLED and implement stm32_poll_hook() to advance their model,
+ * e.g. to raise a ready flag once the modelled start-up time has passed.
+ */
+#ifdef STM32_POLL_HOOK_ENABLED
+void stm32_poll_hook(void);
+#   define STM32_POLL_HOOK()    stm32_poll_hook()
+#else
+#   define STM32_POLL_HOOK()    do { } while (0)
+#endif
+
+/**
+ * @brief Register access layer
+ *
+ * All RCC, FLASH, PWR and GPIO accesses of the common code go through these
+ * macros. On hardware they are plain volatile accesses. Ports defining
+ * STM32_REG_ACCESS_HOOKED implement stm32_reg_read()/stm32_reg_write()
+ * instead, e.g. to record the ordered sequence of accesses of a transition.
+ */
+#ifdef STM32_REG_ACCESS_HOOKED
+uint32_t stm32_reg_read(const volatile uint32_t *reg);
+void stm32_reg_write(volatile uint32_t *reg, uint32_t value);
+#else
+static inline uint32_t stm32_reg_read(const volatile uint32_t *reg)
+{
+    return *reg;
+}
+
+static inline void stm32_reg_write(volatile uint32_t *reg, uint32_t value)
+{
+    *reg = value;
+}
+#endif
+
+#define STM32_REG_READ(reg)                 stm32_reg_read(&(reg))
+#define STM32_REG_WRITE(reg, value)         stm32_reg_write(&(reg), (value))
+#define STM32_REG_SET(reg, bits)            STM32_REG_WRITE(reg, STM32_REG_READ(reg) | (bits))
+#define STM32_REG_CLEAR(reg, bits)          STM32_REG_WRITE(reg, STM32_REG_READ(reg) & ~(bits))
+#define STM32_REG_MODIFY(reg, msk, bits)    STM32_REG_WRITE(reg, (STM32_REG_READ(reg) & ~(msk)) | (bits))
+
 /**
  * @brief PLL configuration parameters
  */
@@ -12,7 +55,7 @@ typedef struct {
     uint32_t pllm;          /* Division factor for PLL input clock */
     uint32_t plln;          /* Multiplication factor for VCO */
     uint32_t pllp;          /* Division factor for main system clock */
-    uint32_t pllq;          /* Division factor for USB OTG FS, SDIO and RNG clocks */
+    uint32_t pllq;          /* Division factor for USB OTG FS, SDIO and RNG clocks (kept at or below 48 MHz) */
     uint32_t pll_source;    /* PLL source: 0 = HSI, 1 = HSE */
 } pll_config_t;
 
@@ -34,10 +77,47 @@ typedef struct {
     uint32_t plln_max;
     uint32_t pllp_min;
     uint32_t pllp_max;
+    uint32_t max_sysclk_no_overdrive;   /* Above this SYSCLK PWR Over-Drive is required, 0 if not supported */
+    uint32_t vos_msk;                   /* PWR_CR1.VOS field mask, 0 if voltage scaling is not handled */
+    uint32_t vos_performance;           /* VOS value allowing the maximum frequency */
+    uint32_t vos_low_power;             /* VOS value with the lowest consumption */
     const void *flash_latency_table;
     uint32_t flash_latency_count;
 } clock_limits_t;
 
+/**
+ * @brief STM32 view of a precomputed clock plan (stored in dmclk_port_plan_t::data)
+ */
+typedef struct {
+    uint32_t sysclk;        /* SYSCLK achieved by the plan in Hz */
+    uint32_t hclk;          /* HCLK achieved by the plan in Hz */
+    uint32_t hse_freq;      /* HSE frequency in Hz, 0 when the plan does not use HSE */
+    uint32_t pllcfgr;       /* RCC_PLLCFGR image */
+    uint32_t cfgr;          /* RCC_CFGR image - SW, HPRE, PPRE1 and PPRE2 fields */
+    uint32_t flash_latency; /* FLASH_ACR.LATENCY value */
+    uint32_t vos;           /* PWR_CR1.VOS value */
+    uint32_t vos_msk;       /* PWR_CR1.VOS mask, 0 to leave the regulator alone */
+    uint32_t flags;         /* STM32_PLAN_* flags */
+    uint32_t tolerance;     /* Tolerance the plan was solved with, used to re-plan on HSE failure */
+    uint32_t bus_policy;    /* Bus policy the plan was solved with */
+    uint32_t plli2scfgr;    /* RCC_PLLI2SCFGR image, valid with STM32_PLAN_PLLI2S */
+    uint32_t pllsaicfgr;    /* RCC_PLLSAICFGR image, valid with STM32_PLAN_PLLSAI */
+    uint32_t dckcfgr;       /* RCC_DCKCFGR PLLSAIDIVQ and PLLSAIDIVR fields */
+} stm32_plan_t;
+
+#define STM32_PLAN_HSE          (1U << 0)   /* Plan needs HSE running */
+#define STM32_PLAN_PLL          (1U << 1)   /* Plan runs SYSCLK from the main PLL */
+#define STM32_PLAN_OVERDRIVE    (1U << 2)   /* Plan needs PWR Over-Drive */
+#define STM32_PLAN_LOW_POWER    (1U << 3)   /* Hibernation plan - lowest-power dividers and regulator scale */
+#define STM32_PLAN_PLLI2S       (1U << 4)   /* Plan runs PLLI2S */
+#define STM32_PLAN_PLLSAI       (1U << 5)   /* Plan runs PLLSAI */
+
+#define STM32_PLAN(plan)        ((stm32_plan_t *)(void *)(plan)->data)
+#define STM32_PLAN_CONST(plan)  ((const stm32_plan_t *)(const void *)(plan)->data)
+
+_Static_assert(sizeof(stm32_plan_t) <= sizeof(((dmclk_port_plan_t *)0)->data),
+               "stm32_plan_t does not fit in dmclk_port_plan_t");
+
 /**
  * @brief Common functions for STM32 clock configuration
  */
@@ -62,19 +142,24 @@ int stm32_calculate_pll_config(dmclk_frequency_t target_freq,
                                 uint32_t *actual_freq);
 
 /**
- * @brief Configure Flash latency based on system clock frequency
+ * @brief Calculate Flash latency for a system clock frequency
  * 
  * @param sysclk_freq System clock frequency in Hz
+ * @param limits Clock configuration limits holding the latency table
+ * 
+ * @return uint32_t Number of Flash wait states
+ */
+uint32_t stm32_calculate_flash_latency(uint32_t sysclk_freq, const clock_limits_t *limits);
+
+/**
+ * @brief Set Flash latency
+ * 
  * @param flash_base Flash controller base address
- * @param latency_table Flash latency table
- * @param table_size Size of latency table
+ * @param latency Number of wait states
  * 
  * @return int 0 on success, non-zero on failure
  */
-int stm32_configure_flash_latency(uint32_t sysclk_freq,
-                                   uintptr_t flash_base,
-                                   const void *latency_table,
-                                   uint32_t table_size);
+int stm32_set_flash_latency(uintptr_t flash_base, uint32_t latency);
 
 /**
  * @brief Wait for clock to be ready
@@ -98,27 +183,336 @@ int stm32_wait_clock_ready(uintptr_t rcc_base, uint32_t ready_bit, uint32_t time
 int stm32_switch_sysclk(uintptr_t rcc_base, uint32_t source);
 
 /**
- * @brief Configure bus prescalers
+ * @brief Calculate bus prescalers
  * 
- * @param rcc_base RCC base address
  * @param sysclk_freq System clock frequency
  * @param limits Clock configuration limits
+ * @param policy Bus clock policy
+ * @param cfgr_bits Output RCC_CFGR HPRE, PPRE1 and PPRE2 fields
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+int stm32_calculate_bus_prescalers(uint32_t sysclk_freq,
+                                   const clock_limits_t *limits,
+                                   dmclk_bus_policy_t policy,
+                                   uint32_t *cfgr_bits);
+
+/**
+ * @brief Plan a SYSCLK configuration driven by the main PLL
+ * 
+ * Only calculates - the hardware is not touched. PLLI2S and PLLSAI share PLLM with
+ * the main PLL, so with @p peripheral the division factor is chosen such that all
+ * requested outputs are reachable.
+ * 
+ * @param target_freq Target system clock frequency in Hz
+ * @param tolerance Tolerance in Hz
+ * @param hse_freq HSE frequency feeding the PLL in Hz, 0 to feed it from HSI
+ * @param limits Clock configuration limits
+ * @param policy Bus clock policy
+ * @param peripheral Clocks of the PLLI2S / PLLSAI domains, NULL if they are not used
+ * @param plan Output plan
+ * 
+ * @return int 0 on success, non-zero if the target cannot be reached
+ */
+int stm32_plan_pll(dmclk_frequency_t target_freq,
+                   dmclk_frequency_t tolerance,
+                   uint32_t hse_freq,
+                   const clock_limits_t *limits,
+                   dmclk_bus_policy_t policy,
+                   const dmclk_peripheral_clocks_t *peripheral,
+                   dmclk_port_plan_t *plan);
+
+/**
+ * @brief Plan a SYSCLK configuration running directly from HSI or HSE
+ * 
+ * Only the AHB prescaler (/1 ... /512) divides the oscillator, the main PLL is not
+ * used. PLLI2S and PLLSAI still run from the oscillator divided by PLLM.
+ * 
+ * @param target_freq Target HCLK frequency in Hz
+ * @param tolerance Tolerance in Hz
+ * @param hse_freq HSE frequency in Hz, 0 to run from HSI
+ * @param limits Clock configuration limits
+ * @param policy Bus clock policy
+ * @param peripheral Clocks of the PLLI2S / PLLSAI domains, NULL if they are not used
+ * @param plan Output plan
+ * 
+ * @return int 0 on success, non-zero if the target cannot be reached
+ */
+int stm32_plan_direct(dmclk_frequency_t target_freq,
+                      dmclk_frequency_t tolerance,
+                      uint32_t hse_freq,
+                      const clock_limits_t *limits,
+                      dmclk_bus_policy_t policy,
+                      const dmclk_peripheral_clocks_t *peripheral,
+                      dmclk_port_plan_t *plan);
+
+/**
+ * @brief Plan the cheapest configuration reaching the target
+ * 
+ * Tries the oscillator divided by the AHB prescaler first and the PLL only if
+ * that cannot meet the tolerance.
+ * 
+ * @param target_freq Target HCLK frequency in Hz
+ * @param tolerance Tolerance in Hz
+ * @param hse_freq HSE frequency in Hz, 0 to run from HSI
+ * @param limits Clock configuration limits
+ * @param policy Bus clock policy
+ * @param peripheral Clocks of the PLLI2S / PLLSAI domains, NULL if they are not used
+ * @param plan Output plan
+ * 
+ * @return int 0 on success, non-zero if the target cannot be reached
+ */
+int stm32_plan_clock(dmclk_frequency_t target_freq,
+                     dmclk_frequency_t tolerance,
+                     uint32_t hse_freq,
+                     const clock_limits_t *limits,
+                     dmclk_bus_policy_t policy,
+                     const dmclk_peripheral_clocks_t *peripheral,
+                     dmclk_port_plan_t *plan);
+
+/**
+ * @brief Plan a low-power configuration running directly from HSI or HSE
+ * 
+ * The AHB prescaler divides the oscillator down to the target and both APB
+ * buses are divided by 16. HSI is preferred so HSE can be switched off.
+ * 
+ * @param target_freq Target HCLK frequency in Hz
+ * @param tolerance Tolerance in Hz
+ * @param hse_freq HSE frequency in Hz, 0 if HSE may not be used
+ * @param limits Clock configuration limits
+ * @param plan Output plan
+ * 
+ * @return int 0 on success, non-zero if the target cannot be reached
+ */
+int stm32_plan_low_power(dmclk_frequency_t target_freq,
+                         dmclk_frequency_t tolerance,
+                         uint32_t hse_freq,
+                         const clock_limits_t *limits,
+                         dmclk_port_plan_t *plan);
+
+/**
+ * @brief Apply a precomputed clock plan
+ * 
+ * Starts the oscillator, raises Flash latency before and lowers it after the
+ * frequency change, locks the PLL, enables Over-Drive if needed and switches SYSCLK.
+ * Plans without PLL additionally stop the PLL and the unused oscillator
+ * afterwards, and low-power plans lower the regulator voltage scale. A main PLL
+ * already locked to the plan is kept; otherwise SYSCLK moves to HSI while it is
+ * relocked. PLLI2S and PLLSAI are only restarted when their configuration or
+ * input changes.
+ * 
+ * @param rcc_base RCC base address
+ * @param flash_base Flash controller base address
+ * @param pwr_base PWR base address, 0 to leave the regulator alone
+ * @param current_hclk HCLK before the change, decides when bus prescalers are written
+ * @param plan Plan to apply
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+int stm32_apply_plan(uintptr_t rcc_base,
+                     uintptr_t flash_base,
+                     uintptr_t pwr_base,
+                     uint32_t current_hclk,
+                     const dmclk_port_plan_t *plan);
+
+/**
+ * @brief Start the oscillator and main PLL of a plan without waiting for them
+ *
+ * The slow part of stm32_apply_plan() split into steps: HSE is started and,
+ * once it runs, the main PLL is relocked (from HSI if it drove SYSCLK). Instead
+ * of polling, the HSE / PLL ready interrupt (RCC_CIR HSERDYIE / PLLRDYIE) is
+ * enabled and the function returns. The ready interrupt only wakes the caller:
+ * call it again from task context (dmclk_port_advance_async() in stm32_port.c)
+ * until it returns 0, then stm32_apply_plan() finishes the switch without
+ * waiting for HSE or the main PLL. The state is kept in the registers only.
+ *
+ * @param rcc_base RCC base address
+ * @param pwr_base PWR base address, 0 to leave the regulator alone
+ * @param plan Plan to prepare
+ *
+ * @return int 0 when the oscillator and PLL of @p plan run, 1 while a ready
+ *             interrupt is awaited, -1 on failure
+ */
+int stm32_prepare_plan(uintptr_t rcc_base,
+                       uintptr_t pwr_base,
+                       const dmclk_port_plan_t *plan);
+
+/**
+ * @brief Stop waiting for the ready interrupts armed by stm32_prepare_plan()
+ *
+ * Disables the HSE / PLL ready interrupts and acknowledges their flags. The
+ * oscillator and PLL are left as they are - the next plan applied decides.
+ *
+ * @param rcc_base RCC base address
+ */
+void stm32_cancel_prepare(uintptr_t rcc_base);
+
+/**
+ * @brief Check whether the hardware already runs a plan
+ * 
+ * Compares the SYSCLK source, bus prescalers, Flash latency, the running PLLs
+ * with their configuration and the regulator state with the plan. Used to take
+ * over a configuration applied before the module was loaded (boot code calling
+ * dmclk_early_init(), a previous instance of the module) without touching it.
+ * 
+ * @param rcc_base RCC base address
+ * @param flash_base Flash controller base address
+ * @param pwr_base PWR base address, 0 if the family has no PWR handling
+ * @param plan Plan to check
+ * 
+ * @return int 1 if applying @p plan would not change anything, 0 otherwise
+ */
+int stm32_plan_is_active(uintptr_t rcc_base,
+                         uintptr_t flash_base,
+                         uintptr_t pwr_base,
+                         const dmclk_port_plan_t *plan);
+
+/**
+ * @brief Decode the running clock configuration into a plan
+ * 
+ * Reads the SYSCLK source, the PLLs, bus prescalers, Flash latency and the
+ * Over-Drive state back into a plan. What the registers cannot tell - the HSE
+ * frequency, tolerance and bus policy - is taken from @p request. The decoded
+ * plan is only returned when it is equivalent to @p request: same oscillator,
+ * same PLLI2S / PLLSAI outputs, the bus prescalers the policy would choose and
+ * every clock within the family limits. Hibernation plans are never matched.
+ * 
+ * @param rcc_base RCC base address
+ * @param flash_base Flash controller base address
+ * @param pwr_base PWR base address, 0 if the family has no PWR handling
+ * @param limits Clock configuration limits
+ * @param request Plan solved for the configuration
+ * @param plan Decoded plan, plan->frequency is the running HCLK
+ * 
+ * @return int 0 if the running configuration can stand in for @p request, non-zero otherwise
+ */
+int stm32_read_plan(uintptr_t rcc_base,
+                    uintptr_t flash_base,
+                    uintptr_t pwr_base,
+                    const clock_limits_t *limits,
+                    const dmclk_port_plan_t *request,
+                    dmclk_port_plan_t *plan);
+
+/**
+ * @brief Acknowledge a Clock Security System event
+ * 
+ * The only register access of the CSS interrupt (NMI): clears CSSF with a single
+ * write of RCC_CIR. The hardware already switched SYSCLK to HSI and stopped HSE
+ * and the PLL, everything else is left to stm32_css_recover().
+ * 
+ * @param rcc_base RCC base address
+ * 
+ * @return int 0 if a CSS event was acknowledged, -1 if none is pending
+ */
+int stm32_css_acknowledge(uintptr_t rcc_base);
+
+/**
+ * @brief Recover from a Clock Security System event
+ * 
+ * Called from task context after stm32_css_acknowledge(). Disarms CSS and
+ * re-plans on HSI as close to the HCLK of the failed plan as possible: first
+ * within its tolerance, then widening the tolerance ten times per attempt.
+ * 
+ * @param rcc_base RCC base address
+ * @param flash_base Flash controller base address
+ * @param pwr_base PWR base address
+ * @param limits Clock configuration limits
+ * @param peripheral Clocks of the PLLI2S / PLLSAI domains, NULL if they are not used
+ * @param failed_plan Plan that was running from HSE, NULL to stay on plain HSI
+ * @param plan Output HSI based plan that was applied
+ * 
+ * @return int 0 if @p plan was applied, 1 if the core stays on plain HSI
+ */
+int stm32_css_recover(uintptr_t rcc_base,
+                      uintptr_t flash_base,
+                      uintptr_t pwr_base,
+                      const clock_limits_t *limits,
+                      const dmclk_peripheral_clocks_t *peripheral,
+                      const dmclk_port_plan_t *failed_plan,
+                      dmclk_port_plan_t *plan);
+
+/**
+ * @brief Restore a plan after wakeup from STOP mode
+ * 
+ * Only restarts HSE and the PLL and switches SYSCLK back - the Flash latency
+ * and bus prescalers of the plan are still in place after STOP. Returns
+ * immediately if SYSCLK already runs from the plan's source, so it can be
+ * called from the wakeup interrupt and again after WFI returns.
+ * 
+ * @param rcc_base RCC base address
+ * @param pwr_base PWR base address (only used by plans needing Over-Drive)
+ * @param plan Plan that was active before STOP mode
  * 
  * @return int 0 on success, non-zero on failure
  */
-int stm32_configure_bus_prescalers(uintptr_t rcc_base, 
-                                    uint32_t sysclk_freq,
-                                    const clock_limits_t *limits);
+int stm32_resume_plan(uintptr_t rcc_base,
+                      uintptr_t pwr_base,
+                      const dmclk_port_plan_t *plan);
+
+/**
+ * @brief Enter STOP mode and wait for a wakeup event
+ * 
+ * Returns after wakeup with the core running from HSI.
+ * 
+ * @param rcc_base RCC base address
+ * @param pwr_base PWR base address
+ */
+void stm32_enter_stop(uintptr_t rcc_base, uintptr_t pwr_base);
+
+/**
+ * @brief Route a clock to MCO1 (PA8) or MCO2 (PC9)
+ * 
+ * Selects the clock and prescaler in RCC_CFGR and switches the pin to its
+ * alternate function at very high speed. Disabling only releases the pin
+ * (input mode), the RCC selection is left as it is.
+ * 
+ * @param rcc_base RCC base address
+ * @param gpio_base Base address of the GPIO port carrying the pin (GPIOA for MCO1, GPIOC for MCO2)
+ * @param output 1 for MCO1, 2 for MCO2
+ * @param source Clock to output
+ * @param divider Output divider, 1 to 5
+ * 
+ * @return int 0 on success, non-zero if the source or divider is not available on the output
+ */
+int stm32_configure_mco(uintptr_t rcc_base,
+                        uintptr_t gpio_base,
+                        uint32_t output,
+                        dmclk_mco_source_t source,
+                        uint32_t divider);
+
+/**
+ * @brief Disable PWR Over-Drive mode if it is enabled
+ * 
+ * @param rcc_base RCC base address
+ * @param pwr_base PWR base address, 0 if the family has no PWR handling
+ */
+void stm32_disable_overdrive(uintptr_t rcc_base, uintptr_t pwr_base);
 
 /**
  * @brief Get current system clock frequency
  * 
  * @param rcc_base RCC base address
  * @param hsi_value HSI oscillator frequency
+ * @param hse_value HSE oscillator frequency (0 if unknown)
  * 
  * @return uint32_t Current system clock frequency in Hz
  */
-uint32_t stm32_get_sysclk_freq(uintptr_t rcc_base, uint32_t hsi_value);
+uint32_t stm32_get_sysclk_freq(uintptr_t rcc_base, uint32_t hsi_value, uint32_t hse_value);
+
+/**
+ * @brief Decode the clock tree from the RCC registers
+ * 
+ * Timer clocks follow the APB rule: equal to PCLKx when the APB prescaler is 1,
+ * twice PCLKx otherwise (TIMPRE is assumed to be cleared).
+ * 
+ * @param rcc_base RCC base address
+ * @param hsi_value HSI oscillator frequency
+ * @param hse_value HSE oscillator frequency (0 if unknown)
+ * @param tree Output clock tree
+ * 
+ * @return int 0 on success, non-zero on failure
+ */
+int stm32_get_clock_tree(uintptr_t rcc_base, uint32_t hsi_value, uint32_t hse_value, dmclk_clock_tree_t *tree);
 
 /**
  * @brief Enable PWR Over-Drive mode (STM32F7 parts only).
@@ -126,7 +520,8 @@ uint32_t stm32_get_sysclk_freq(uintptr_t rcc_base, uint32_t hsi_value);
  * Required by ST above a family-specific HCLK threshold (216MHz-class parts:
  * 180MHz, see RM0385 "Over-drive switching") to keep the core, buses and
  * peripherals (e.g. FMC to external SDRAM) within timing spec. Enables the
- * PWR peripheral clock, sets PWR_CR1.ODEN and waits for PWR_CSR1.ODRDY.
+ * PWR peripheral clock, sets PWR_CR1.ODEN and waits for PWR_CSR1.ODRDY, then
+ * sets PWR_CR1.ODSWEN and waits for PWR_CSR1.ODSWRDY.
  *
  * @param rcc_base RCC base address
  * @param pwr_base PWR base address
@@ -136,6 +531,16 @@ uint32_t stm32_get_sysclk_freq(uintptr_t rcc_base, uint32_t hsi_value);
  */
 int stm32_enable_overdrive(uintptr_t rcc_base, uintptr_t pwr_base, uint32_t timeout);
 
+/**
+ * @brief Read the ARM DWT cycle counter, enabling it on first use.
+ *
+ * The counter is never reset, so differences of two readings stay valid
+ * across wrap-around and across stm32_delay_cycles_dwt().
+ *
+ * @return uint32_t Core cycles counted by DWT CYCCNT
+ */
+uint32_t stm32_cycle_count(void);
+
 /**
  * @brief Delay for a target number of CPU cycles using ARM DWT CYCCNT.
  *
@@ -150,4 +555,50 @@ int stm32_enable_overdrive(uintptr_t rcc_base, uintptr_t pwr_base, uint32_t time
  */
 int stm32_delay_cycles_dwt(uint64_t target_cycles, uint64_t *elapsed_cycles);
 
+/**
+ * @brief Hooks of a port that does not run on the hardware (simulation)
+ * 
+ * Every hook is optional; the hardware ports leave the whole table out.
+ */
+typedef struct {
+    void (*init)(void);                                     /* Called from dmod_init() before the clock is read */
+    void (*apply_plan)(const dmclk_port_plan_t *plan);      /* Called before a plan is applied */
+    void (*enter_stop)(void);                               /* Replaces stm32_enter_stop() */
+    void (*delay_us)(dmclk_time_us_t time_us);              /* Replaces the delay loop */
+    uint64_t (*delay)(uint32_t seconds, uint32_t hclk);     /* Replaces the cycle counted busy-wait */
+    void (*pend_rcc_irq)(void);                             /* Replaces setting RCC_IRQ_NUMBER pending in the NVIC */
+    uint32_t (*cycle_count)(void);                          /* Replaces stm32_cycle_count() */
+} stm32_port_hooks_t;
+
+/**
+ * @brief STM32 family descriptor
+ * 
+ * Everything the common port (stm32_port.c) needs to know about a family.
+ * Each family port only defines stm32_family. The PLLCFGR, CFGR and PWR field
+ * layouts are shared by all supported families (stm32_common_regs.h); the
+ * Over-Drive threshold and the regulator scaling values are part of the limits.
+ */
+typedef struct {
+    const char *name;                   /* Family name used in log messages */
+    uintptr_t rcc_base;
+    uintptr_t flash_base;
+    uintptr_t pwr_base;
+    uintptr_t gpioa_base;               /* MCO1 pin (PA8) */
+    uintptr_t gpioc_base;               /* MCO2 pin (PC9) */
+    clock_limits_t limits;
+    const stm32_port_hooks_t *hooks;    /* NULL on the hardware */
+} stm32_family_t;
+
+/**
+ * @brief Descriptor of the family the port is built for, defined by the family port
+ */
+extern const stm32_family_t stm32_family;
+
+/**
+ * @brief Forget the applied plan and the peripheral clocks and return the common port to the reset clock (HSI)
+ * 
+ * For ports that can reset the clock hardware (simulation).
+ */
+void stm32_port_reset(void);
+
 #endif // STM32_COMMON_H
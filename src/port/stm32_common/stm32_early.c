@@ -0,0 +1,43 @@
+#include "dmclk_early.h"
+#include "stm32_common.h"
+#include "port/stm32_common_regs.h"
+
+/*
+ * Early clock bring-up
+ *
+ * Linked into the boot code with the dmclk_early library, outside of the DMOD
+ * module, so nothing here may depend on the state kept by stm32_port.c or on
+ * DMOD symbols (no logging, no Dmod_EnterCritical) - the module adopts the
+ * result once it is loaded.
+ */
+
+/**
+ * @brief Apply a baked plan before the modules are loaded
+ *
+ * @param plan Plan to apply
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+int dmclk_early_init(const dmclk_port_plan_t* plan)
+{
+    dmclk_clock_tree_t tree;
+    uint32_t current_hclk = HSI_VALUE;
+
+    if (plan == NULL) {
+        return -1;
+    }
+    if (stm32_plan_is_active(stm32_family.rcc_base, stm32_family.flash_base, stm32_family.pwr_base, plan)) {
+        return 0;
+    }
+
+    /* The simulation takes the crystal of the modelled board from the plan */
+    if (stm32_family.hooks != NULL && stm32_family.hooks->apply_plan != NULL) {
+        stm32_family.hooks->apply_plan(plan);
+    }
+
+    /* Normally the reset clock, but a bootloader may have changed it already */
+    if (stm32_get_clock_tree(stm32_family.rcc_base, HSI_VALUE, STM32_PLAN_CONST(plan)->hse_freq, &tree) == 0) {
+        current_hclk = (uint32_t)tree.hclk;
+    }
+    return stm32_apply_plan(stm32_family.rcc_base, stm32_family.flash_base, stm32_family.pwr_base, current_hclk, plan);
+}
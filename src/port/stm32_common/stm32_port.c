@@ -0,0 +1,768 @@
+#define DMOD_ENABLE_REGISTRATION    ON
+#include "dmclk_port.h"
+#include "stm32_common.h"
+#include "port/stm32_common_regs.h"
+
+/*
+ * Common STM32 port
+ *
+ * Implements the dmclk port API for every STM32 family on top of the planner
+ * and executor in stm32_common.c. The family port only provides stm32_family
+ * (base addresses, limits and, for the simulation, hooks).
+ */
+
+/* Static storage for current oscillator frequency */
+static uint32_t current_hse_freq = 0;
+static uint32_t current_hclk = HSI_VALUE;     /* Core clock, used by the delay loops */
+
+/* Clock state shared with hot paths and ISRs, see dmclk_port_get_shared() */
+static dmclk_shared_t shared_clock;
+
+/* Plan applied last, restored after STOP mode */
+static dmclk_port_plan_t active_plan;
+static int active_plan_valid = 0;
+
+/* Clocks requested from PLLI2S and PLLSAI, solved into every plan */
+static dmclk_peripheral_clocks_t peripheral_clocks;
+
+/* Receiver of asynchronous events (HSE failure) */
+static dmclk_port_event_callback_t event_callback = NULL;
+static void *event_user_data = NULL;
+
+/* Plan started by dmclk_port_apply_plan_async(), finished by dmclk_port_advance_async() */
+#define PLAN_NONE       0
+#define PLAN_WAITING    1   /* HSE / PLL not ready yet */
+#define PLAN_FAILED     2   /* Stopped by an HSE failure, reported by the next advance */
+static dmclk_port_plan_t pending_plan;
+static volatile int pending_state = PLAN_NONE;
+static uint32_t pending_cycles;         /* Cycle count up to which the waiting time was accounted */
+static uint32_t pending_elapsed_ms;
+
+/* Clock Security System event: acknowledged by the NMI, reported by the RCC
+ * interrupt, recovered from by dmclk_port_css_recover() in task context */
+#define CSS_IDLE        0
+#define CSS_DETECTED    1
+#define CSS_REPORTED    2
+static volatile int css_state = CSS_IDLE;
+
+#define FAMILY_HOOK(name)   ((stm32_family.hooks != NULL) ? stm32_family.hooks->name : NULL)
+
+/**
+ * @brief Capture the clock tree after a transition and publish it in the shared block
+ *
+ * Also called from the RCC interrupt. Readers may run in interrupt handlers on
+ * this core - they must never preempt a half-written block or they would spin
+ * forever, so the update runs with interrupts disabled (see dmclk_shared_read()).
+ * Kept out of stm32_common.c, which the dmclk_early library links without DMOD.
+ */
+static void update_shared_clock(void)
+{
+    dmclk_clock_tree_t tree;
+    if (stm32_get_clock_tree(stm32_family.rcc_base, HSI_VALUE, current_hse_freq, &tree) == 0) {
+        Dmod_EnterCritical();
+        current_hclk = (uint32_t)tree.hclk;
+        shared_clock.sequence++;
+        __sync_synchronize();
+        shared_clock.tree = tree;
+        shared_clock.generation++;
+        __sync_synchronize();
+        shared_clock.sequence++;
+        Dmod_ExitCritical();
+    }
+}
+
+/**
+ * @brief Set the RCC interrupt pending, so the work of the NMI continues at its priority
+ */
+static void pend_rcc_irq(void)
+{
+    void (*pend_hook)(void) = FAMILY_HOOK(pend_rcc_irq);
+
+    if (pend_hook != NULL) {
+        pend_hook();
+        return;
+    }
+    *(volatile uint32_t *)(NVIC_ISPR_BASE + 4U * (RCC_IRQ_NUMBER / 32U)) = 1UL << (RCC_IRQ_NUMBER % 32U);
+}
+
+/**
+ * @brief Forget the applied plan and return to the reset clock (HSI)
+ */
+void stm32_port_reset(void)
+{
+    current_hse_freq = 0;
+    current_hclk = HSI_VALUE;
+    active_plan_valid = 0;
+    pending_state = PLAN_NONE;
+    css_state = CSS_IDLE;
+    peripheral_clocks = (dmclk_peripheral_clocks_t){ 0 };
+}
+
+/**
+ * @brief Report an asynchronous event to the registered receiver
+ */
+static void report_event(dmclk_port_event_t event)
+{
+    if (event_callback != NULL) {
+        event_callback(event, event_user_data);
+    }
+}
+
+/**
+ * @brief Initialize the DMDRVI module
+ *
+ * @param Config Pointer to Dmod_Config_t structure with configuration parameters
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+int dmod_init(const Dmod_Config_t *Config)
+{
+    void (*init)(void) = FAMILY_HOOK(init);
+
+    Dmod_Printf("DMDRVI interface module initialized (%s)\n", stm32_family.name);
+    if (init != NULL) {
+        init();
+    }
+    update_shared_clock();
+    return 0;
+}
+
+/**
+ * @brief Deinitialize the DMDRVI module
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+int dmod_deinit(void)
+{
+    Dmod_Printf("DMDRVI interface module deinitialized (%s)\n", stm32_family.name);
+    return 0;
+}
+
+/**
+ * @brief Calculate a plan for the internal clock source (HSI divided or HSI + PLL)
+ *
+ * @param target_freq Target frequency in Hz
+ * @param tolerance Tolerance in Hz
+ * @param bus_policy Peripheral bus policy
+ * @param plan Output plan
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _plan_internal, ( dmclk_frequency_t target_freq, dmclk_frequency_t tolerance, dmclk_bus_policy_t bus_policy, dmclk_port_plan_t* plan ) )
+{
+    return stm32_plan_clock(target_freq, tolerance, 0, &stm32_family.limits, bus_policy, &peripheral_clocks, plan);
+}
+
+/**
+ * @brief Calculate a plan for the external clock source (HSE divided or HSE + PLL)
+ *
+ * @param target_freq Target frequency in Hz
+ * @param tolerance Tolerance in Hz
+ * @param oscillator_freq Oscillator frequency in Hz
+ * @param bus_policy Peripheral bus policy
+ * @param plan Output plan
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _plan_external, ( dmclk_frequency_t target_freq, dmclk_frequency_t tolerance, dmclk_frequency_t oscillator_freq, dmclk_bus_policy_t bus_policy, dmclk_port_plan_t* plan ) )
+{
+    if (oscillator_freq == 0) {
+        return -1;
+    }
+    return stm32_plan_clock(target_freq, tolerance, (uint32_t)oscillator_freq, &stm32_family.limits, bus_policy, &peripheral_clocks, plan);
+}
+
+/**
+ * @brief Calculate a low-power plan (HSI or HSE divided down, PLL off, low VOS)
+ *
+ * @param target_freq Target frequency in Hz
+ * @param tolerance Tolerance in Hz
+ * @param oscillator_freq Oscillator frequency in Hz, 0 to use only HSI
+ * @param plan Output plan
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _plan_hibernation, ( dmclk_frequency_t target_freq, dmclk_frequency_t tolerance, dmclk_frequency_t oscillator_freq, dmclk_port_plan_t* plan ) )
+{
+    return stm32_plan_low_power(target_freq, tolerance, (uint32_t)oscillator_freq, &stm32_family.limits, plan);
+}
+
+/**
+ * @brief Set the clocks requested from PLLI2S and PLLSAI
+ *
+ * Only parts sharing PLLM between the main PLL and the dedicated PLLs
+ * (STM32F42x/F43x/F469/F479 and all STM32F7 parts) are supported - do not
+ * request clocks from PLLs the part does not have.
+ *
+ * @param clocks Requested clocks, NULL to stop using the dedicated PLLs
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _set_peripheral_clocks, ( const dmclk_peripheral_clocks_t* clocks ) )
+{
+    static const dmclk_peripheral_clocks_t none = { 0 };
+
+    peripheral_clocks = (clocks != NULL) ? *clocks : none;
+    return 0;
+}
+
+/**
+ * @brief Route a clock to MCO1 (PA8) or MCO2 (PC9)
+ *
+ * @param output 1 for MCO1, 2 for MCO2
+ * @param source Clock to output
+ * @param divider Output divider, 1 to 5
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _configure_mco, ( uint32_t output, dmclk_mco_source_t source, uint32_t divider ) )
+{
+    uintptr_t gpio_base = (output == 1U) ? stm32_family.gpioa_base : stm32_family.gpioc_base;
+
+    /* RCC_CFGR is read-modify-written, also by the SYSCLK switch of other plans */
+    Dmod_EnterCritical();
+    int ret = stm32_configure_mco(stm32_family.rcc_base, gpio_base, output, source, divider);
+    Dmod_ExitCritical();
+    return ret;
+}
+
+/**
+ * @brief Apply a precomputed plan
+ *
+ * Plans above the Over-Drive threshold of the family carry the Over-Drive flag,
+ * which makes the common code enable Over-Drive before SYSCLK is switched.
+ *
+ * @param plan Plan to apply
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _apply_plan, ( const dmclk_port_plan_t* plan ) )
+{
+    void (*apply_hook)(const dmclk_port_plan_t *) = FAMILY_HOOK(apply_plan);
+
+    /* The pending asynchronous switch owns the oscillator and PLL */
+    if (plan == NULL || pending_state != PLAN_NONE) {
+        return -1;
+    }
+
+    if (apply_hook != NULL) {
+        apply_hook(plan);
+    }
+
+    if (stm32_apply_plan(stm32_family.rcc_base, stm32_family.flash_base, stm32_family.pwr_base, current_hclk, plan) != 0) {
+        /* A PLL that did not relock or a switch that timed out leaves SYSCLK
+         * on HSI or the new oscillator - the plan applied last is gone then,
+         * and neither STOP mode nor the next plan may start from it */
+        if (STM32_PLAN_CONST(plan)->flags & STM32_PLAN_HSE) {
+            current_hse_freq = STM32_PLAN_CONST(plan)->hse_freq;
+        }
+        if (active_plan_valid
+         && !stm32_plan_is_active(stm32_family.rcc_base, stm32_family.flash_base, stm32_family.pwr_base, &active_plan)) {
+            active_plan_valid = 0;
+        }
+        update_shared_clock();
+        return -1;
+    }
+
+    current_hse_freq = STM32_PLAN_CONST(plan)->hse_freq;
+    active_plan = *plan;
+    active_plan_valid = 1;
+    update_shared_clock();
+    return 0;
+}
+
+/**
+ * @brief Take over a plan that is already running
+ *
+ * @param plan Plan expected to be running
+ *
+ * @return int 0 if the plan was adopted, non-zero if the hardware runs something else
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _adopt_plan, ( const dmclk_port_plan_t* plan ) )
+{
+    if (plan == NULL
+     || !stm32_plan_is_active(stm32_family.rcc_base, stm32_family.flash_base, stm32_family.pwr_base, plan)) {
+        return -1;
+    }
+
+    /* Whoever started HSE may not have armed the Clock Security System */
+    if (STM32_PLAN_CONST(plan)->flags & STM32_PLAN_HSE) {
+        volatile RCC_TypeDef *RCC = (RCC_TypeDef *)stm32_family.rcc_base;
+        STM32_REG_SET(RCC->CR, RCC_CR_CSSON);
+    }
+
+    current_hse_freq = STM32_PLAN_CONST(plan)->hse_freq;
+    active_plan = *plan;
+    active_plan_valid = 1;
+    update_shared_clock();
+    return 0;
+}
+
+/**
+ * @brief Decode the running clock configuration into a plan
+ *
+ * @param request Plan solved for the configuration
+ * @param plan Decoded plan, plan->frequency is the running HCLK
+ *
+ * @return int 0 if the running configuration is equivalent to the request, non-zero otherwise
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _read_active_plan, ( const dmclk_port_plan_t* request, dmclk_port_plan_t* plan ) )
+{
+    return stm32_read_plan(stm32_family.rcc_base, stm32_family.flash_base, stm32_family.pwr_base,
+                           &stm32_family.limits, request, plan);
+}
+
+/**
+ * @brief Configure internal clock source (HSI divided or HSI + PLL)
+ *
+ * @param target_freq Target frequency in Hz
+ * @param tolerance Tolerance in Hz
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _configure_internal, ( dmclk_frequency_t target_freq, dmclk_frequency_t tolerance) )
+{
+    dmclk_port_plan_t plan;
+
+    if (dmclk_port_plan_internal(target_freq, tolerance, dmclk_bus_policy_performance, &plan) != 0) {
+        return -1;
+    }
+
+    return dmclk_port_apply_plan(&plan);
+}
+
+/**
+ * @brief Configure external clock source (HSE divided or HSE + PLL)
+ *
+ * @param target_freq Target frequency in Hz
+ * @param tolerance Tolerance in Hz
+ * @param oscillator_freq Oscillator frequency in Hz
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _configure_external, ( dmclk_frequency_t target_freq, dmclk_frequency_t tolerance, dmclk_frequency_t oscillator_freq) )
+{
+    dmclk_port_plan_t plan;
+
+    if (dmclk_port_plan_external(target_freq, tolerance, oscillator_freq, dmclk_bus_policy_performance, &plan) != 0) {
+        return -1;
+    }
+
+    return dmclk_port_apply_plan(&plan);
+}
+
+/**
+ * @brief Configure hibernation clock source (HSI or HSE without PLL)
+ *
+ * @param target_freq Target frequency in Hz
+ * @param tolerance Tolerance in Hz
+ * @param oscillator_freq Oscillator frequency in Hz, 0 to use only HSI
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _configure_hibernatation, ( dmclk_frequency_t target_freq, dmclk_frequency_t tolerance, dmclk_frequency_t oscillator_freq) )
+{
+    dmclk_port_plan_t plan;
+
+    if (dmclk_port_plan_hibernation(target_freq, tolerance, oscillator_freq, &plan) != 0) {
+        return -1;
+    }
+
+    return dmclk_port_apply_plan(&plan);
+}
+
+/**
+ * @brief Delay for a specified time in microseconds
+ *
+ * @param time_us Time to delay in microseconds
+ */
+dmod_dmclk_port_api_declaration(1.0, void, _delay_us, ( dmclk_time_us_t time_us) )
+{
+    void (*delay_hook)(dmclk_time_us_t) = FAMILY_HOOK(delay_us);
+
+    if (delay_hook != NULL) {
+        delay_hook(time_us);
+        return;
+    }
+
+    /* Simple delay loop
+     * This is a very basic implementation - cycles depend on sysclk
+     * For accurate timing, would need to use SysTick or a timer
+     */
+    uint32_t cycles_per_us = current_hclk / 1000000U;
+    uint32_t cycles = (uint32_t)(time_us * cycles_per_us);
+
+    /* Each loop iteration takes approximately 4 cycles */
+    cycles /= 4U;
+
+    for (uint32_t i = 0; i < cycles; i++) {
+        __asm__ volatile ("nop");
+    }
+}
+
+/* Fallback for targets where DWT CYCCNT is unavailable */
+#define DELAY_CYCLES_PER_ITERATION      2U
+
+/**
+ * @brief Busy-wait delay using cycle-accurate hardware counting inside a critical section.
+ *
+ * The function prefers ARM DWT CYCCNT and accumulates elapsed cycles,
+ * including wrap-around handling, until the target cycle budget is reached.
+ * If CYCCNT is unavailable, it falls back to a counted ASM loop.
+ *
+ * @param seconds Number of seconds to busy-wait
+ * @return uint64_t Total number of CPU cycles consumed by the busy-wait loop
+ */
+dmod_dmclk_port_api_declaration(1.0, uint64_t, _delay, ( uint32_t seconds ) )
+{
+    uint64_t (*delay_hook)(uint32_t, uint32_t) = FAMILY_HOOK(delay);
+    uint64_t target_cycles = (uint64_t)current_hclk * (uint64_t)seconds;
+
+    if (delay_hook != NULL) {
+        return delay_hook(seconds, current_hclk);
+    }
+
+    if (target_cycles == 0U) {
+        return 0U;
+    }
+
+    Dmod_EnterCritical();
+
+    uint64_t elapsed = 0U;
+    if (stm32_delay_cycles_dwt(target_cycles, &elapsed) == 0) {
+        Dmod_ExitCritical();
+        return elapsed;
+    }
+
+    /* Fallback path: deterministic ASM loop with assumed 2 cycles/iteration */
+    uint32_t iterations_per_second = current_hclk / DELAY_CYCLES_PER_ITERATION;
+    uint64_t total_iterations = 0;
+
+    for (uint32_t s = 0; s < seconds; s++) {
+#if defined(__arm__)
+        uint32_t count = iterations_per_second;
+        /* ARM Cortex-M: SUBS + BNE = exactly 2 cycles per iteration */
+        __asm__ volatile (
+            "1: subs %0, %0, #1\n\t"
+            "   bne  1b\n\t"
+            : "+r" (count)
+            :
+            : "cc"
+        );
+#endif
+        total_iterations += iterations_per_second;
+    }
+
+    Dmod_ExitCritical();
+
+    return total_iterations * DELAY_CYCLES_PER_ITERATION;
+}
+
+/**
+ * @brief Get the current clock frequency
+ *
+ * Served from the shared clock state, so no RCC decoding is done on this path.
+ *
+ * @return dmclk_frequency_t Current core clock (HCLK) frequency in Hz
+ */
+dmod_dmclk_port_api_declaration(1.0, dmclk_frequency_t, _get_current_frequency, ( void ) )
+{
+    dmclk_clock_tree_t tree;
+    dmclk_shared_read(&shared_clock, &tree);
+    return tree.hclk;
+}
+
+/**
+ * @brief Get the complete clock tree
+ *
+ * @param tree Output clock tree
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _get_clock_tree, ( dmclk_clock_tree_t* tree ) )
+{
+    return stm32_get_clock_tree(stm32_family.rcc_base, HSI_VALUE, current_hse_freq, tree);
+}
+
+/**
+ * @brief Get the shared clock state block
+ *
+ * @return const dmclk_shared_t* Shared clock state
+ */
+dmod_dmclk_port_api_declaration(1.0, const dmclk_shared_t*, _get_shared, ( void ) )
+{
+    return &shared_clock;
+}
+
+/**
+ * @brief Enter STOP mode and restore the active plan after wakeup
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _enter_stop, ( void ) )
+{
+    void (*stop_hook)(void) = FAMILY_HOOK(enter_stop);
+
+    Dmod_EnterCritical();
+    if (stop_hook != NULL) {
+        stop_hook();
+    } else {
+        stm32_enter_stop(stm32_family.rcc_base, stm32_family.pwr_base);
+    }
+    int ret = (active_plan_valid) ? stm32_resume_plan(stm32_family.rcc_base, stm32_family.pwr_base, &active_plan) : 0;
+    Dmod_ExitCritical();
+
+    if (ret != 0) {
+        /* Still running from HSI - let the shared state tell the truth */
+        update_shared_clock();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Restore the plan that was active before STOP mode
+ *
+ * @return int 0 on success, non-zero on failure
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _exit_stop, ( void ) )
+{
+    if (!active_plan_valid) {
+        return 0;
+    }
+    if (stm32_resume_plan(stm32_family.rcc_base, stm32_family.pwr_base, &active_plan) != 0) {
+        /* Still running from HSI - let the shared state tell the truth */
+        update_shared_clock();
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Register the callback receiving asynchronous port events
+ *
+ * @param callback Callback, NULL to unregister
+ * @param user_data User pointer passed to the callback
+ */
+dmod_dmclk_port_api_declaration(1.0, void, _set_event_callback, ( dmclk_port_event_callback_t callback, void* user_data ) )
+{
+    Dmod_EnterCritical();
+    event_callback = callback;
+    event_user_data = user_data;
+    Dmod_ExitCritical();
+}
+
+/**
+ * @brief Clock Security System handler - call it from NMI_Handler
+ *
+ * The NMI is not masked by the critical sections of the port, so it may land in
+ * the middle of a plan being applied. It only acknowledges the event and pends
+ * the RCC interrupt, which reports it - see report_css_event().
+ */
+dmod_dmclk_port_api_declaration(1.0, void, _css_irq_handler, ( void ) )
+{
+    if (stm32_css_acknowledge(stm32_family.rcc_base) != 0) {
+        return;
+    }
+    css_state = CSS_DETECTED;
+    pend_rcc_irq();
+}
+
+/**
+ * @brief Report a CSS event acknowledged by the NMI - runs in the RCC interrupt
+ */
+static void report_css_event(void)
+{
+    if (css_state != CSS_DETECTED) {
+        return;
+    }
+    css_state = CSS_REPORTED;
+
+    /* HSE and the PLL were stopped by the hardware - a pending switch cannot complete */
+    if (pending_state == PLAN_WAITING) {
+        stm32_cancel_prepare(stm32_family.rcc_base);
+        pending_state = PLAN_FAILED;
+    }
+
+    current_hse_freq = 0;
+    update_shared_clock();
+
+    report_event(dmclk_port_event_hse_failure);
+}
+
+/**
+ * @brief Move to an HSI plan near the lost frequency after an HSE failure
+ *
+ * Runs in task context, serialized with the other plan changes by the caller.
+ *
+ * @return int 0 if an HSI plan was applied, 1 if the core stays on plain HSI,
+ *             -1 if no HSE failure is pending
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _css_recover, ( void ) )
+{
+    dmclk_port_plan_t plan;
+    const dmclk_port_plan_t *failed_plan = NULL;
+
+    Dmod_EnterCritical();
+    int detected = (css_state != CSS_IDLE);
+    css_state = CSS_IDLE;
+    Dmod_ExitCritical();
+    if (!detected) {
+        return -1;
+    }
+
+    if (active_plan_valid && (STM32_PLAN_CONST(&active_plan)->flags & STM32_PLAN_HSE)) {
+        failed_plan = &active_plan;
+    }
+
+    int ret = stm32_css_recover(stm32_family.rcc_base, stm32_family.flash_base, stm32_family.pwr_base,
+                                &stm32_family.limits, &peripheral_clocks, failed_plan, &plan);
+    current_hse_freq = 0;
+    if (ret == 0) {
+        active_plan = plan;
+    } else {
+        active_plan_valid = 0;
+    }
+    update_shared_clock();
+    return ret;
+}
+
+/**
+ * @brief Read the cycle counter timing the pending switch
+ */
+static uint32_t read_cycle_count(void)
+{
+    uint32_t (*cycle_count_hook)(void) = FAMILY_HOOK(cycle_count);
+    return (cycle_count_hook != NULL) ? cycle_count_hook() : stm32_cycle_count();
+}
+
+/**
+ * @brief Account the time waited for the pending switch since the last call
+ *
+ * Only whole milliseconds at the current HCLK are taken from the counter, so
+ * frequent calls and the HSI phase of a PLL relock are accounted correctly.
+ *
+ * @return int 1 once the switch waited longer than ASYNC_STARTUP_TIMEOUT_MS
+ */
+static int pending_deadline_passed(void)
+{
+    uint32_t cycles_per_ms = (current_hclk >= 1000U) ? current_hclk / 1000U : 1U;
+    uint32_t elapsed_ms = (read_cycle_count() - pending_cycles) / cycles_per_ms;
+
+    pending_cycles += elapsed_ms * cycles_per_ms;
+    pending_elapsed_ms += elapsed_ms;
+    return pending_elapsed_ms >= ASYNC_STARTUP_TIMEOUT_MS;
+}
+
+/**
+ * @brief Apply a plan without waiting for HSE and the main PLL
+ *
+ * Starts HSE and the PLL with their ready interrupts enabled and returns. The
+ * switch is finished by dmclk_port_advance_async(), never from here.
+ *
+ * @param plan Plan to apply
+ *
+ * @return int 0 if the switch was started, non-zero if another one is pending
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _apply_plan_async, ( const dmclk_port_plan_t* plan ) )
+{
+    if (plan == NULL) {
+        return -1;
+    }
+
+    Dmod_EnterCritical();
+    if (pending_state != PLAN_NONE) {
+        Dmod_ExitCritical();
+        return -1;
+    }
+    pending_plan = *plan;
+    pending_cycles = read_cycle_count();
+    pending_elapsed_ms = 0;
+    int ret = stm32_prepare_plan(stm32_family.rcc_base, stm32_family.pwr_base, &pending_plan);
+    pending_state = (ret < 0) ? PLAN_FAILED : PLAN_WAITING;
+    Dmod_ExitCritical();
+
+    /* SYSCLK may have moved to HSI while the PLL relocks */
+    update_shared_clock();
+    return 0;
+}
+
+/**
+ * @brief Continue the pending asynchronous switch and finish it once HSE and the PLL run
+ *
+ * Runs in task context. The rest of the switch - Over-Drive, PLLI2S / PLLSAI
+ * and the SYSCLK switch - is applied synchronously by dmclk_port_apply_plan().
+ *
+ * @return int 1 while waiting, 0 if the plan was applied, -1 if it failed or none is pending
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _advance_async, ( void ) )
+{
+    dmclk_port_plan_t plan;
+    int ret = -1;
+
+    /* The RCC interrupt stops a waiting switch on an HSE failure */
+    Dmod_EnterCritical();
+    if (pending_state == PLAN_NONE) {
+        Dmod_ExitCritical();
+        return -1;
+    }
+    if (pending_state == PLAN_WAITING) {
+        ret = stm32_prepare_plan(stm32_family.rcc_base, stm32_family.pwr_base, &pending_plan);
+        if (ret > 0 && pending_deadline_passed()) {
+            ret = -1;
+        }
+    }
+    if (ret > 0) {
+        Dmod_ExitCritical();
+        update_shared_clock();
+        return 1;
+    }
+    plan = pending_plan;
+    pending_state = PLAN_NONE;
+    Dmod_ExitCritical();
+
+    if (ret == 0 && dmclk_port_apply_plan(&plan) == 0) {
+        return 0;
+    }
+    stm32_cancel_prepare(stm32_family.rcc_base);
+    update_shared_clock();
+    return -1;
+}
+
+/**
+ * @brief Abandon the pending asynchronous switch
+ *
+ * @return int 0 if a switch was abandoned, non-zero if none was pending
+ */
+dmod_dmclk_port_api_declaration(1.0, int, _cancel_async, ( void ) )
+{
+    Dmod_EnterCritical();
+    int pending = (pending_state != PLAN_NONE);
+    if (pending) {
+        stm32_cancel_prepare(stm32_family.rcc_base);
+        pending_state = PLAN_NONE;
+    }
+    Dmod_ExitCritical();
+
+    if (!pending) {
+        return -1;
+    }
+    update_shared_clock();
+    return 0;
+}
+
+/**
+ * @brief RCC interrupt handler - call it from RCC_IRQHandler
+ *
+ * Acknowledges the HSE / PLL ready interrupts, which only wake the application
+ * to call dmclk_port_advance_async(), and reports the CSS events handed over by
+ * the NMI.
+ */
+dmod_dmclk_port_api_declaration(1.0, void, _rcc_irq_handler, ( void ) )
+{
+    volatile RCC_TypeDef *RCC = (RCC_TypeDef *)stm32_family.rcc_base;
+
+    /* A flag left set would retrigger the interrupt */
+    STM32_REG_SET(RCC->CIR, RCC_CIR_HSERDYC | RCC_CIR_PLLRDYC);
+    report_css_event();
+}
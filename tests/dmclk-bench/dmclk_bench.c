@@ -0,0 +1,445 @@
+#include <dmod.h>
+#include "dmdrvi.h"
+#include "dmini.h"
+#include "dmclk.h"
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * @brief dmclk_bench – switch latency and API overhead measurement application.
+ *
+ * Usage:
+ *   dmclk_bench <oscillator_hz> [iterations] [source:frequency ...]
+ *
+ * The application creates a dmclk device with one operating point per
+ * source:frequency pair (default internal:16000000, external:48000000 and
+ * external:84000000) and, at each of them, measures with the DWT cycle
+ * counter:
+ *   - every ioctl command that does not change the clock,
+ *   - dmclk_port_get_current_frequency(),
+ *   - a full configure() (solve and apply) through set_target_frequency,
+ *   - an operating point switch from the previous point (precomputed plan),
+ *   - solving a plan and applying it (PLL relock for PLL plans),
+ *   - a prescaler-only change (same SYSCLK, other bus policy).
+ *
+ * Every benchmark runs the given number of iterations (default 100) and
+ * prints one line: point,benchmark,iterations,min,avg,max,p99 in CPU cycles.
+ * Cycles are core clock cycles, so a transition is counted partly at the old
+ * and partly at the new clock.
+ */
+
+#define BENCH_DEFAULT_ITERATIONS    100U
+#define BENCH_MAX_SAMPLES           256U
+#define BENCH_MAX_POINTS            DMCLK_MAX_OPPS
+#define BENCH_TOLERANCE             1000U
+#define BENCH_CONFIG_SIZE           1024U
+
+/* ARM Cortex-M debug registers (DWT cycle counter) */
+#define BENCH_DEMCR                 (*(volatile uint32_t *)0xE000EDFCUL)
+#define BENCH_DWT_CTRL              (*(volatile uint32_t *)0xE0001000UL)
+#define BENCH_DWT_CYCCNT            (*(volatile uint32_t *)0xE0001004UL)
+#define BENCH_DWT_LAR               (*(volatile uint32_t *)0xE0001FB0UL)
+#define BENCH_DEMCR_TRCENA          (1UL << 24)
+#define BENCH_DWT_CTRL_CYCCNTENA    (1UL << 0)
+#define BENCH_DWT_LAR_KEY           0xC5ACCE55UL
+
+typedef struct
+{
+    dmclk_source_t source;
+    dmclk_frequency_t frequency;
+} bench_point_t;
+
+typedef struct
+{
+    dmdrvi_context_t context;
+    void* handle;
+    uint32_t iterations;
+    uint32_t point;
+    dmclk_frequency_t oscillator;
+} bench_t;
+
+/* Samples of the running benchmark - static to keep them off the stack */
+static uint32_t bench_samples[BENCH_MAX_SAMPLES];
+static uint32_t bench_sample_count;
+
+static int bench_notifier(dmclk_notify_event_t event, const dmclk_notify_data_t* data, void* user_data)
+{
+    return 0;
+}
+
+/**
+ * @brief Start the DWT cycle counter
+ *
+ * @return int 0 on success, -1 when the counter does not run
+ */
+static int bench_start_counter(void)
+{
+    BENCH_DEMCR |= BENCH_DEMCR_TRCENA;
+    BENCH_DWT_LAR = BENCH_DWT_LAR_KEY;      /* Cortex-M7 locks the DWT after reset */
+    BENCH_DWT_CYCCNT = 0;
+    BENCH_DWT_CTRL |= BENCH_DWT_CTRL_CYCCNTENA;
+
+    uint32_t start = BENCH_DWT_CYCCNT;
+    for (volatile uint32_t i = 0; i < 100U; i++)
+    {
+    }
+    return (BENCH_DWT_CYCCNT != start) ? 0 : -1;
+}
+
+static void bench_add(uint32_t cycles)
+{
+    if (bench_sample_count < BENCH_MAX_SAMPLES)
+    {
+        bench_samples[bench_sample_count++] = cycles;
+    }
+}
+
+/**
+ * @brief Print min/avg/max/p99 of the collected samples and reset them
+ */
+static void bench_report(const bench_t* bench, const char* name)
+{
+    uint32_t count = bench_sample_count;
+    bench_sample_count = 0;
+    if (count == 0)
+    {
+        Dmod_Printf("%u,%s,0,-,-,-,-\n", (unsigned int)bench->point, name);
+        return;
+    }
+
+    /* Insertion sort - the sample count is small */
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t value = bench_samples[i];
+        uint32_t j = i;
+        while (j > 0 && bench_samples[j - 1] > value)
+        {
+            bench_samples[j] = bench_samples[j - 1];
+            j--;
+        }
+        bench_samples[j] = value;
+        sum += value;
+    }
+
+    uint32_t p99 = bench_samples[((count * 99U) + 99U) / 100U - 1U];
+    Dmod_Printf("%u,%s,%u,%u,%u,%u,%u\n", (unsigned int)bench->point, name, (unsigned int)count,
+                (unsigned int)bench_samples[0], (unsigned int)(sum / count),
+                (unsigned int)bench_samples[count - 1], (unsigned int)p99);
+}
+
+/**
+ * @brief Measure an ioctl command, optionally undoing it (unmeasured) after each call
+ */
+static void bench_ioctl(const bench_t* bench, const char* name, int command, void* arg, int undo_command, void* undo_arg)
+{
+    for (uint32_t i = 0; i < bench->iterations; i++)
+    {
+        uint32_t start = BENCH_DWT_CYCCNT;
+        int ret = dmclk_dmdrvi_ioctl(bench->context, bench->handle, command, arg);
+        uint32_t cycles = BENCH_DWT_CYCCNT - start;
+        if (ret != 0)
+        {
+            Dmod_Printf("# %s failed: %d\n", name, ret);
+            bench_sample_count = 0;
+            break;
+        }
+        bench_add(cycles);
+        if (undo_command != 0)
+        {
+            dmclk_dmdrvi_ioctl(bench->context, bench->handle, undo_command, undo_arg);
+        }
+    }
+    bench_report(bench, name);
+}
+
+/**
+ * @brief Measure the ioctl commands that leave the clock alone
+ */
+static void bench_api(const bench_t* bench)
+{
+    dmclk_frequency_t frequency;
+    dmclk_source_t source;
+    dmclk_clock_tree_t tree;
+    const dmclk_shared_t* shared;
+    dmclk_governor_t governor = dmclk_governor_none;
+    uint32_t value;
+    dmclk_qos_limits_t limits;
+    dmclk_mco_config_t mco = { .output = 2 };
+    dmclk_load_sample_t sample = { .busy_us = 500, .period_us = 1000 };
+    dmclk_notifier_t notifier = { .callback = bench_notifier };
+
+    bench_ioctl(bench, "ioctl.get_frequency", dmclk_ioctl_cmd_get_frequency, &frequency, 0, NULL);
+    bench_ioctl(bench, "ioctl.get_source", dmclk_ioctl_cmd_get_source, &source, 0, NULL);
+    bench_ioctl(bench, "ioctl.get_tolerance", dmclk_ioctl_cmd_get_tolerance, &frequency, 0, NULL);
+    bench_ioctl(bench, "ioctl.get_oscillator_frequency", dmclk_ioctl_cmd_get_oscillator_frequency, &frequency, 0, NULL);
+    bench_ioctl(bench, "ioctl.get_target_frequency", dmclk_ioctl_cmd_get_target_frequency, &frequency, 0, NULL);
+    bench_ioctl(bench, "ioctl.get_clock_tree", dmclk_ioctl_cmd_get_clock_tree, &tree, 0, NULL);
+    bench_ioctl(bench, "ioctl.get_shared", dmclk_ioctl_cmd_get_shared, &shared, 0, NULL);
+    bench_ioctl(bench, "ioctl.get_governor", dmclk_ioctl_cmd_get_governor, &governor, 0, NULL);
+    bench_ioctl(bench, "ioctl.get_opp", dmclk_ioctl_cmd_get_opp, &value, 0, NULL);
+    bench_ioctl(bench, "ioctl.get_opp_count", dmclk_ioctl_cmd_get_opp_count, &value, 0, NULL);
+    bench_ioctl(bench, "ioctl.get_qos_limits", dmclk_ioctl_cmd_get_qos_limits, &limits, 0, NULL);
+    bench_ioctl(bench, "ioctl.get_hse_failures", dmclk_ioctl_cmd_get_hse_failures, &value, 0, NULL);
+    bench_ioctl(bench, "ioctl.get_mco", dmclk_ioctl_cmd_get_mco, &mco, 0, NULL);
+    bench_ioctl(bench, "ioctl.set_mco", dmclk_ioctl_cmd_set_mco, &mco, 0, NULL);
+    governor = dmclk_governor_none;
+    bench_ioctl(bench, "ioctl.set_governor", dmclk_ioctl_cmd_set_governor, &governor, 0, NULL);
+    bench_ioctl(bench, "ioctl.governor_sample", dmclk_ioctl_cmd_governor_sample, &sample, 0, NULL);
+    bench_ioctl(bench, "ioctl.register_notifier", dmclk_ioctl_cmd_register_notifier, &notifier,
+                dmclk_ioctl_cmd_unregister_notifier, &notifier);
+
+    /* Port hot path - served from the shared clock state */
+    for (uint32_t i = 0; i < bench->iterations; i++)
+    {
+        uint32_t start = BENCH_DWT_CYCCNT;
+        volatile dmclk_frequency_t current = dmclk_port_get_current_frequency();
+        bench_add(BENCH_DWT_CYCCNT - start);
+        (void)current;
+    }
+    bench_report(bench, "port.get_current_frequency");
+}
+
+/**
+ * @brief Solve a plan for a point through the port
+ */
+static int bench_plan(const bench_t* bench, const bench_point_t* point, dmclk_bus_policy_t policy, dmclk_port_plan_t* plan)
+{
+    if (point->source == dmclk_source_internal)
+    {
+        return dmclk_port_plan_internal(point->frequency, BENCH_TOLERANCE, policy, plan);
+    }
+    if (point->source == dmclk_source_hibernation)
+    {
+        return dmclk_port_plan_hibernation(point->frequency, BENCH_TOLERANCE, bench->oscillator, plan);
+    }
+    return dmclk_port_plan_external(point->frequency, BENCH_TOLERANCE, bench->oscillator, policy, plan);
+}
+
+/**
+ * @brief Measure the clock transitions at a point
+ */
+static void bench_transitions(bench_t* bench, const bench_point_t* points, uint32_t point_count)
+{
+    const bench_point_t* point = &points[bench->point];
+    dmclk_frequency_t frequency = point->frequency;
+    uint32_t index = bench->point;
+    uint32_t previous = (bench->point + point_count - 1U) % point_count;
+    dmclk_port_plan_t plan;
+    dmclk_port_plan_t other_bus_plan;
+
+    /* Full configure(): validation, PLL search and apply. The source of the
+     * device configuration is moved to the point first - the order matters
+     * when the old target cannot be reached from the new source. */
+    dmclk_source_t source = point->source;
+    if (dmclk_dmdrvi_ioctl(bench->context, bench->handle, dmclk_ioctl_cmd_set_source, &source) != 0)
+    {
+        dmclk_dmdrvi_ioctl(bench->context, bench->handle, dmclk_ioctl_cmd_set_target_frequency, &frequency);
+        dmclk_dmdrvi_ioctl(bench->context, bench->handle, dmclk_ioctl_cmd_set_source, &source);
+    }
+    bench_ioctl(bench, "configure", dmclk_ioctl_cmd_set_target_frequency, &frequency, 0, NULL);
+    bench_ioctl(bench, "reconfigure", dmclk_ioctl_cmd_reconfigure, NULL, 0, NULL);
+
+    /* Precomputed operating point, switched to from the previous one */
+    if (point_count > 1U)
+    {
+        bench_ioctl(bench, "opp.switch", dmclk_ioctl_cmd_set_opp, &index, dmclk_ioctl_cmd_set_opp, &previous);
+    }
+
+    /* Port level: solving alone, applying the same plan again, bus prescalers only */
+    for (uint32_t i = 0; i < bench->iterations; i++)
+    {
+        uint32_t start = BENCH_DWT_CYCCNT;
+        int ret = bench_plan(bench, point, dmclk_bus_policy_performance, &plan);
+        uint32_t cycles = BENCH_DWT_CYCCNT - start;
+        if (ret != 0)
+        {
+            Dmod_Printf("# plan failed: %d\n", ret);
+            bench_sample_count = 0;
+            break;
+        }
+        bench_add(cycles);
+    }
+    bench_report(bench, "port.plan");
+
+    if (bench_plan(bench, point, dmclk_bus_policy_performance, &plan) == 0)
+    {
+        for (uint32_t i = 0; i < bench->iterations; i++)
+        {
+            uint32_t start = BENCH_DWT_CYCCNT;
+            int ret = dmclk_port_apply_plan(&plan);
+            uint32_t cycles = BENCH_DWT_CYCCNT - start;
+            if (ret == 0)
+            {
+                bench_add(cycles);
+            }
+        }
+        bench_report(bench, "port.apply_plan");
+    }
+
+    if (point->source != dmclk_source_hibernation
+     && bench_plan(bench, point, dmclk_bus_policy_powersave, &other_bus_plan) == 0
+     && dmclk_port_apply_plan(&plan) == 0)
+    {
+        for (uint32_t i = 0; i < bench->iterations; i++)
+        {
+            uint32_t start = BENCH_DWT_CYCCNT;
+            int ret = dmclk_port_apply_plan(&other_bus_plan);
+            uint32_t cycles = BENCH_DWT_CYCCNT - start;
+            dmclk_port_apply_plan(&plan);
+            if (ret == 0)
+            {
+                bench_add(cycles);
+            }
+        }
+        bench_report(bench, "port.apply_prescalers");
+    }
+
+    /* The port was driven behind dmclk's back - bring both in line again */
+    dmclk_dmdrvi_ioctl(bench->context, bench->handle, dmclk_ioctl_cmd_set_opp, &index);
+}
+
+static const char* bench_source_name(dmclk_source_t source)
+{
+    switch (source)
+    {
+        case dmclk_source_internal:     return "internal";
+        case dmclk_source_hibernation:  return "hibernation";
+        default:                        return "external";
+    }
+}
+
+/**
+ * @brief Parse a source:frequency argument
+ */
+static int bench_parse_point(const char* text, bench_point_t* point)
+{
+    static const dmclk_source_t sources[] = { dmclk_source_internal, dmclk_source_external, dmclk_source_hibernation };
+    unsigned int frequency = 0;
+
+    for (uint32_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++)
+    {
+        const char* name = bench_source_name(sources[i]);
+        size_t length = strlen(name);
+        if (strncmp(text, name, length) == 0 && text[length] == ':'
+         && Dmod_Sscanf(&text[length + 1], "%u", &frequency) == 1 && frequency != 0)
+        {
+            point->source = sources[i];
+            point->frequency = frequency;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+int main(int argc, char* argv[])
+{
+    static char config_text[BENCH_CONFIG_SIZE];
+    bench_point_t points[BENCH_MAX_POINTS] = {
+        { dmclk_source_internal, 16000000 },
+        { dmclk_source_external, 48000000 },
+        { dmclk_source_external, 84000000 },
+    };
+    uint32_t point_count = 3;
+    unsigned int oscillator = 0;
+    unsigned int iterations = BENCH_DEFAULT_ITERATIONS;
+
+    Dmod_Printf("\n=== DMCLK Switch Latency and API Overhead ===\n\n");
+
+    if (argc < 2 || Dmod_Sscanf(argv[1], "%u", &oscillator) != 1 || oscillator == 0)
+    {
+        Dmod_Printf("Usage: dmclk_bench <oscillator_hz> [iterations] [source:frequency ...]\n");
+        Dmod_Printf("Example: dmclk_bench 8000000 100 internal:16000000 external:84000000\n");
+        return -1;
+    }
+    if (argc >= 3 && (Dmod_Sscanf(argv[2], "%u", &iterations) != 1 || iterations == 0 || iterations > BENCH_MAX_SAMPLES))
+    {
+        Dmod_Printf("Error: iterations must be 1 to %u\n", (unsigned int)BENCH_MAX_SAMPLES);
+        return -1;
+    }
+    if (argc >= 4)
+    {
+        point_count = 0;
+        for (int i = 3; i < argc && point_count < BENCH_MAX_POINTS; i++)
+        {
+            if (bench_parse_point(argv[i], &points[point_count]) != 0)
+            {
+                Dmod_Printf("Error: invalid operating point '%s'\n", argv[i]);
+                return -1;
+            }
+            point_count++;
+        }
+    }
+
+    if (bench_start_counter() != 0)
+    {
+        Dmod_Printf("Error: DWT cycle counter is not available\n");
+        return -1;
+    }
+
+    /* Operating points become [dmclk.opp.N] sections, the first one is the initial clock */
+    int length = Dmod_SnPrintf(config_text, sizeof(config_text),
+                               "[dmclk]\nsource=%s\ntarget_frequency=%u\ntolerance=%u\noscillator_frequency=%u\n",
+                               bench_source_name(points[0].source), (unsigned int)points[0].frequency,
+                               (unsigned int)BENCH_TOLERANCE, oscillator);
+    for (uint32_t i = 0; i < point_count && length > 0 && (size_t)length < sizeof(config_text); i++)
+    {
+        length += Dmod_SnPrintf(&config_text[length], sizeof(config_text) - (size_t)length,
+                                "[dmclk.opp.%u]\nsource=%s\ntarget_frequency=%u\n",
+                                (unsigned int)i, bench_source_name(points[i].source), (unsigned int)points[i].frequency);
+    }
+
+    dmini_context_t config = dmini_loads(config_text);
+    if (config == NULL)
+    {
+        Dmod_Printf("Error: cannot parse the generated configuration\n");
+        return -1;
+    }
+
+    dmdrvi_dev_num_t dev_num = {0};
+    bench_t bench = {
+        .context = dmclk_dmdrvi_create(config, &dev_num),
+        .iterations = iterations,
+        .oscillator = oscillator,
+    };
+    if (bench.context == NULL)
+    {
+        Dmod_Printf("Error: cannot create the dmclk device (unreachable operating point?)\n");
+        dmini_free(config);
+        return -1;
+    }
+    bench.handle = dmclk_dmdrvi_open(bench.context, DMDRVI_O_RDONLY);
+    if (bench.handle == NULL)
+    {
+        Dmod_Printf("Error: cannot open the dmclk device\n");
+        dmclk_dmdrvi_free(bench.context);
+        dmini_free(config);
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < point_count; i++)
+    {
+        Dmod_Printf("# point %u: %s %llu Hz\n", (unsigned int)i, bench_source_name(points[i].source),
+                    (unsigned long long)points[i].frequency);
+    }
+    Dmod_Printf("point,benchmark,iterations,min,avg,max,p99\n");
+
+    for (uint32_t i = 0; i < point_count; i++)
+    {
+        bench.point = i;
+        if (dmclk_dmdrvi_ioctl(bench.context, bench.handle, dmclk_ioctl_cmd_set_opp, &i) != 0)
+        {
+            Dmod_Printf("# point %u cannot be reached\n", (unsigned int)i);
+            continue;
+        }
+        bench_api(&bench);
+        bench_transitions(&bench, points, point_count);
+    }
+
+    dmclk_dmdrvi_close(bench.context, bench.handle);
+    dmclk_dmdrvi_free(bench.context);
+    dmini_free(config);
+    Dmod_Printf("\n");
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include "dmclk.h"
+#include "port/dmclk_sim.h"
+
+/*
+ * dmclk with a static configuration on the simulation port
+ *
+ * dmclk.c is compiled with DMCLK_STATIC_CONFIG and the header dmclk_plangen
+ * generated from configs/board/stm32f746g-disco.ini. The context is created
+ * without an ini file and has to come up at the frequency of the solved plan.
+ */
+
+int dmod_init(const Dmod_Config_t* Config);
+
+static int failures = 0;
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);\
+            failures++;                                                             \
+        }                                                                           \
+    } while (0)
+
+int main(void)
+{
+    dmdrvi_dev_num_t dev_num;
+    dmclk_frequency_t frequency = 0;
+    dmclk_frequency_t target = 0;
+    dmclk_sim_stats_t stats;
+
+    dmod_init(NULL);
+    dmdrvi_context_t context = dmclk_dmdrvi_create(NULL, &dev_num);
+    CHECK(context != NULL);
+    if (context != NULL) {
+        CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_frequency, &frequency) == 0);
+        CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_target_frequency, &target) == 0);
+        CHECK(frequency == 216000000U);
+        CHECK(target == 216000000U);
+        CHECK(dmclk_port_get_current_frequency() == 216000000U);
+
+        dmclk_sim_get_stats(&stats);
+        CHECK(stats.hse_startups == 1);
+        CHECK(stats.pll_locks == 1);
+        CHECK(stats.violations == 0);
+
+        dmclk_dmdrvi_free(context);
+    }
+
+    printf("%-24s %s\n", "static_config", failures == 0 ? "ok" : "FAILED");
+    return failures == 0 ? 0 : 1;
+}
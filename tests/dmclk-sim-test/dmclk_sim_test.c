@@ -0,0 +1,1450 @@
+#include <errno.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+#include "dmclk.h"
+#include "dmclk_early.h"
+#include "dmini.h"
+#include "port/dmclk_sim.h"
+#include "port/stm32_common_regs.h"
+#include "stm32_common.h"
+
+/*
+ * dmclk on the simulation port
+ *
+ * dmclk.c, the common STM32 port and the simulation port run unchanged on the
+ * host. Every case starts from reset registers, creates a context from its own
+ * configuration and checks the results through the driver interface and the
+ * counters of the model. Run one case by name or all of them without arguments.
+ */
+
+int dmod_init(const Dmod_Config_t* Config);
+int host_mutex_failures(void);
+
+static int failures = 0;
+
+#define CHECK(cond)                                                                 \
+    do {                                                                            \
+        if (!(cond)) {                                                              \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond);\
+            failures++;                                                             \
+        }                                                                           \
+    } while (0)
+
+/* STM32F746G-DISCO: 25 MHz crystal, 216 MHz with Over-Drive */
+static const char board_config[] =
+    "[dmclk]\n"
+    "source=external\n"
+    "target_frequency=216000000\n"
+    "tolerance=1000\n"
+    "oscillator_frequency=25000000\n";
+
+/* The same board with two operating points */
+static const char opp_config[] =
+    "[dmclk]\n"
+    "source=external\n"
+    "target_frequency=216000000\n"
+    "tolerance=1000\n"
+    "oscillator_frequency=25000000\n"
+    "[dmclk.opp.0]\n"
+    "source=external\n"
+    "target_frequency=48000000\n"
+    "[dmclk.opp.1]\n"
+    "source=external\n"
+    "target_frequency=216000000\n";
+
+/* The board at the USB rate, 48 MHz straight from the PLL Q output */
+static const char usb_config[] =
+    "[dmclk]\n"
+    "source=external\n"
+    "target_frequency=96000000\n"
+    "tolerance=1000\n"
+    "oscillator_frequency=25000000\n";
+
+/* The board running straight from the crystal */
+static const char direct_config[] =
+    "[dmclk]\n"
+    "source=external\n"
+    "target_frequency=25000000\n"
+    "tolerance=1000\n"
+    "oscillator_frequency=25000000\n";
+
+/* The board with a 96 MHz I2S clock */
+static const char plli2s_config[] =
+    "[dmclk]\n"
+    "source=external\n"
+    "target_frequency=216000000\n"
+    "tolerance=1000\n"
+    "oscillator_frequency=25000000\n"
+    "[dmclk.plli2s]\n"
+    "target_frequency=96000000\n";
+
+/* The board with SYSCLK / 4 on PC9 and HSE on PA8 */
+static const char mco_config[] =
+    "[dmclk]\n"
+    "source=external\n"
+    "target_frequency=216000000\n"
+    "tolerance=1000\n"
+    "oscillator_frequency=25000000\n"
+    "[dmclk.mco2]\n"
+    "source=sysclk\n"
+    "divider=4\n"
+    "[dmclk.mco1]\n"
+    "source=external\n";
+
+/* The board scaled by the load between 48 and 216 MHz */
+static const char governor_config[] =
+    "[dmclk]\n"
+    "source=external\n"
+    "target_frequency=216000000\n"
+    "tolerance=1000\n"
+    "oscillator_frequency=25000000\n"
+    "governor=ondemand\n"
+    "governor_min_frequency=48000000\n"
+    "governor_sampling_ms=100\n"
+    "governor_step=24000000\n";
+
+/**
+ * @brief Create a context from a configuration on the clock as it runs
+ */
+static dmdrvi_context_t create_running(const char* ini)
+{
+    dmdrvi_dev_num_t dev_num;
+
+    dmini_context_t config = dmini_parse_string(ini);
+    dmdrvi_context_t context = dmclk_dmdrvi_create(config, &dev_num);
+    dmini_free(config);
+    return context;
+}
+
+/**
+ * @brief Reset the model and create a context from a configuration
+ */
+static dmdrvi_context_t create_context(const char* ini)
+{
+    dmod_init(NULL);
+    return create_running(ini);
+}
+
+static dmclk_frequency_t get_frequency(dmdrvi_context_t context)
+{
+    dmclk_frequency_t frequency = 0;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_frequency, &frequency) == 0);
+    return frequency;
+}
+
+static dmclk_frequency_t get_target(dmdrvi_context_t context)
+{
+    dmclk_frequency_t frequency = 0;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_target_frequency, &frequency) == 0);
+    return frequency;
+}
+
+static dmclk_frequency_t get_tolerance(dmdrvi_context_t context)
+{
+    dmclk_frequency_t tolerance = 0;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_tolerance, &tolerance) == 0);
+    return tolerance;
+}
+
+static uint32_t get_opp(dmdrvi_context_t context)
+{
+    uint32_t opp = 0;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_opp, &opp) == 0);
+    return opp;
+}
+
+/**
+ * @brief Write a text command, returns 1 if all of it was accepted
+ */
+static int write_command(dmdrvi_context_t context, void* handle, const char* command)
+{
+    size_t size = strlen(command);
+    return dmclk_dmdrvi_write(context, handle, command, size, 0) == size;
+}
+
+static int set_target(dmdrvi_context_t context, dmclk_frequency_t frequency)
+{
+    return dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_set_target_frequency, &frequency);
+}
+
+static dmclk_qos_limits_t get_qos_limits(dmdrvi_context_t context)
+{
+    dmclk_qos_limits_t limits = { 0 };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_qos_limits, &limits) == 0);
+    return limits;
+}
+
+static dmclk_sim_stats_t get_stats(void)
+{
+    dmclk_sim_stats_t stats;
+    dmclk_sim_get_stats(&stats);
+    return stats;
+}
+
+/* Notifications received by record_notifier() */
+#define MAX_RECORDED    16
+
+typedef struct
+{
+    int count;
+    dmclk_notify_event_t events[MAX_RECORDED];
+    dmclk_notify_data_t data[MAX_RECORDED];
+    int veto;                       /* Returned for dmclk_notify_pre_change */
+} notify_record_t;
+
+static int record_notifier(dmclk_notify_event_t event, const dmclk_notify_data_t* data, void* user_data)
+{
+    notify_record_t* record = (notify_record_t*)user_data;
+    if (record->count < MAX_RECORDED) {
+        record->events[record->count] = event;
+        record->data[record->count] = *data;
+    }
+    record->count++;
+    return (event == dmclk_notify_pre_change) ? record->veto : 0;
+}
+
+/**
+ * @brief Feed one governor sampling period (100 ms) with the given load in percent
+ */
+static int feed_load(dmdrvi_context_t context, uint32_t load)
+{
+    dmclk_load_sample_t sample = { .busy_us = load * 1000U, .period_us = 100000U };
+    return dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_governor_sample, &sample);
+}
+
+static int count_events(const notify_record_t* record, dmclk_notify_event_t event)
+{
+    int count = 0;
+    for (int i = 0; i < record->count && i < MAX_RECORDED; i++) {
+        count += (record->events[i] == event) ? 1 : 0;
+    }
+    return count;
+}
+
+/* Register accesses recorded around one frequency change */
+#define MAX_TRACED      4096
+
+static dmclk_sim_trace_entry_t trace[MAX_TRACED];
+static int traced = 0;
+
+/**
+ * @brief Change the target with the register accesses recorded in trace[]
+ */
+static int set_target_traced(dmdrvi_context_t context, dmclk_frequency_t frequency)
+{
+    dmclk_sim_trace_start(trace, MAX_TRACED);
+    int ret = set_target(context, frequency);
+    uint32_t count = dmclk_sim_trace_stop();
+    CHECK(count <= MAX_TRACED);
+    traced = (count <= MAX_TRACED) ? (int)count : MAX_TRACED;
+    return ret;
+}
+
+/**
+ * @brief Find a traced write setting bits of a register
+ *
+ * @param first First entry to look at
+ * @param last 1 for the last matching write, 0 for the first one
+ *
+ * @return int Index of the write, -1 if there is none
+ */
+static int find_write(int first, int last, dmclk_sim_block_t block, uint16_t offset, uint32_t mask, uint32_t value)
+{
+    int found = -1;
+    for (int i = first; i < traced; i++) {
+        if (trace[i].write && trace[i].block == block && trace[i].offset == offset
+         && (trace[i].value & mask) == value) {
+            found = i;
+            if (!last) {
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Find a traced write changing a register field
+ *
+ * The field is followed through the reads and writes of the trace, starting
+ * from the first access.
+ *
+ * @param direction 1 for a write raising the field, -1 for one lowering it, 0 for any change
+ * @param last 1 for the last matching write, 0 for the first one
+ *
+ * @return int Index of the write, -1 if there is none
+ */
+static int find_change(dmclk_sim_block_t block, uint16_t offset, uint32_t mask, int direction, int last)
+{
+    int found = -1;
+    int known = 0;
+    uint32_t field = 0;
+    for (int i = 0; i < traced; i++) {
+        if (trace[i].block != block || trace[i].offset != offset) {
+            continue;
+        }
+        uint32_t value = trace[i].value & mask;
+        if (trace[i].write && known
+         && ((direction > 0 && value > field) || (direction < 0 && value < field) || (direction == 0 && value != field))) {
+            found = i;
+            if (!last) {
+                break;
+            }
+        }
+        if (trace[i].write || !known) {
+            field = value;
+            known = 1;
+        }
+    }
+    return found;
+}
+
+/* Completions received by record_async() */
+typedef struct
+{
+    dmdrvi_context_t context;
+    int count;
+    int result;
+    dmclk_frequency_t frequency;
+    int reentry;                    /* Result of the locking command issued from the callback */
+    dmclk_async_status_t status;    /* Status read from the callback */
+} async_record_t;
+
+static void record_async(int result, dmclk_frequency_t frequency, void* user_data)
+{
+    async_record_t* record = (async_record_t*)user_data;
+    record->count++;
+    record->result = result;
+    record->frequency = frequency;
+
+    /* The context is unlocked already, so even commands taking the writer lock may be issued from here */
+    record->reentry = dmclk_dmdrvi_ioctl(record->context, NULL, dmclk_ioctl_cmd_process_events, NULL);
+    CHECK(dmclk_dmdrvi_ioctl(record->context, NULL, dmclk_ioctl_cmd_get_async_status, &record->status) == 0);
+}
+
+static int start_async(dmdrvi_context_t context, dmclk_frequency_t frequency, async_record_t* record)
+{
+    dmclk_async_request_t request = { .target_frequency = frequency, .callback = record_async, .user_data = record };
+    record->context = context;
+    return dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_reconfigure_async, &request);
+}
+
+static dmclk_async_status_t get_async_status(dmdrvi_context_t context)
+{
+    dmclk_async_status_t status = dmclk_async_idle;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_async_status, &status) == 0);
+    return status;
+}
+
+/**
+ * @brief Continue the pending reconfiguration and read its state
+ */
+static dmclk_async_status_t poll_async(dmdrvi_context_t context)
+{
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_process_events, NULL) == 0);
+    return get_async_status(context);
+}
+
+/**
+ * @brief The context comes up at the configured frequency within the limits of the part
+ */
+static void test_boot_external(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+
+    dmclk_clock_tree_t tree;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_clock_tree, &tree) == 0);
+    CHECK(tree.hclk == 216000000U);
+    CHECK(tree.pclk1 <= 54000000U && tree.pclk2 <= 108000000U);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(dmclk_port_get_current_frequency() == 216000000U);
+
+    dmclk_sim_stats_t stats = get_stats();
+    CHECK(stats.hse_startups == 1);
+    CHECK(stats.pll_locks == 1);
+    CHECK(stats.violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief Changing the target reprograms the clock in both directions
+ */
+static void test_switch_frequency(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+
+    CHECK(set_target(context, 48000000U) == 0);
+    CHECK(get_frequency(context) == 48000000U);
+    CHECK(set_target(context, 216000000U) == 0);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(set_target(context, 1000000000U) != 0);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief An HSE failure is only recorded in interrupt context and recovered from by the next task
+ */
+static void test_hse_failure(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    notify_record_t record = { 0 };
+    dmclk_notifier_t notifier = { .callback = record_notifier, .user_data = &record };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_register_notifier, &notifier) == 0);
+
+    dmclk_sim_inject_hse_failure();
+
+    /* The interrupts only published the HSI clock the hardware fell back to */
+    uint32_t hse_failures = 0;
+    CHECK(dmclk_port_get_current_frequency() == 16000000U);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_hse_failures, &hse_failures) == 0);
+    CHECK(hse_failures == 0);
+    CHECK(record.count == 0);
+
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_process_events, NULL) == 0);
+
+    dmclk_source_t source = dmclk_source_external;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_hse_failures, &hse_failures) == 0);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_source, &source) == 0);
+    CHECK(hse_failures == 1);
+    CHECK(source == dmclk_source_internal);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(dmclk_port_get_current_frequency() == 216000000U);
+    CHECK(record.count == 1);
+    CHECK(record.events[0] == dmclk_notify_post_change);
+    CHECK(record.data[0].old_frequency == 216000000U && record.data[0].new_frequency == 216000000U);
+
+    /* Handled once */
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_process_events, NULL) == 0);
+    CHECK(record.count == 1);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief A veto stops the change and aborts it for the notifiers already called
+ */
+static void test_notifier_veto(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    notify_record_t records[3] = { 0 };
+    dmclk_notifier_t notifiers[3];
+    for (int i = 0; i < 3; i++) {
+        /* Registered lowest priority first, called highest priority first */
+        notifiers[i] = (dmclk_notifier_t){ .callback = record_notifier, .user_data = &records[i], .priority = i };
+        CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_register_notifier, &notifiers[i]) == 0);
+    }
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_register_notifier, &notifiers[0]) != 0);
+
+    uint32_t switches = get_stats().clock_switches;
+    records[1].veto = 1;
+    CHECK(set_target(context, 48000000U) == -EBUSY);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(records[2].count == 2);
+    CHECK(records[2].events[0] == dmclk_notify_pre_change && records[2].events[1] == dmclk_notify_abort);
+    CHECK(records[2].data[1].old_frequency == 216000000U && records[2].data[1].new_frequency == 48000000U);
+    CHECK(records[1].count == 1 && records[1].events[0] == dmclk_notify_pre_change);
+    CHECK(records[0].count == 0);
+    CHECK(get_stats().clock_switches == switches);
+
+    /* Without the veto everybody sees the change */
+    memset(records, 0, sizeof(records));
+    CHECK(set_target(context, 48000000U) == 0);
+    CHECK(get_frequency(context) == 48000000U);
+    for (int i = 0; i < 3; i++) {
+        CHECK(records[i].count == 2);
+        CHECK(records[i].events[0] == dmclk_notify_pre_change && records[i].events[1] == dmclk_notify_post_change);
+        CHECK(records[i].data[1].old_frequency == 216000000U && records[i].data[1].new_frequency == 48000000U);
+    }
+
+    /* An unregistered notifier is not called anymore */
+    memset(records, 0, sizeof(records));
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_unregister_notifier, &notifiers[2]) == 0);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_unregister_notifier, &notifiers[2]) != 0);
+    CHECK(set_target(context, 216000000U) == 0);
+    CHECK(records[2].count == 0 && records[1].count == 2 && records[0].count == 2);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief The highest minimum and the lowest maximum request clamp the target
+ */
+static void test_qos_limits(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    dmclk_qos_request_t min_high = { .type = dmclk_qos_min_frequency, .frequency = 100000000U };
+    dmclk_qos_request_t min_low = { .type = dmclk_qos_min_frequency, .frequency = 72000000U };
+    dmclk_qos_request_t max = { .type = dmclk_qos_max_frequency, .frequency = 80000000U };
+    dmclk_qos_request_t invalid = { .type = dmclk_qos_max_frequency, .frequency = 0 };
+
+    CHECK(get_qos_limits(context).min_frequency == 0);
+    CHECK(get_qos_limits(context).max_frequency == DMCLK_QOS_NO_LIMIT);
+    CHECK(set_target(context, 48000000U) == 0);
+
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_add_qos_request, &min_high) == 0);
+    CHECK(get_frequency(context) == 100000000U);
+
+    /* A lower minimum does not change the limits nor the clock */
+    uint32_t switches = get_stats().clock_switches;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_add_qos_request, &min_low) == 0);
+    CHECK(get_qos_limits(context).min_frequency == 100000000U);
+    CHECK(get_stats().clock_switches == switches);
+
+    /* The maximum wins over a conflicting minimum */
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_add_qos_request, &max) == 0);
+    CHECK(get_qos_limits(context).min_frequency == 100000000U);
+    CHECK(get_qos_limits(context).max_frequency == 80000000U);
+    CHECK(get_frequency(context) == 80000000U);
+
+    dmclk_frequency_t target = 0;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_target_frequency, &target) == 0);
+    CHECK(target == 48000000U);
+
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_add_qos_request, &max) == -EEXIST);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_add_qos_request, &invalid) == -EINVAL);
+
+    /* Releasing the requests walks back down to the configured target */
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_remove_qos_request, &max) == 0);
+    CHECK(get_frequency(context) == 100000000U);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_remove_qos_request, &min_high) == 0);
+    CHECK(get_qos_limits(context).min_frequency == 72000000U);
+    CHECK(get_frequency(context) == 72000000U);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_remove_qos_request, &min_low) == 0);
+    CHECK(get_qos_limits(context).max_frequency == DMCLK_QOS_NO_LIMIT);
+    CHECK(get_frequency(context) == 48000000U);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_remove_qos_request, &min_low) == -ENOENT);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief A request whose change was vetoed is applied by the next change of the limits
+ */
+static void test_qos_vetoed(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    notify_record_t record = { .veto = 1 };
+    dmclk_notifier_t notifier = { .callback = record_notifier, .user_data = &record };
+    dmclk_qos_request_t min = { .type = dmclk_qos_min_frequency, .frequency = 100000000U };
+    dmclk_qos_request_t max = { .type = dmclk_qos_max_frequency, .frequency = 150000000U };
+
+    CHECK(set_target(context, 48000000U) == 0);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_register_notifier, &notifier) == 0);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_add_qos_request, &min) == -EBUSY);
+    CHECK(get_qos_limits(context).min_frequency == 100000000U);
+    CHECK(get_frequency(context) == 48000000U);
+
+    record.veto = 0;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_add_qos_request, &max) == 0);
+    CHECK(get_frequency(context) == 100000000U);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief Text commands are applied as a whole or not at all
+ */
+static void test_write_command(void)
+{
+    dmdrvi_context_t context = create_context(opp_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    void* handle = dmclk_dmdrvi_open(context, DMDRVI_O_RDWR);
+    CHECK(handle != NULL);
+
+    CHECK(write_command(context, handle, "target_frequency=48000000; tolerance=2000\n"));
+    CHECK(get_frequency(context) == 48000000U);
+    CHECK(get_tolerance(context) == 2000U);
+    CHECK(get_opp(context) == DMCLK_OPP_NONE);
+    CHECK(write_command(context, handle, "frequency=100000000"));
+    CHECK(get_frequency(context) == 100000000U);
+
+    /* Rejected commands change nothing, not even their valid pairs */
+    uint32_t switches = get_stats().clock_switches;
+    CHECK(!write_command(context, handle, "target_frequency=72000000;speed=1"));
+    CHECK(!write_command(context, handle, "tolerance=5000;target_frequency"));
+    CHECK(!write_command(context, handle, "opp=1;tolerance=5000"));
+    CHECK(!write_command(context, handle, "opp=2"));
+    CHECK(!write_command(context, handle, "\n"));
+    CHECK(!write_command(context, handle, " \t;\n ;"));
+    CHECK(get_target(context) == 100000000U);
+    CHECK(get_tolerance(context) == 2000U);
+    CHECK(get_stats().clock_switches == switches);
+
+    CHECK(write_command(context, handle, "opp=1"));
+    CHECK(get_opp(context) == 1);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(get_tolerance(context) == 1000U);
+
+    /* A vetoed command restores the configuration and the operating point */
+    notify_record_t record = { .veto = 1 };
+    dmclk_notifier_t notifier = { .callback = record_notifier, .user_data = &record };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_register_notifier, &notifier) == 0);
+    CHECK(!write_command(context, handle, "target_frequency=48000000;tolerance=5000"));
+    CHECK(get_target(context) == 216000000U);
+    CHECK(get_tolerance(context) == 1000U);
+    CHECK(get_opp(context) == 1);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_close(context, handle);
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief Flash wait states and Over-Drive bracket the SYSCLK switch
+ *
+ * Going up, the latency and Over-Drive must be in place before SYSCLK switches
+ * to the faster clock. Going down, the latency may only be lowered after it.
+ */
+static void test_trace_order(void)
+{
+    const uint16_t acr = (uint16_t)offsetof(FLASH_TypeDef, ACR);
+    const uint16_t cr1 = (uint16_t)offsetof(PWR_TypeDef, CR1);
+
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+
+    /* 216 MHz from the PLL with Over-Drive down to 25 MHz straight from HSE */
+    CHECK(set_target_traced(context, 25000000U) == 0);
+    CHECK(get_frequency(context) == 25000000U);
+    int first_switch = find_change(dmclk_sim_block_rcc, RCC_CFGR_OFFSET, RCC_CFGR_SW_Msk, 0, 0);
+    int last_switch = find_change(dmclk_sim_block_rcc, RCC_CFGR_OFFSET, RCC_CFGR_SW_Msk, 0, 1);
+    int latency = find_change(dmclk_sim_block_flash, acr, FLASH_ACR_LATENCY_Msk, -1, 0);
+    CHECK(first_switch >= 0 && (trace[last_switch].value & RCC_CFGR_SW_Msk) == RCC_CFGR_SW_HSE);
+    CHECK(latency > last_switch);
+    CHECK(find_change(dmclk_sim_block_flash, acr, FLASH_ACR_LATENCY_Msk, 1, 0) < 0);
+
+    /* And back up, Over-Drive is needed again */
+    CHECK(set_target_traced(context, 216000000U) == 0);
+    CHECK(get_frequency(context) == 216000000U);
+    last_switch = find_change(dmclk_sim_block_rcc, RCC_CFGR_OFFSET, RCC_CFGR_SW_Msk, 0, 1);
+    latency = find_change(dmclk_sim_block_flash, acr, FLASH_ACR_LATENCY_Msk, 1, 0);
+    int oden = find_write(0, 0, dmclk_sim_block_pwr, cr1, PWR_CR1_ODEN, PWR_CR1_ODEN);
+    int odswen = find_write(0, 0, dmclk_sim_block_pwr, cr1, PWR_CR1_ODSWEN, PWR_CR1_ODSWEN);
+    CHECK(last_switch >= 0 && (trace[last_switch].value & RCC_CFGR_SW_Msk) == RCC_CFGR_SW_PLL);
+    CHECK(latency >= 0 && latency < last_switch);
+    CHECK(oden >= 0 && oden < odswen && odswen < last_switch);
+    CHECK(find_change(dmclk_sim_block_flash, acr, FLASH_ACR_LATENCY_Msk, -1, 0) < 0);
+
+    CHECK(get_stats().violations == 0);
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief An asynchronous switch is finished by polling, never by the interrupt
+ */
+static void test_async_complete(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    async_record_t record = { 0 };
+    notify_record_t notified = { 0 };
+    dmclk_notifier_t notifier = { .callback = record_notifier, .user_data = &notified };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_register_notifier, &notifier) == 0);
+
+    /* The PLL relocks, SYSCLK runs from HSI meanwhile */
+    CHECK(start_async(context, 48000000U, &record) == 0);
+    CHECK(record.count == 0);
+    CHECK(notified.count == 1 && notified.events[0] == dmclk_notify_pre_change);
+    CHECK(set_target(context, 100000000U) == -EBUSY);
+    CHECK(poll_async(context) == dmclk_async_pending);
+
+    /* The ready interrupt is taken, but only wakes the application */
+    uint32_t interrupts = get_stats().rcc_interrupts;
+    dmclk_sim_tick(DMCLK_SIM_PLL_LOCK_TICKS);
+    CHECK(get_stats().rcc_interrupts == interrupts + 1);
+    CHECK(record.count == 0);
+    CHECK(notified.count == 1);
+
+    /* Reading the state does not continue the switch */
+    CHECK(get_async_status(context) == dmclk_async_pending);
+    CHECK(record.count == 0);
+
+    CHECK(poll_async(context) == dmclk_async_done);
+    CHECK(record.count == 1);
+    CHECK(record.result == 0 && record.frequency == 48000000U);
+    CHECK(record.reentry == 0 && record.status == dmclk_async_done);
+    CHECK(notified.count == 2 && notified.events[1] == dmclk_notify_post_change);
+    CHECK(notified.data[1].old_frequency == 216000000U && notified.data[1].new_frequency == 48000000U);
+    CHECK(get_frequency(context) == 48000000U);
+    CHECK(dmclk_port_get_current_frequency() == 48000000U);
+
+    /* Completed once, writers are accepted again */
+    CHECK(poll_async(context) == dmclk_async_done);
+    CHECK(record.count == 1);
+    CHECK(set_target(context, 216000000U) == 0);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief A switch with nothing to wait for still completes after the command returned
+ */
+static void test_async_immediate(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    async_record_t record = { 0 };
+
+    /* Reapplying the running configuration waits for nothing */
+    CHECK(start_async(context, 0, &record) == 0);
+    CHECK(record.count == 0);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_process_events, NULL) == 0);
+    CHECK(record.count == 1 && record.result == 0);
+    CHECK(record.frequency == 216000000U);
+    CHECK(record.reentry == 0 && record.status == dmclk_async_done);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief A cancelled switch completes as failed and leaves the clock usable
+ */
+static void test_async_cancel(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    async_record_t record = { 0 };
+
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_cancel_async, NULL) == -ENOENT);
+    CHECK(start_async(context, 48000000U, &record) == 0);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_cancel_async, NULL) == 0);
+    CHECK(record.count == 1 && record.result == -EIO);
+    CHECK(record.reentry == 0 && record.status == dmclk_async_failed);
+    CHECK(poll_async(context) == dmclk_async_failed);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_cancel_async, NULL) == -ENOENT);
+
+    /* The PLL was being relocked - the clock runs from HSI until the next change */
+    CHECK(get_frequency(context) == dmclk_port_get_current_frequency());
+    dmclk_frequency_t target = 0;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_target_frequency, &target) == 0);
+    CHECK(target == 216000000U);
+    CHECK(set_target(context, 216000000U) == 0);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(record.count == 1);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief An HSE failure while waiting fails the switch before the recovery
+ */
+static void test_async_hse_failure(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    async_record_t record = { 0 };
+
+    CHECK(start_async(context, 48000000U, &record) == 0);
+    dmclk_sim_inject_hse_failure();
+    CHECK(record.count == 0);
+
+    CHECK(poll_async(context) == dmclk_async_failed);
+    CHECK(record.count == 1 && record.result == -EIO);
+
+    uint32_t hse_failures = 0;
+    dmclk_source_t source = dmclk_source_external;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_hse_failures, &hse_failures) == 0);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_source, &source) == 0);
+    CHECK(hse_failures == 1);
+    CHECK(source == dmclk_source_internal);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief A switch waiting for an oscillator that never starts gives up after the port timeout
+ */
+static void test_async_timeout(void)
+{
+    dmclk_port_plan_t plan;
+
+    /* From reset (HSI, 16 cycles per tick) with a dead crystal */
+    dmod_init(NULL);
+    dmclk_sim_inject_hse_failure();
+    CHECK(dmclk_port_plan_external(216000000U, 1000U, 25000000U, dmclk_bus_policy_performance, &plan) == 0);
+    CHECK(dmclk_port_apply_plan_async(&plan) == 0);
+    CHECK(dmclk_port_apply_plan(&plan) != 0);
+
+    dmclk_sim_tick(ASYNC_STARTUP_TIMEOUT_MS * 1000U - 1000U);
+    CHECK(dmclk_port_advance_async() == 1);
+    dmclk_sim_tick(1000U);
+    CHECK(dmclk_port_advance_async() < 0);
+    CHECK(dmclk_port_advance_async() < 0);
+    CHECK(dmclk_port_get_current_frequency() == 16000000U);
+
+    /* The hardware is free again */
+    dmclk_sim_repair_hse();
+    CHECK(dmclk_port_apply_plan(&plan) == 0);
+    CHECK(dmclk_port_get_current_frequency() == 216000000U);
+    CHECK(get_stats().violations == 0);
+}
+
+/**
+ * @brief The clock raised by the boot code is adopted by every context created later
+ */
+static void test_early_init(void)
+{
+    dmclk_port_plan_t plan;
+
+    /* The boot code applies the plan dmclk solves for the board, before dmclk is loaded */
+    dmod_init(NULL);
+    CHECK(dmclk_port_plan_external(216000000U, 1000U, 25000000U, dmclk_bus_policy_performance, &plan) == 0);
+    CHECK(dmclk_early_init(&plan) == 0);
+    CHECK(get_stats().pll_locks == 1);
+    CHECK(dmclk_early_init(&plan) == 0);
+
+    /* Applying the same plan again would rewrite the registers - adopting it
+     * only arms the Clock Security System */
+    uint32_t writes = get_stats().reg_writes;
+
+    dmdrvi_context_t context = create_running(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    CHECK(get_frequency(context) == 216000000U);
+    dmclk_dmdrvi_free(context);
+
+    /* The module is loaded again */
+    context = create_running(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(dmclk_port_get_current_frequency() == 216000000U);
+
+    dmclk_sim_stats_t stats = get_stats();
+    CHECK(stats.hse_startups == 1);
+    CHECK(stats.pll_locks == 1);
+    CHECK(stats.reg_writes - writes <= 2);
+    CHECK(stats.violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief A plan failing half-way leaves the port on the clock that really runs
+ */
+static void test_port_apply_failure(void)
+{
+    dmclk_port_plan_t boot;
+    dmclk_port_plan_t plan;
+    dmclk_clock_tree_t tree;
+
+    dmod_init(NULL);
+    CHECK(dmclk_port_plan_external(216000000U, 1000U, 25000000U, dmclk_bus_policy_performance, &boot) == 0);
+    CHECK(dmclk_port_plan_external(100000000U, 1000U, 25000000U, dmclk_bus_policy_performance, &plan) == 0);
+    CHECK(dmclk_port_apply_plan(&boot) == 0);
+
+    /* SYSCLK moves to HSI for the relock, which never finishes */
+    dmclk_sim_inject_pll_failure();
+    CHECK(dmclk_port_apply_plan(&plan) != 0);
+    CHECK(dmclk_port_get_current_frequency() == 16000000U);
+    dmclk_shared_read(dmclk_port_get_shared(), &tree);
+    CHECK(tree.hclk == 16000000U);
+
+    /* STOP mode does not try to restore the 216 MHz plan that is gone */
+    uint32_t pll_locks = get_stats().pll_locks;
+    CHECK(dmclk_port_enter_stop() == 0);
+    CHECK(dmclk_port_get_current_frequency() == 16000000U);
+
+    /* The next plan starts from HSI */
+    dmclk_sim_repair_pll();
+    CHECK(dmclk_port_apply_plan(&boot) == 0);
+    CHECK(dmclk_port_get_current_frequency() == 216000000U);
+    CHECK(get_stats().pll_locks == pll_locks + 1);
+    CHECK(get_stats().violations == 0);
+}
+
+/**
+ * @brief A change failing after the clock moved tells the notifiers the rate that runs
+ */
+static void test_configure_failure(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    notify_record_t record = { 0 };
+    dmclk_notifier_t notifier = { .callback = record_notifier, .user_data = &record };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_register_notifier, &notifier) == 0);
+
+    /* SYSCLK runs from HSI while the PLL relocks, which never finishes */
+    dmclk_sim_inject_pll_failure();
+    CHECK(set_target(context, 100000000U) != 0);
+    CHECK(record.count == 2);
+    CHECK(record.events[0] == dmclk_notify_pre_change);
+    CHECK(record.events[1] == dmclk_notify_post_change);
+    CHECK(record.data[1].old_frequency == 216000000U && record.data[1].new_frequency == 16000000U);
+    CHECK(get_frequency(context) == 16000000U);
+
+    dmclk_clock_tree_t tree;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_clock_tree, &tree) == 0);
+    CHECK(tree.hclk == 16000000U);
+
+    /* The configured target (216 MHz) no longer runs, so a minimum at it reconfigures */
+    dmclk_sim_repair_pll();
+    dmclk_qos_request_t min = { .type = dmclk_qos_min_frequency, .frequency = 216000000U };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_add_qos_request, &min) == 0);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_remove_qos_request, &min) == 0);
+
+    /* A change failing before the clock moved is still aborted */
+    dmclk_sim_inject_hse_failure();
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_process_events, NULL) == 0);
+    record.count = 0;
+    dmclk_source_t source = dmclk_source_external;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_set_source, &source) != 0);
+    CHECK(record.count == 2);
+    CHECK(record.events[1] == dmclk_notify_abort);
+
+    CHECK(set_target(context, 100000000U) == 0);
+    CHECK(get_frequency(context) == 100000000U);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/* State read by status_notifier() */
+typedef struct
+{
+    dmdrvi_context_t context;
+    int calls;
+    int result;
+    dmclk_async_status_t status;
+} status_record_t;
+
+static int status_notifier(dmclk_notify_event_t event, const dmclk_notify_data_t* data, void* user_data)
+{
+    status_record_t* record = (status_record_t*)user_data;
+    record->calls++;
+    record->result = dmclk_dmdrvi_ioctl(record->context, NULL, dmclk_ioctl_cmd_get_async_status, &record->status);
+    return 0;
+}
+
+/**
+ * @brief The asynchronous state is read without the writer lock, also from notifiers
+ */
+static void test_async_status_read(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    status_record_t record = { .context = context, .result = -1 };
+    dmclk_notifier_t notifier = { .callback = status_notifier, .user_data = &record };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_register_notifier, &notifier) == 0);
+
+    /* Notifiers run with the writer lock held - a locking read would block forever */
+    int mutex_failures = host_mutex_failures();
+    CHECK(set_target(context, 48000000U) == 0);
+    CHECK(record.calls == 2);
+    CHECK(record.result == 0 && record.status == dmclk_async_idle);
+    CHECK(host_mutex_failures() == mutex_failures);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief A context created again takes over the plan of the previous one
+ */
+static void test_adopt_exact(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    dmclk_dmdrvi_free(context);
+    dmclk_sim_stats_t before = get_stats();
+
+    context = create_running(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    dmclk_sim_stats_t after = get_stats();
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(after.pll_locks == before.pll_locks);
+    CHECK(after.hse_startups == before.hse_startups);
+    CHECK(after.clock_switches == before.clock_switches);
+    CHECK(after.reg_writes - before.reg_writes <= 1);
+    CHECK(after.violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief A running PLL within the tolerance is kept although the solver would pick other dividers
+ */
+static void test_adopt_tolerance(void)
+{
+    dmclk_port_plan_t plan;
+    stm32_plan_t* stm32_plan = STM32_PLAN(&plan);
+    dmclk_clock_tree_t tree;
+    const uint32_t pll_msk = RCC_PLLCFGR_PLLN_Msk | RCC_PLLCFGR_PLLP_Msk | RCC_PLLCFGR_PLLQ_Msk;
+
+    /* A bootloader reached 96 MHz with twice the VCO dmclk would solve (N=384, P=4, Q=8) */
+    dmod_init(NULL);
+    CHECK(dmclk_port_plan_external(96000000U, 0, 25000000U, dmclk_bus_policy_performance, &plan) == 0);
+    stm32_plan->pllcfgr = (stm32_plan->pllcfgr & ~pll_msk)
+                        | (384U << RCC_PLLCFGR_PLLN_Pos) | (1U << RCC_PLLCFGR_PLLP_Pos) | (8U << RCC_PLLCFGR_PLLQ_Pos);
+    CHECK(dmclk_port_apply_plan(&plan) == 0);
+    CHECK(dmclk_port_get_current_frequency() == 96000000U);
+    uint32_t pll_locks = get_stats().pll_locks;
+
+    dmdrvi_context_t context = create_running(usb_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    CHECK(get_frequency(context) == 96000000U);
+    CHECK(get_stats().pll_locks == pll_locks);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_clock_tree, &tree) == 0);
+    CHECK(tree.pll_vco == 384000000U);
+    CHECK(tree.pll_q == 48000000U);
+    dmclk_dmdrvi_free(context);
+
+    /* Outside the tolerance the solved plan is applied */
+    context = create_running(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(get_stats().pll_locks == pll_locks + 1);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief ondemand waits for down_samples idle periods, then scales to the load and jumps back under load
+ */
+static void test_governor_ondemand(void)
+{
+    dmdrvi_context_t context = create_context(governor_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    notify_record_t record = { 0 };
+    dmclk_notifier_t notifier = { .callback = record_notifier, .user_data = &record };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_register_notifier, &notifier) == 0);
+    CHECK(get_frequency(context) == 216000000U);
+
+    /* A period of medium load restarts the hysteresis */
+    CHECK(feed_load(context, 20) == 0);
+    CHECK(feed_load(context, 20) == 0);
+    CHECK(feed_load(context, 50) == 0);
+    CHECK(feed_load(context, 20) == 0);
+    CHECK(feed_load(context, 20) == 0);
+    CHECK(get_target(context) == 216000000U);
+    CHECK(record.count == 0);
+
+    /* Half periods add up to one */
+    dmclk_load_sample_t half = { .busy_us = 10000U, .period_us = 50000U };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_governor_sample, &half) == 0);
+    CHECK(record.count == 0);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_governor_sample, &half) == 0);
+
+    /* 20% of 216 MHz is 54 MHz at 80% load */
+    CHECK(get_target(context) == 54000000U);
+    CHECK(get_frequency(context) == 54000000U);
+    CHECK(count_events(&record, dmclk_notify_post_change) == 1);
+
+    /* Nearly idle: the formula is clamped to governor_min_frequency */
+    for (int i = 0; i < 3; i++) {
+        CHECK(feed_load(context, 5) == 0);
+    }
+    CHECK(get_frequency(context) == 48000000U);
+    CHECK(count_events(&record, dmclk_notify_post_change) == 2);
+
+    /* One busy period goes straight back to the maximum */
+    CHECK(feed_load(context, 90) == 0);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(count_events(&record, dmclk_notify_post_change) == 3);
+    CHECK(feed_load(context, 90) == 0);
+    CHECK(count_events(&record, dmclk_notify_post_change) == 3);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief conservative moves by governor_step, powersave pins the minimum, none rejects samples
+ */
+static void test_governor_policies(void)
+{
+    dmdrvi_context_t context = create_context(governor_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    notify_record_t record = { 0 };
+    dmclk_notifier_t notifier = { .callback = record_notifier, .user_data = &record };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_register_notifier, &notifier) == 0);
+
+    dmclk_governor_t policy = dmclk_governor_conservative;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_set_governor, &policy) == 0);
+    CHECK(get_frequency(context) == 216000000U);
+
+    /* Already at the maximum */
+    CHECK(feed_load(context, 90) == 0);
+    CHECK(record.count == 0);
+
+    for (int i = 0; i < 3; i++) {
+        CHECK(get_target(context) == 216000000U);
+        CHECK(feed_load(context, 10) == 0);
+    }
+    CHECK(get_frequency(context) == 192000000U);
+    for (int i = 0; i < 3; i++) {
+        CHECK(feed_load(context, 10) == 0);
+    }
+    CHECK(get_frequency(context) == 168000000U);
+    CHECK(feed_load(context, 90) == 0);
+    CHECK(get_frequency(context) == 192000000U);
+    CHECK(count_events(&record, dmclk_notify_post_change) == 3);
+
+    policy = dmclk_governor_powersave;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_set_governor, &policy) == 0);
+    CHECK(get_frequency(context) == 48000000U);
+    CHECK(feed_load(context, 90) == 0);
+    CHECK(get_frequency(context) == 48000000U);
+    CHECK(count_events(&record, dmclk_notify_post_change) == 4);
+
+    policy = dmclk_governor_none;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_set_governor, &policy) == 0);
+    CHECK(feed_load(context, 90) == -ENOTSUP);
+    CHECK(get_frequency(context) == 48000000U);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief A QoS minimum raises the clock after an HSE failure left the operating point
+ */
+static void test_qos_after_recovery(void)
+{
+    dmdrvi_context_t context = create_context(opp_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    uint32_t opp = 0;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_set_opp, &opp) == 0);
+    CHECK(get_frequency(context) == 48000000U);
+
+    dmclk_sim_inject_hse_failure();
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_process_events, NULL) == 0);
+    CHECK(get_opp(context) == DMCLK_OPP_NONE);
+    CHECK(get_frequency(context) == 48000000U);
+
+    /* The boot target (216 MHz) equals this minimum, but it is not what runs any more */
+    dmclk_qos_request_t min = { .type = dmclk_qos_min_frequency, .frequency = 216000000U };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_add_qos_request, &min) == 0);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_remove_qos_request, &min) == 0);
+    CHECK(get_frequency(context) == 48000000U);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief STOP mode restores the retained plan without solving it again, or tells the drivers it could not
+ */
+static void test_stop_restore(void)
+{
+    dmdrvi_context_t context = create_context(board_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    notify_record_t record = { 0 };
+    dmclk_notifier_t notifier = { .callback = record_notifier, .user_data = &record };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_register_notifier, &notifier) == 0);
+    const uint16_t acr = (uint16_t)offsetof(FLASH_TypeDef, ACR);
+    const uint32_t prescalers = RCC_CFGR_HPRE_Msk | RCC_CFGR_PPRE1_Msk | RCC_CFGR_PPRE2_Msk;
+
+    dmclk_sim_stats_t before = get_stats();
+    dmclk_sim_trace_start(trace, MAX_TRACED);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_enter_stop, NULL) == 0);
+    uint32_t count = dmclk_sim_trace_stop();
+    CHECK(count <= MAX_TRACED);
+    traced = (count <= MAX_TRACED) ? (int)count : MAX_TRACED;
+    dmclk_sim_stats_t after = get_stats();
+
+    /* HSE, PLL and Over-Drive are restarted, Flash latency and prescalers were retained */
+    int cfgr_write = find_write(0, 0, dmclk_sim_block_rcc, RCC_CFGR_OFFSET, 0, 0);
+    CHECK(after.hse_startups == before.hse_startups + 1);
+    CHECK(after.pll_locks == before.pll_locks + 1);
+    CHECK(find_write(0, 0, dmclk_sim_block_flash, acr, 0, 0) < 0);
+    CHECK(find_change(dmclk_sim_block_rcc, RCC_CFGR_OFFSET, prescalers, 0, 0) < 0);
+    /* SYSCLK is switched once, straight back to the PLL */
+    CHECK(cfgr_write >= 0 && cfgr_write == find_write(0, 1, dmclk_sim_block_rcc, RCC_CFGR_OFFSET, 0, 0));
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(dmclk_port_get_current_frequency() == 216000000U);
+    CHECK(record.count == 0);
+    CHECK(after.violations == 0);
+
+    /* The PLL does not lock again after wakeup */
+    dmclk_sim_inject_pll_failure();
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_enter_stop, NULL) == -EIO);
+    CHECK(get_frequency(context) == 16000000U);
+    CHECK(record.count == 1);
+    CHECK(record.events[0] == dmclk_notify_post_change);
+    CHECK(record.data[0].old_frequency == 216000000U && record.data[0].new_frequency == 16000000U);
+
+    dmclk_sim_repair_pll();
+    CHECK(set_target(context, 216000000U) == 0);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief A target the crystal reaches on its own runs from HSE with the PLL off
+ */
+static void test_direct_hse(void)
+{
+    dmdrvi_context_t context = create_context(direct_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    uint32_t cr = dmclk_sim_read_register(dmclk_sim_block_rcc, RCC_CR_OFFSET);
+    uint32_t cfgr = dmclk_sim_read_register(dmclk_sim_block_rcc, RCC_CFGR_OFFSET);
+    CHECK((cr & RCC_CR_HSERDY) != 0);
+    CHECK((cr & (RCC_CR_PLLON | RCC_CR_PLLRDY)) == 0);
+    CHECK((cfgr & RCC_CFGR_SWS_Msk) == (RCC_CFGR_SW_HSE << RCC_CFGR_SWS_Pos));
+    CHECK((cfgr & RCC_CFGR_HPRE_Msk) == 0);
+
+    dmclk_clock_tree_t tree;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_clock_tree, &tree) == 0);
+    CHECK(tree.hclk == 25000000U);
+    CHECK(tree.pll_vco == 0);
+    CHECK(get_frequency(context) == 25000000U);
+
+    dmclk_sim_stats_t stats = get_stats();
+    CHECK(stats.hse_startups == 1);
+    CHECK(stats.pll_locks == 0);
+    CHECK(stats.violations == 0);
+
+    /* Leaving the PLL plan for the crystal stops the PLL again */
+    CHECK(set_target(context, 216000000U) == 0);
+    CHECK((dmclk_sim_read_register(dmclk_sim_block_rcc, RCC_CR_OFFSET) & RCC_CR_PLLRDY) != 0);
+    CHECK(set_target(context, 25000000U) == 0);
+    CHECK((dmclk_sim_read_register(dmclk_sim_block_rcc, RCC_CR_OFFSET) & RCC_CR_PLLON) == 0);
+    CHECK(get_frequency(context) == 25000000U);
+    CHECK(get_stats().violations == 0);
+
+    dmclk_dmdrvi_free(context);
+}
+
+/**
+ * @brief A [dmclk.plli2s] section starts PLLI2S at the requested rate, also across core changes
+ */
+static void test_plli2s(void)
+{
+    dmdrvi_context_t context = create_context(plli2s_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    uint32_t cr = dmclk_sim_read_register(dmclk_sim_block_rcc, RCC_CR_OFFSET);
+    uint32_t pllcfgr = dmclk_sim_read_register(dmclk_sim_block_rcc, RCC_PLLCFGR_OFFSET);
+    uint32_t plli2scfgr = dmclk_sim_read_register(dmclk_sim_block_rcc, RCC_PLLI2SCFGR_OFFSET);
+    uint32_t pllm = (pllcfgr & RCC_PLLCFGR_PLLM_Msk) >> RCC_PLLCFGR_PLLM_Pos;
+    uint32_t plln = (plli2scfgr & RCC_PLLxCFGR_PLLN_Msk) >> RCC_PLLxCFGR_PLLN_Pos;
+    uint32_t pllr = (plli2scfgr & RCC_PLLxCFGR_PLLR_Msk) >> RCC_PLLxCFGR_PLLR_Pos;
+    CHECK((cr & (RCC_CR_PLLI2SON | RCC_CR_PLLI2SRDY)) == (RCC_CR_PLLI2SON | RCC_CR_PLLI2SRDY));
+    CHECK(pllm != 0 && pllr != 0);
+    if (pllm != 0 && pllr != 0) {
+        CHECK((25000000U / pllm) * plln / pllr == 96000000U);
+    }
+
+    dmclk_clock_tree_t tree;
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_clock_tree, &tree) == 0);
+    CHECK(tree.i2s == 96000000U);
+    CHECK(get_frequency(context) == 216000000U);
+    CHECK(get_stats().violations == 0);
+
+    /* The I2S clock keeps its rate when the core slows down */
+    CHECK(set_target(context, 48000000U) == 0);
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_get_clock_tree, &tree) == 0);
+    CHECK(tree.i2s == 96000000U);
+    CHECK((dmclk_sim_read_register(dmclk_sim_block_rcc, RCC_CR_OFFSET) & RCC_CR_PLLI2SRDY) != 0);
+    CHECK(get_stats().violations == 0);
+    dmclk_dmdrvi_free(context);
+
+    /* Resetting the model forgets the request, plans solved without a context leave PLLI2S off */
+    dmclk_port_plan_t plan;
+    dmod_init(NULL);
+    CHECK(dmclk_port_plan_external(216000000U, 0, 25000000U, dmclk_bus_policy_performance, &plan) == 0);
+    CHECK(dmclk_port_apply_plan(&plan) == 0);
+    CHECK((dmclk_sim_read_register(dmclk_sim_block_rcc, RCC_CR_OFFSET) & RCC_CR_PLLI2SON) == 0);
+}
+
+/**
+ * @brief Check that an MCO pin is a very high speed push-pull AF0 output without pulls
+ */
+static void check_mco_pin(dmclk_sim_block_t gpio, uint32_t pin)
+{
+    CHECK(((dmclk_sim_read_register(gpio, offsetof(GPIO_TypeDef, MODER)) >> (pin * 2U)) & 0x3U) == GPIO_MODER_AF);
+    CHECK(((dmclk_sim_read_register(gpio, offsetof(GPIO_TypeDef, OSPEEDR)) >> (pin * 2U)) & 0x3U) == GPIO_OSPEEDR_VERY_HIGH);
+    CHECK(((dmclk_sim_read_register(gpio, offsetof(GPIO_TypeDef, PUPDR)) >> (pin * 2U)) & 0x3U) == 0);
+    CHECK(((dmclk_sim_read_register(gpio, offsetof(GPIO_TypeDef, OTYPER)) >> pin) & 0x1U) == 0);
+    CHECK(((dmclk_sim_read_register(gpio, offsetof(GPIO_TypeDef, AFR[1])) >> ((pin % 8U) * 4U)) & 0xFU) == GPIO_AF_MCO);
+}
+
+/**
+ * @brief [dmclk.mcoN] sections select the clock and divider in RCC_CFGR and route the pins
+ */
+static void test_mco(void)
+{
+    dmdrvi_context_t context = create_context(mco_config);
+    CHECK(context != NULL);
+    if (context == NULL) {
+        return;
+    }
+    uint32_t cfgr = dmclk_sim_read_register(dmclk_sim_block_rcc, RCC_CFGR_OFFSET);
+    uint32_t ahb1enr = dmclk_sim_read_register(dmclk_sim_block_rcc, offsetof(RCC_TypeDef, AHB1ENR));
+
+    /* Prescaler codes: 0xx = /1, 100 = /2, 101 = /3, 110 = /4 */
+    CHECK((cfgr & RCC_CFGR_MCO2_Msk) >> RCC_CFGR_MCO2_Pos == RCC_CFGR_MCO2_SYSCLK);
+    CHECK((cfgr & RCC_CFGR_MCO2PRE_Msk) >> RCC_CFGR_MCO2PRE_Pos == 6U);
+    CHECK((cfgr & RCC_CFGR_MCO1_Msk) >> RCC_CFGR_MCO1_Pos == RCC_CFGR_MCO1_HSE);
+    CHECK((cfgr & (4U << RCC_CFGR_MCO1PRE_Pos)) == 0);
+    CHECK((ahb1enr & (RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_GPIOCEN)) == (RCC_AHB1ENR_GPIOAEN | RCC_AHB1ENR_GPIOCEN));
+    check_mco_pin(dmclk_sim_block_gpioa, MCO1_PIN);
+    check_mco_pin(dmclk_sim_block_gpioc, MCO2_PIN);
+    CHECK(get_stats().violations == 0);
+
+    /* Switched off at runtime, the pin goes back to input */
+    dmclk_mco_config_t off = { .output = 2, .source = dmclk_mco_source_off, .divider = 1 };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_set_mco, &off) == 0);
+    CHECK(((dmclk_sim_read_register(dmclk_sim_block_gpioc, offsetof(GPIO_TypeDef, MODER)) >> (MCO2_PIN * 2U)) & 0x3U) == GPIO_MODER_INPUT);
+    check_mco_pin(dmclk_sim_block_gpioa, MCO1_PIN);
+
+    /* MCO1 cannot output SYSCLK */
+    dmclk_mco_config_t invalid = { .output = 1, .source = dmclk_mco_source_sysclk, .divider = 1 };
+    CHECK(dmclk_dmdrvi_ioctl(context, NULL, dmclk_ioctl_cmd_set_mco, &invalid) != 0);
+    CHECK((dmclk_sim_read_register(dmclk_sim_block_rcc, RCC_CFGR_OFFSET) & RCC_CFGR_MCO1_Msk) >> RCC_CFGR_MCO1_Pos == RCC_CFGR_MCO1_HSE);
+
+    dmclk_dmdrvi_free(context);
+}
+
+static const struct {
+    const char* name;
+    void (*run)(void);
+} tests[] = {
+    { "boot_external",      test_boot_external },
+    { "switch_frequency",   test_switch_frequency },
+    { "hse_failure",        test_hse_failure },
+    { "trace_order",        test_trace_order },
+    { "notifier_veto",      test_notifier_veto },
+    { "qos_limits",         test_qos_limits },
+    { "qos_vetoed",         test_qos_vetoed },
+    { "write_command",      test_write_command },
+    { "async_complete",     test_async_complete },
+    { "async_immediate",    test_async_immediate },
+    { "async_cancel",       test_async_cancel },
+    { "async_hse_failure",  test_async_hse_failure },
+    { "async_timeout",      test_async_timeout },
+    { "early_init",         test_early_init },
+    { "port_apply_failure", test_port_apply_failure },
+    { "configure_failure",  test_configure_failure },
+    { "async_status_read",  test_async_status_read },
+    { "adopt_exact",        test_adopt_exact },
+    { "adopt_tolerance",    test_adopt_tolerance },
+    { "governor_ondemand",  test_governor_ondemand },
+    { "governor_policies",  test_governor_policies },
+    { "qos_after_recovery", test_qos_after_recovery },
+    { "stop_restore",       test_stop_restore },
+    { "direct_hse",         test_direct_hse },
+    { "plli2s",             test_plli2s },
+    { "mco",                test_mco },
+};
+
+int main(int argc, char** argv)
+{
+    int found = 0;
+
+    for (size_t i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+        if (argc > 1 && strcmp(argv[1], tests[i].name) != 0) {
+            continue;
+        }
+        found = 1;
+        int before = failures;
+        tests[i].run();
+        printf("%-24s %s\n", tests[i].name, (failures == before) ? "ok" : "FAILED");
+    }
+    if (!found) {
+        fprintf(stderr, "Unknown test %s\n", argv[1]);
+        return 2;
+    }
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+#ifndef DMCLK_DEFS_H
+#define DMCLK_DEFS_H
+
+/**
+ * @brief Host stand-in for the DMOD generated dmclk API definitions
+ *
+ * Declares the driver interface of dmclk.c for the tests.
+ */
+
+#include <stddef.h>
+#include "dmdrvi.h"
+
+dmdrvi_context_t dmclk_dmdrvi_create(dmini_context_t config, dmdrvi_dev_num_t* dev_num);
+void dmclk_dmdrvi_free(dmdrvi_context_t context);
+void* dmclk_dmdrvi_open(dmdrvi_context_t context, int flags);
+void dmclk_dmdrvi_close(dmdrvi_context_t context, void* handle);
+size_t dmclk_dmdrvi_read(dmdrvi_context_t context, void* handle, void* buffer, size_t size, uint32_t offset);
+size_t dmclk_dmdrvi_write(dmdrvi_context_t context, void* handle, const void* buffer, size_t size, uint32_t offset);
+int dmclk_dmdrvi_ioctl(dmdrvi_context_t context, void* handle, int command, void* arg);
+int dmclk_dmdrvi_flush(dmdrvi_context_t context, void* handle);
+int dmclk_dmdrvi_stat(dmdrvi_context_t context, const char* path, dmdrvi_stat_t* stat);
+
+#endif // DMCLK_DEFS_H
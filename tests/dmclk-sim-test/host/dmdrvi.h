@@ -0,0 +1,36 @@
+#ifndef DMDRVI_H
+#define DMDRVI_H
+
+/**
+ * @brief Host stand-in for the dmdrvi interface
+ *
+ * Driver interface functions become plain C functions named dmclk_dmdrvi<name>.
+ */
+
+#include <stdint.h>
+#include "dmini.h"
+
+typedef struct dmdrvi_context* dmdrvi_context_t;
+
+typedef struct
+{
+    uint32_t major;
+    uint32_t minor;
+    uint32_t flags;
+} dmdrvi_dev_num_t;
+
+typedef struct
+{
+    uint32_t size;
+    uint32_t mode;
+} dmdrvi_stat_t;
+
+#define DMDRVI_NUM_NONE     0
+
+#define DMDRVI_O_RDONLY     0x01
+#define DMDRVI_O_WRONLY     0x02
+#define DMDRVI_O_RDWR       0x03
+
+#define dmod_dmdrvi_dif_api_declaration(VERSION, MODULE, RET, NAME, ARGS)   RET MODULE##_dmdrvi##NAME ARGS
+
+#endif // DMDRVI_H
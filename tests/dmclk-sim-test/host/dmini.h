@@ -0,0 +1,19 @@
+#ifndef DMINI_H
+#define DMINI_H
+
+/**
+ * @brief Host stand-in for the dmini API
+ *
+ * Implemented in host.c on top of a minimal ini reader, with the lookups dmclk
+ * uses. Configurations are parsed from strings, so each test carries its own.
+ */
+
+typedef struct dmini_context* dmini_context_t;
+
+dmini_context_t dmini_parse_string(const char* text);
+void dmini_free(dmini_context_t ctx);
+
+int dmini_get_int(dmini_context_t ctx, const char* section, const char* key, int default_value);
+const char* dmini_get_string(dmini_context_t ctx, const char* section, const char* key, const char* default_value);
+
+#endif // DMINI_H
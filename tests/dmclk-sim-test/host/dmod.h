@@ -0,0 +1,38 @@
+#ifndef DMOD_H
+#define DMOD_H
+
+/**
+ * @brief Host stand-in for the DMOD API
+ *
+ * The tests link dmclk.c, the common STM32 port and the simulation port into
+ * one host executable, without the DMOD runtime. Only what they use is
+ * provided, implemented in host.c.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct
+{
+    int unused;
+} Dmod_Config_t;
+
+void* Dmod_Malloc(size_t size);
+void Dmod_Free(void* ptr);
+int Dmod_Printf(const char* format, ...);
+int Dmod_SnPrintf(char* buffer, size_t size, const char* format, ...);
+
+void Dmod_EnterCritical(void);
+void Dmod_ExitCritical(void);
+
+void* Dmod_Mutex_New(bool recursive);
+int Dmod_Mutex_Lock(void* mutex);
+void Dmod_Mutex_Unlock(void* mutex);
+void Dmod_Mutex_Delete(void* mutex);
+
+#define DMOD_LOG_ERROR(...)     fprintf(stderr, __VA_ARGS__)
+#define DMOD_LOG_INFO(...)      do { } while (0)
+
+#endif // DMOD_H
@@ -0,0 +1,189 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "dmod.h"
+#include "dmini.h"
+
+/*
+ * Host implementation of the DMOD and dmini stand-ins
+ *
+ * Everything runs in one thread. The mutex is not recursive and never blocks:
+ * locking it twice fails like a timed-out lock on the target, so a callback
+ * calling back into dmclk with the writer lock held shows up as an error
+ * instead of a hang. host_mutex_failures() counts them, for the commands that
+ * would swallow the error.
+ */
+
+#define HOST_INI_MAX_ENTRIES    128
+#define HOST_INI_MAX_NAME       48
+#define HOST_INI_MAX_VALUE      48
+
+struct host_mutex
+{
+    int locked;
+};
+
+struct dmini_entry
+{
+    char section[HOST_INI_MAX_NAME];
+    char key[HOST_INI_MAX_NAME];
+    char value[HOST_INI_MAX_VALUE];
+};
+
+struct dmini_context
+{
+    struct dmini_entry entries[HOST_INI_MAX_ENTRIES];
+    int count;
+};
+
+static int critical_depth = 0;
+static int mutex_failures = 0;
+
+void* Dmod_Malloc(size_t size)
+{
+    return malloc(size);
+}
+
+void Dmod_Free(void* ptr)
+{
+    free(ptr);
+}
+
+int Dmod_Printf(const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int ret = vprintf(format, args);
+    va_end(args);
+    return ret;
+}
+
+int Dmod_SnPrintf(char* buffer, size_t size, const char* format, ...)
+{
+    va_list args;
+    va_start(args, format);
+    int ret = vsnprintf(buffer, size, format, args);
+    va_end(args);
+    return ret;
+}
+
+void Dmod_EnterCritical(void)
+{
+    critical_depth++;
+}
+
+void Dmod_ExitCritical(void)
+{
+    if (--critical_depth < 0) {
+        fprintf(stderr, "Dmod_ExitCritical() without Dmod_EnterCritical()\n");
+        abort();
+    }
+}
+
+void* Dmod_Mutex_New(bool recursive)
+{
+    return calloc(1, sizeof(struct host_mutex));
+}
+
+int Dmod_Mutex_Lock(void* mutex)
+{
+    struct host_mutex* m = (struct host_mutex*)mutex;
+    if (m->locked) {
+        mutex_failures++;
+        return -1;
+    }
+    m->locked = 1;
+    return 0;
+}
+
+/**
+ * @brief Number of mutex locks that would have blocked on the target
+ */
+int host_mutex_failures(void)
+{
+    return mutex_failures;
+}
+
+void Dmod_Mutex_Unlock(void* mutex)
+{
+    ((struct host_mutex*)mutex)->locked = 0;
+}
+
+void Dmod_Mutex_Delete(void* mutex)
+{
+    free(mutex);
+}
+
+/**
+ * @brief Copy a token without surrounding blanks
+ */
+static void copy_trimmed(char* dst, size_t size, const char* begin, const char* end)
+{
+    while (begin < end && (*begin == ' ' || *begin == '\t')) {
+        begin++;
+    }
+    while (end > begin && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+        end--;
+    }
+    size_t length = (size_t)(end - begin);
+    if (length >= size) {
+        length = size - 1;
+    }
+    memcpy(dst, begin, length);
+    dst[length] = '\0';
+}
+
+dmini_context_t dmini_parse_string(const char* text)
+{
+    struct dmini_context* ctx = calloc(1, sizeof(*ctx));
+    char section[HOST_INI_MAX_NAME] = "";
+
+    while (ctx != NULL && text != NULL && *text != '\0') {
+        const char* end = strchr(text, '\n');
+        if (end == NULL) {
+            end = text + strlen(text);
+        }
+        const char* equals = memchr(text, '=', (size_t)(end - text));
+        const char* start = text;
+        while (start < end && (*start == ' ' || *start == '\t')) {
+            start++;
+        }
+
+        if (start < end && *start == '[') {
+            const char* close = memchr(start, ']', (size_t)(end - start));
+            if (close != NULL) {
+                copy_trimmed(section, sizeof(section), start + 1, close);
+            }
+        } else if (start < end && *start != ';' && *start != '#' && equals != NULL
+                && ctx->count < HOST_INI_MAX_ENTRIES) {
+            struct dmini_entry* entry = &ctx->entries[ctx->count++];
+            strcpy(entry->section, section);
+            copy_trimmed(entry->key, sizeof(entry->key), start, equals);
+            copy_trimmed(entry->value, sizeof(entry->value), equals + 1, end);
+        }
+        text = (*end == '\n') ? end + 1 : end;
+    }
+    return ctx;
+}
+
+void dmini_free(dmini_context_t ctx)
+{
+    free(ctx);
+}
+
+const char* dmini_get_string(dmini_context_t ctx, const char* section, const char* key, const char* default_value)
+{
+    for (int i = 0; ctx != NULL && i < ctx->count; i++) {
+        if (strcmp(ctx->entries[i].section, section) == 0 && strcmp(ctx->entries[i].key, key) == 0) {
+            return ctx->entries[i].value;
+        }
+    }
+    return default_value;
+}
+
+int dmini_get_int(dmini_context_t ctx, const char* section, const char* key, int default_value)
+{
+    const char* value = dmini_get_string(ctx, section, key, NULL);
+    return (value != NULL) ? (int)strtol(value, NULL, 0) : default_value;
+}
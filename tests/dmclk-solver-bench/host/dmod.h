@@ -0,0 +1,18 @@
+#ifndef DMOD_H
+#define DMOD_H
+
+/**
+ * @brief Host stand-in for the DMOD API
+ *
+ * The solver benchmark links stm32_common.c straight into a host executable,
+ * without the DMOD runtime. Only what the common code uses is provided.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+void Dmod_EnterCritical(void);
+void Dmod_ExitCritical(void);
+
+#endif // DMOD_H
@@ -0,0 +1,395 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "dmclk_port.h"
+#include "stm32_common/stm32_common.h"
+#include "port/stm32_common_regs.h"
+#include "port/stm32f4_regs.h"
+#include "port/stm32f7_regs.h"
+
+/**
+ * @brief Host benchmark of the STM32 PLL solver and planning path
+ *
+ * For every family, oscillator (HSI plus each oscillator_frequency found in
+ * the ini files given on the command line) and tolerance, every target from
+ * --step up to max_sysclk is solved with stm32_calculate_pll_config() and
+ * planned with stm32_plan_clock(). Results are checked against an exhaustive
+ * search over all PLLM/PLLN/PLLP combinations using exact arithmetic, and one
+ * CSV row per family/oscillator/tolerance is written to stdout.
+ *
+ * Exit code is non-zero when a result violates the limits or the tolerance,
+ * and with --strict also when the solver misses a reachable target.
+ */
+
+#define BENCH_DEFAULT_STEP      1000000U
+#define BENCH_DEFAULT_REPEAT    8U
+#define BENCH_MAX_OSCILLATORS   16U
+
+typedef struct {
+    const char *name;
+    clock_limits_t limits;
+} bench_family_t;
+
+static const bench_family_t bench_families[] = {
+    {
+        .name = "stm32f4",
+        .limits = {
+            .max_sysclk = STM32F4_MAX_SYSCLK,
+            .max_hclk = STM32F4_MAX_HCLK,
+            .max_pclk1 = STM32F4_MAX_PCLK1,
+            .max_pclk2 = STM32F4_MAX_PCLK2,
+            .vco_min = STM32F4_VCO_MIN,
+            .vco_max = STM32F4_VCO_MAX,
+            .pll_in_min = STM32F4_PLL_IN_MIN,
+            .pll_in_max = STM32F4_PLL_IN_MAX,
+            .pllm_min = STM32F4_PLLM_MIN,
+            .pllm_max = STM32F4_PLLM_MAX,
+            .plln_min = STM32F4_PLLN_MIN,
+            .plln_max = STM32F4_PLLN_MAX,
+            .pllp_min = STM32F4_PLLP_MIN,
+            .pllp_max = STM32F4_PLLP_MAX,
+            .max_sysclk_no_overdrive = 0,
+            .vos_msk = STM32F4_PWR_VOS_Msk,
+            .vos_performance = STM32F4_PWR_VOS_PERFORMANCE,
+            .vos_low_power = STM32F4_PWR_VOS_LOW_POWER,
+            .flash_latency_table = stm32f4_flash_latency,
+            .flash_latency_count = STM32F4_FLASH_LATENCY_COUNT,
+        },
+    },
+    {
+        .name = "stm32f7",
+        .limits = {
+            .max_sysclk = STM32F7_MAX_SYSCLK,
+            .max_hclk = STM32F7_MAX_HCLK,
+            .max_pclk1 = STM32F7_MAX_PCLK1,
+            .max_pclk2 = STM32F7_MAX_PCLK2,
+            .vco_min = STM32F7_VCO_MIN,
+            .vco_max = STM32F7_VCO_MAX,
+            .pll_in_min = STM32F7_PLL_IN_MIN,
+            .pll_in_max = STM32F7_PLL_IN_MAX,
+            .pllm_min = STM32F7_PLLM_MIN,
+            .pllm_max = STM32F7_PLLM_MAX,
+            .plln_min = STM32F7_PLLN_MIN,
+            .plln_max = STM32F7_PLLN_MAX,
+            .pllp_min = STM32F7_PLLP_MIN,
+            .pllp_max = STM32F7_PLLP_MAX,
+            .max_sysclk_no_overdrive = STM32F7_MAX_SYSCLK_NO_OVERDRIVE,
+            .vos_msk = STM32F7_PWR_VOS_Msk,
+            .vos_performance = STM32F7_PWR_VOS_PERFORMANCE,
+            .vos_low_power = STM32F7_PWR_VOS_LOW_POWER,
+            .flash_latency_table = stm32f7_flash_latency,
+            .flash_latency_count = STM32F7_FLASH_LATENCY_COUNT,
+        },
+    },
+};
+
+static const uint32_t bench_tolerances[] = { 0U, 1000U, 100000U, 1000000U };
+
+/* AHB prescaler divisors available to direct (PLL-less) plans */
+static const uint32_t bench_ahb_divisors[] = { 1, 2, 4, 8, 16, 64, 128, 256, 512 };
+
+/**
+ * @brief Result of the exhaustive reference search for one target
+ */
+typedef struct {
+    uint64_t pll_error;     /* Smallest PLL error in Hz, rounded up */
+    uint64_t direct_error;  /* Smallest error of a divided oscillator in Hz */
+} bench_reference_t;
+
+/**
+ * @brief Counters of one CSV row
+ */
+typedef struct {
+    uint32_t targets;
+    uint32_t pll_hits;
+    uint32_t pll_reference_hits;
+    uint32_t pll_misses;
+    uint32_t pll_suboptimal;
+    uint32_t pll_invalid;
+    uint64_t pll_worst_error;
+    uint64_t pll_ns_total;
+    uint64_t pll_ns_max;
+    uint64_t pll_calls;
+    uint32_t plan_hits;
+    uint32_t plan_reference_hits;
+    uint32_t plan_misses;
+    uint32_t plan_invalid;
+    uint64_t plan_ns_total;
+    uint64_t plan_ns_max;
+    uint64_t plan_calls;
+} bench_row_t;
+
+void Dmod_EnterCritical(void)
+{
+}
+
+void Dmod_ExitCritical(void)
+{
+}
+
+/**
+ * @brief Monotonic time in nanoseconds
+ */
+static uint64_t bench_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Error of source * N / (M * P) against the target in Hz, rounded up
+ */
+static uint64_t bench_pll_error(uint32_t source, uint32_t pllm, uint32_t plln, uint32_t pllp, uint32_t target)
+{
+    uint64_t numerator = (uint64_t)source * plln;
+    uint64_t scaled_target = (uint64_t)target * pllm * pllp;
+    uint64_t difference = (numerator > scaled_target) ? numerator - scaled_target : scaled_target - numerator;
+    uint64_t divisor = (uint64_t)pllm * pllp;
+    return (difference + divisor - 1U) / divisor;
+}
+
+/**
+ * @brief Check a PLL configuration against the limits of the family
+ */
+static int bench_pll_valid(uint32_t source, const pll_config_t *config, const clock_limits_t *limits)
+{
+    if (config->pllm < limits->pllm_min || config->pllm > limits->pllm_max
+     || config->plln < limits->plln_min || config->plln > limits->plln_max
+     || config->pllp < limits->pllp_min || config->pllp > limits->pllp_max || (config->pllp & 1U)) {
+        return 0;
+    }
+
+    /* Exact comparisons: source / M and source * N / M are not always integers */
+    uint64_t pllm = config->pllm;
+    if ((uint64_t)source < (uint64_t)limits->pll_in_min * pllm || (uint64_t)source > (uint64_t)limits->pll_in_max * pllm) {
+        return 0;
+    }
+    uint64_t vco_scaled = (uint64_t)source * config->plln;
+    if (vco_scaled < (uint64_t)limits->vco_min * pllm || vco_scaled > (uint64_t)limits->vco_max * pllm) {
+        return 0;
+    }
+    return 1;
+}
+
+/**
+ * @brief Exhaustive search for the smallest achievable error
+ */
+static void bench_reference(uint32_t source, uint32_t target, const clock_limits_t *limits, bench_reference_t *reference)
+{
+    reference->pll_error = UINT64_MAX;
+    reference->direct_error = UINT64_MAX;
+
+    for (uint32_t pllm = limits->pllm_min; pllm <= limits->pllm_max; pllm++) {
+        for (uint32_t pllp = limits->pllp_min; pllp <= limits->pllp_max; pllp += 2U) {
+            for (uint32_t plln = limits->plln_min; plln <= limits->plln_max; plln++) {
+                pll_config_t config = { .pllm = pllm, .plln = plln, .pllp = pllp };
+                if (!bench_pll_valid(source, &config, limits)) {
+                    continue;
+                }
+                uint64_t error = bench_pll_error(source, pllm, plln, pllp, target);
+                if (error < reference->pll_error) {
+                    reference->pll_error = error;
+                }
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < sizeof(bench_ahb_divisors) / sizeof(bench_ahb_divisors[0]); i++) {
+        uint32_t hclk = source / bench_ahb_divisors[i];
+        uint64_t error = (hclk > target) ? hclk - target : target - hclk;
+        if (error < reference->direct_error) {
+            reference->direct_error = error;
+        }
+    }
+}
+
+/**
+ * @brief Solve and plan one target and update the row counters
+ */
+static void bench_target(const bench_family_t *family, uint32_t oscillator, uint32_t tolerance,
+                         uint32_t target, const bench_reference_t *reference, uint32_t repeat, bench_row_t *row)
+{
+    uint32_t source = (oscillator != 0U) ? oscillator : HSI_VALUE;
+    pll_config_t config;
+    uint32_t actual = 0;
+    dmclk_port_plan_t plan;
+    int pll_ret = -1;
+    int plan_ret = -1;
+
+    for (uint32_t i = 0; i < repeat; i++) {
+        uint64_t start = bench_now_ns();
+        pll_ret = stm32_calculate_pll_config(target, tolerance, source, &family->limits, &config, &actual);
+        uint64_t elapsed = bench_now_ns() - start;
+        row->pll_ns_total += elapsed;
+        row->pll_calls++;
+        if (elapsed > row->pll_ns_max) {
+            row->pll_ns_max = elapsed;
+        }
+
+        start = bench_now_ns();
+        plan_ret = stm32_plan_clock(target, tolerance, oscillator, &family->limits,
+                                    dmclk_bus_policy_performance, NULL, &plan);
+        elapsed = bench_now_ns() - start;
+        row->plan_ns_total += elapsed;
+        row->plan_calls++;
+        if (elapsed > row->plan_ns_max) {
+            row->plan_ns_max = elapsed;
+        }
+    }
+
+    row->targets++;
+
+    int pll_reachable = reference->pll_error <= tolerance;
+    if (pll_reachable) {
+        row->pll_reference_hits++;
+    }
+    if (pll_ret == 0) {
+        row->pll_hits++;
+        uint64_t error = bench_pll_error(source, config.pllm, config.plln, config.pllp, target);
+        if (!bench_pll_valid(source, &config, &family->limits) || error > tolerance) {
+            row->pll_invalid++;
+            fprintf(stderr, "%s: invalid PLL result for %u Hz from %u Hz (tolerance %u): M=%u N=%u P=%u, error %llu Hz\n",
+                    family->name, target, source, tolerance, config.pllm, config.plln, config.pllp,
+                    (unsigned long long)error);
+        } else if (error > reference->pll_error) {
+            row->pll_suboptimal++;
+        }
+        if (error > row->pll_worst_error) {
+            row->pll_worst_error = error;
+        }
+    } else if (pll_reachable) {
+        row->pll_misses++;
+    }
+
+    int plan_reachable = pll_reachable || reference->direct_error <= tolerance;
+    if (plan_reachable) {
+        row->plan_reference_hits++;
+    }
+    if (plan_ret == 0) {
+        row->plan_hits++;
+        const stm32_plan_t *stm32_plan = STM32_PLAN_CONST(&plan);
+        uint64_t error = (stm32_plan->hclk > target) ? stm32_plan->hclk - target : target - stm32_plan->hclk;
+        if (error > tolerance || stm32_plan->hclk > family->limits.max_hclk) {
+            row->plan_invalid++;
+            fprintf(stderr, "%s: invalid plan for %u Hz from %u Hz (tolerance %u): HCLK %u Hz\n",
+                    family->name, target, source, tolerance, stm32_plan->hclk);
+        }
+    } else if (plan_reachable) {
+        row->plan_misses++;
+    }
+}
+
+/**
+ * @brief Hit rate, 1 when nothing was reachable
+ */
+static double bench_rate(uint32_t hits, uint32_t reachable)
+{
+    return (reachable != 0U) ? (double)hits / (double)reachable : 1.0;
+}
+
+/**
+ * @brief Add the oscillator_frequency values of an ini file to the list
+ */
+static void bench_read_oscillators(const char *path, uint32_t *oscillators, uint32_t *count)
+{
+    FILE *file = fopen(path, "r");
+    char line[256];
+
+    if (file == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL) {
+        unsigned long value;
+        if (sscanf(line, " oscillator_frequency = %lu", &value) != 1 || value == 0U) {
+            continue;
+        }
+        uint32_t i;
+        for (i = 0; i < *count && oscillators[i] != (uint32_t)value; i++) {
+        }
+        if (i == *count && *count < BENCH_MAX_OSCILLATORS) {
+            oscillators[(*count)++] = (uint32_t)value;
+        }
+    }
+    fclose(file);
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t step = BENCH_DEFAULT_STEP;
+    uint32_t repeat = BENCH_DEFAULT_REPEAT;
+    int strict = 0;
+    uint32_t oscillators[BENCH_MAX_OSCILLATORS] = { 0 };   /* 0 = HSI */
+    uint32_t oscillator_count = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+            step = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            repeat = (uint32_t)strtoul(argv[++i], NULL, 0);
+        } else if (strcmp(argv[i], "--strict") == 0) {
+            strict = 1;
+        } else {
+            bench_read_oscillators(argv[i], oscillators, &oscillator_count);
+        }
+    }
+    if (step == 0U || repeat == 0U) {
+        fprintf(stderr, "Usage: %s [--step HZ] [--repeat N] [--strict] [config.ini ...]\n", argv[0]);
+        return 2;
+    }
+
+    printf("family,oscillator_hz,tolerance_hz,targets,"
+           "pll_hits,pll_reference_hits,pll_hit_rate,pll_misses,pll_suboptimal,pll_invalid,pll_worst_error_hz,pll_avg_ns,pll_max_ns,"
+           "plan_hits,plan_reference_hits,plan_hit_rate,plan_misses,plan_invalid,plan_avg_ns,plan_max_ns\n");
+
+    uint32_t invalid = 0;
+    uint32_t misses = 0;
+    const uint32_t tolerance_count = sizeof(bench_tolerances) / sizeof(bench_tolerances[0]);
+
+    for (uint32_t f = 0; f < sizeof(bench_families) / sizeof(bench_families[0]); f++) {
+        const bench_family_t *family = &bench_families[f];
+
+        for (uint32_t o = 0; o < oscillator_count; o++) {
+            uint32_t source = (oscillators[o] != 0U) ? oscillators[o] : HSI_VALUE;
+            bench_row_t rows[sizeof(bench_tolerances) / sizeof(bench_tolerances[0])];
+            memset(rows, 0, sizeof(rows));
+
+            /* The reference does not depend on the tolerance - search once per target */
+            for (uint32_t target = step; target <= family->limits.max_sysclk; target += step) {
+                bench_reference_t reference;
+                bench_reference(source, target, &family->limits, &reference);
+                for (uint32_t t = 0; t < tolerance_count; t++) {
+                    bench_target(family, oscillators[o], bench_tolerances[t], target, &reference, repeat, &rows[t]);
+                }
+            }
+
+            for (uint32_t t = 0; t < tolerance_count; t++) {
+                const bench_row_t *row = &rows[t];
+                printf("%s,%u,%u,%u,%u,%u,%.4f,%u,%u,%u,%llu,%.1f,%llu,%u,%u,%.4f,%u,%u,%.1f,%llu\n",
+                       family->name, source, bench_tolerances[t], row->targets,
+                       row->pll_hits, row->pll_reference_hits, bench_rate(row->pll_hits, row->pll_reference_hits),
+                       row->pll_misses, row->pll_suboptimal, row->pll_invalid,
+                       (unsigned long long)row->pll_worst_error,
+                       (double)row->pll_ns_total / (double)row->pll_calls, (unsigned long long)row->pll_ns_max,
+                       row->plan_hits, row->plan_reference_hits, bench_rate(row->plan_hits, row->plan_reference_hits),
+                       row->plan_misses, row->plan_invalid,
+                       (double)row->plan_ns_total / (double)row->plan_calls, (unsigned long long)row->plan_ns_max);
+                invalid += row->pll_invalid + row->plan_invalid;
+                misses += row->pll_misses + row->plan_misses;
+            }
+        }
+    }
+
+    if (invalid != 0U) {
+        fprintf(stderr, "%u results violate the limits or the tolerance\n", invalid);
+        return 1;
+    }
+    if (strict && misses != 0U) {
+        fprintf(stderr, "%u reachable targets missed\n", misses);
+        return 1;
+    }
+    return 0;
+}
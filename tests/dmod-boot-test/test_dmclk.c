@@ -159,6 +159,22 @@ int test_dmclk_main(int argc, char* argv[])
         }
     }
     
+    Dmod_Printf("\n--- Binary Record ---\n");
+    void* binary_handle = dmclk_dmdrvi_open(clk_ctx, DMDRVI_O_RDONLY | DMCLK_O_BINARY);
+    dmclk_info_t info;
+    if (binary_handle != NULL
+     && dmclk_dmdrvi_read(clk_ctx, binary_handle, &info, sizeof(info), 0) == sizeof(info)
+     && info.version == DMCLK_INFO_VERSION)
+    {
+        Dmod_Printf("Generation: %u, frequency: %u Hz, clock changes: %u\n",
+                   (unsigned int)info.generation, (unsigned int)info.frequency, (unsigned int)info.clock_changes);
+    }
+    else
+    {
+        Dmod_Printf("Failed to read the binary record\n");
+    }
+    dmclk_dmdrvi_close(clk_ctx, binary_handle);
+    
     Dmod_Printf("\n--- Test: Change clock to internal 16 MHz ---\n");
     dmclk_frequency_t new_target = 16000000;
     dmclk_source_t new_source = dmclk_source_internal;
@@ -0,0 +1,72 @@
+# ======================================================================
+#               Footprint report
+# ======================================================================
+# Adds the targets
+#   footprint           - report of dmclk and dmclk_port, fails when a module
+#                         section or the stack depth of configure() grew
+#                         beyond DMCLK_FOOTPRINT_TOLERANCE bytes compared with
+#                         DMCLK_FOOTPRINT_BASELINE, or when that is missing
+#                         and DMCLK_FOOTPRINT_REQUIRE_BASELINE is set
+#   footprint_baseline  - stores the current report as that baseline
+#
+if(DMCLK_STATIC_CONFIG)
+    set(DMCLK_FOOTPRINT_DEFAULT_NAME "${DMCLK_MCU_SERIES}-static")
+else()
+    set(DMCLK_FOOTPRINT_DEFAULT_NAME "${DMCLK_MCU_SERIES}")
+endif()
+set(DMCLK_FOOTPRINT_NAME        "${DMCLK_FOOTPRINT_DEFAULT_NAME}" CACHE STRING "Port and feature set the footprint baseline is stored under")
+set(DMCLK_FOOTPRINT_TOLERANCE   0 CACHE STRING "Allowed growth in bytes per module section and stack depth")
+set(DMCLK_FOOTPRINT_BASELINE    "${CMAKE_CURRENT_LIST_DIR}/baseline/${DMCLK_FOOTPRINT_NAME}.json" CACHE FILEPATH "Baseline report the footprint is compared with")
+option(DMCLK_FOOTPRINT_REQUIRE_BASELINE "Fail the footprint target when the baseline is missing" OFF)
+
+set(DMCLK_FOOTPRINT_REQUIRE "")
+if(DMCLK_FOOTPRINT_REQUIRE_BASELINE)
+    set(DMCLK_FOOTPRINT_REQUIRE --require-baseline)
+endif()
+
+find_package(Python3 COMPONENTS Interpreter)
+if(NOT Python3_Interpreter_FOUND)
+    message(WARNING "Python 3 not found - footprint targets are not available")
+    return()
+endif()
+
+include(CheckCCompilerFlag)
+check_c_compiler_flag(-fstack-usage DMCLK_HAS_STACK_USAGE)
+check_c_compiler_flag(-fcallgraph-info=su DMCLK_HAS_CALLGRAPH_INFO)
+
+foreach(DMCLK_FOOTPRINT_TARGET dmclk dmclk_port)
+    if(DMCLK_HAS_STACK_USAGE)
+        target_compile_options(${DMCLK_FOOTPRINT_TARGET} PRIVATE -fstack-usage)
+    endif()
+    # Call graphs turn the frame of configure() into its worst-case depth (GCC 10+)
+    if(DMCLK_HAS_CALLGRAPH_INFO)
+        target_compile_options(${DMCLK_FOOTPRINT_TARGET} PRIVATE -fcallgraph-info=su)
+    endif()
+endforeach()
+
+set(DMCLK_FOOTPRINT_COMMAND
+    ${Python3_EXECUTABLE} ${CMAKE_CURRENT_LIST_DIR}/footprint.py
+    --nm ${CMAKE_NM}
+    --objdump ${CMAKE_OBJDUMP}
+    --name ${DMCLK_FOOTPRINT_NAME}
+    --module dmclk=$<JOIN:$<TARGET_OBJECTS:dmclk>,$<COMMA>>
+    --module dmclk_port=$<JOIN:$<TARGET_OBJECTS:dmclk_port>,$<COMMA>>
+    --stack configure
+    --baseline ${DMCLK_FOOTPRINT_BASELINE}
+    --tolerance ${DMCLK_FOOTPRINT_TOLERANCE}
+    --output ${CMAKE_BINARY_DIR}/footprint.json
+)
+
+add_custom_target(footprint
+    COMMAND ${DMCLK_FOOTPRINT_COMMAND} ${DMCLK_FOOTPRINT_REQUIRE}
+    DEPENDS dmclk dmclk_port
+    COMMENT "Footprint of ${DMCLK_FOOTPRINT_NAME}"
+    VERBATIM
+)
+
+add_custom_target(footprint_baseline
+    COMMAND ${DMCLK_FOOTPRINT_COMMAND} --write-baseline
+    DEPENDS dmclk dmclk_port
+    COMMENT "Writing the footprint baseline of ${DMCLK_FOOTPRINT_NAME}"
+    VERBATIM
+)
@@ -0,0 +1,281 @@
+#!/usr/bin/env python3
+"""Code size, RAM and stack footprint of the dmclk modules.
+
+Reads the object files of each module and reports:
+  - .text, .rodata, .data and .bss totals per module (objdump -h)
+  - the size of every function and object in them (nm -S)
+  - the worst-case stack depth of the given roots (-fstack-usage and,
+    when available, -fcallgraph-info call graphs)
+
+With --baseline the report is compared with a checked-in report and the
+script fails when a module section or a root stack depth grew by more than
+--tolerance bytes. --write-baseline stores the report as the new baseline.
+A missing baseline only prints a hint, unless --require-baseline is given
+(CI), which makes it a failure.
+
+Usage (normally through the footprint targets, see tools/footprint/README.md):
+  footprint.py --nm NM --objdump OBJDUMP --name stm32f7
+               --module dmclk=a.obj,b.obj --module dmclk_port=c.obj
+               [--stack configure] [--baseline FILE] [--write-baseline]
+               [--require-baseline] [--tolerance BYTES] [--output FILE]
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+SECTIONS = ("text", "rodata", "data", "bss")
+
+# nm symbol type -> section
+SYMBOL_SECTIONS = {
+    "t": "text", "w": "text",
+    "r": "rodata",
+    "d": "data", "g": "data",
+    "b": "bss", "c": "bss", "s": "bss",
+}
+
+VCG_NODE = re.compile(r'node:\s*\{\s*title:\s*"([^"]+)"\s*label:\s*"([^"]*)"')
+VCG_EDGE = re.compile(r'edge:\s*\{\s*sourcename:\s*"([^"]+)"\s*targetname:\s*"([^"]+)"')
+VCG_STACK = re.compile(r'\\n(\d+) bytes \((static|dynamic|dynamic,bounded)\)')
+
+
+def run(tool, *args):
+    return subprocess.run([tool, *args], check=True, capture_output=True, text=True).stdout
+
+
+def section_of(name):
+    name = name.lstrip(".")
+    for section in SECTIONS:
+        if name == section or name.startswith(section + "."):
+            return section
+    # .sdata/.sbss on some targets
+    if name.startswith("sdata"):
+        return "data"
+    if name.startswith("sbss"):
+        return "bss"
+    return None
+
+
+def section_totals(objdump, objects):
+    totals = dict.fromkeys(SECTIONS, 0)
+    for obj in objects:
+        for line in run(objdump, "-h", obj).splitlines():
+            fields = line.split()
+            if len(fields) >= 3 and fields[0].isdigit():
+                section = section_of(fields[1])
+                if section is not None:
+                    totals[section] += int(fields[2], 16)
+    return totals
+
+
+def symbols(nm, objects):
+    result = {section: {} for section in SECTIONS}
+    for obj in objects:
+        for line in run(nm, "-S", "--size-sort", obj).splitlines():
+            fields = line.split()
+            if len(fields) != 4:
+                continue
+            section = SYMBOL_SECTIONS.get(fields[2].lower())
+            if section is None:
+                continue
+            table = result[section]
+            table[fields[3]] = table.get(fields[3], 0) + int(fields[1], 16)
+    return result
+
+
+def aux_file(obj, extension):
+    """GCC names -fstack-usage/-fcallgraph-info outputs after the object file."""
+    return os.path.splitext(obj)[0] + extension
+
+
+def strip_file(title):
+    # Static functions are titled "file.c:name"
+    return title.rsplit(":", 1)[-1]
+
+
+def load_call_graph(objects):
+    frames = {}
+    edges = {}
+    for obj in objects:
+        su = aux_file(obj, ".su")
+        if os.path.exists(su):
+            with open(su) as f:
+                for line in f:
+                    fields = line.rstrip("\n").split("\t")
+                    if len(fields) == 3:
+                        name = fields[0].rsplit(":", 1)[-1]
+                        frames[name] = max(frames.get(name, 0), int(fields[1]))
+        ci = aux_file(obj, ".ci")
+        if os.path.exists(ci):
+            with open(ci) as f:
+                text = f.read()
+            for title, label in VCG_NODE.findall(text):
+                match = VCG_STACK.search(label)
+                if match:
+                    name = strip_file(title)
+                    frames[name] = max(frames.get(name, 0), int(match.group(1)))
+            for source, target in VCG_EDGE.findall(text):
+                edges.setdefault(strip_file(source), set()).add(strip_file(target))
+    return frames, edges
+
+
+def stack_depth(root, frames, edges):
+    """Worst-case stack from root; unknown callees (other modules' libraries, indirect calls) count as 0."""
+    unknown = set()
+    memo = {}
+
+    def visit(name, path):
+        if name in memo:
+            return memo[name]
+        if name in path:
+            unknown.add(name + " (recursion)")
+            return 0
+        if name not in frames:
+            unknown.add(name)
+            return 0
+        path.add(name)
+        deepest = max((visit(callee, path) for callee in edges.get(name, ())), default=0)
+        path.discard(name)
+        memo[name] = frames[name] + deepest
+        return memo[name]
+
+    if root not in frames:
+        return None, []
+    depth = visit(root, set())
+    unknown.discard(root)
+    return depth, sorted(unknown)
+
+
+def build_report(args):
+    report = {"name": args.name, "modules": {}, "stack": {}}
+    all_objects = []
+    for module in args.module:
+        name, _, objects = module.partition("=")
+        objects = [obj for obj in objects.split(",") if obj]
+        all_objects += objects
+        report["modules"][name] = {
+            "sections": section_totals(args.objdump, objects),
+            "symbols": symbols(args.nm, objects),
+        }
+    frames, edges = load_call_graph(all_objects)
+    for root in args.stack:
+        depth, unknown = stack_depth(root, frames, edges)
+        report["stack"][root] = {
+            "frame": frames.get(root),
+            "depth": depth,
+            "call_graph": bool(edges),
+            "unknown_callees": unknown,
+        }
+    return report
+
+
+def print_report(report, top):
+    print("Footprint of %s" % report["name"])
+    for name, module in report["modules"].items():
+        sections = module["sections"]
+        print("\n%s: text %d, rodata %d, data %d, bss %d bytes" %
+              (name, sections["text"], sections["rodata"], sections["data"], sections["bss"]))
+        for section in SECTIONS:
+            table = module["symbols"][section]
+            if not table:
+                continue
+            print("  .%s" % section)
+            entries = sorted(table.items(), key=lambda item: (-item[1], item[0]))
+            for symbol, size in entries[:top] if top else entries:
+                print("    %6d  %s" % (size, symbol))
+            if top and len(entries) > top:
+                print("    %6d  (%d more)" % (sum(size for _, size in entries[top:]), len(entries) - top))
+    for root, stack in report["stack"].items():
+        if stack["depth"] is None:
+            print("\nstack %s: not found (inlined, or built without -fstack-usage)" % root)
+            continue
+        kind = "worst-case depth" if stack["call_graph"] else "own frame only, no call graph"
+        print("\nstack %s: %d bytes (%s, frame %d)" % (root, stack["depth"], kind, stack["frame"]))
+        if stack["unknown_callees"]:
+            print("  not included: %s" % ", ".join(stack["unknown_callees"]))
+
+
+def compare(report, baseline, tolerance):
+    failures = []
+    print("\nCompared with baseline (tolerance %d bytes):" % tolerance)
+    for name, module in report["modules"].items():
+        old = baseline.get("modules", {}).get(name)
+        if old is None:
+            print("  %s: not in baseline" % name)
+            continue
+        for section in SECTIONS:
+            delta = module["sections"][section] - old["sections"].get(section, 0)
+            if delta:
+                print("  %s .%s: %+d bytes" % (name, section, delta))
+            if delta > tolerance:
+                failures.append("%s .%s grew by %d bytes" % (name, section, delta))
+            old_symbols = old["symbols"].get(section, {})
+            new_symbols = module["symbols"][section]
+            for symbol in sorted(set(old_symbols) | set(new_symbols)):
+                change = new_symbols.get(symbol, 0) - old_symbols.get(symbol, 0)
+                if change:
+                    print("      %+6d  %s" % (change, symbol))
+    for root, stack in report["stack"].items():
+        old = baseline.get("stack", {}).get(root)
+        if old is None or old.get("depth") is None or stack["depth"] is None:
+            continue
+        delta = stack["depth"] - old["depth"]
+        if delta:
+            print("  stack %s: %+d bytes" % (root, delta))
+        if delta > tolerance:
+            failures.append("stack of %s grew by %d bytes" % (root, delta))
+    return failures
+
+
+def main():
+    parser = argparse.ArgumentParser(description="dmclk footprint report")
+    parser.add_argument("--nm", default="nm")
+    parser.add_argument("--objdump", default="objdump")
+    parser.add_argument("--name", required=True, help="Port and feature set, names the baseline")
+    parser.add_argument("--module", action="append", default=[], help="NAME=OBJ[,OBJ...]")
+    parser.add_argument("--stack", action="append", default=[], help="Function to report the stack depth of")
+    parser.add_argument("--baseline", help="Baseline report (JSON)")
+    parser.add_argument("--write-baseline", action="store_true", help="Store the report as the baseline")
+    parser.add_argument("--require-baseline", action="store_true", help="Fail when the baseline is missing")
+    parser.add_argument("--tolerance", type=int, default=0, help="Allowed growth in bytes")
+    parser.add_argument("--output", help="Write the report (JSON) here")
+    parser.add_argument("--top", type=int, default=0, help="Symbols listed per section, 0 for all")
+    args = parser.parse_args()
+
+    report = build_report(args)
+    print_report(report, args.top)
+
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(report, f, indent=2, sort_keys=True)
+            f.write("\n")
+
+    if args.write_baseline:
+        os.makedirs(os.path.dirname(os.path.abspath(args.baseline)), exist_ok=True)
+        with open(args.baseline, "w") as f:
+            json.dump(report, f, indent=2, sort_keys=True)
+            f.write("\n")
+        print("\nBaseline written to %s" % args.baseline)
+        return 0
+
+    if args.baseline:
+        if not os.path.exists(args.baseline):
+            print("\nNo baseline for %s (%s) - build the footprint_baseline target and commit it" %
+                  (args.name, args.baseline))
+            return 1 if args.require_baseline else 0
+        with open(args.baseline) as f:
+            failures = compare(report, json.load(f), args.tolerance)
+        if failures:
+            print("\nFootprint check failed:")
+            for failure in failures:
+                print("  " + failure)
+            return 1
+        print("  within tolerance")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,10 @@
+#ifndef DMCLK_DEFS_H
+#define DMCLK_DEFS_H
+
+/**
+ * @brief Host stand-in for the DMOD generated dmclk API definitions
+ *
+ * The generator does not use the dmclk module API, only its types.
+ */
+
+#endif // DMCLK_DEFS_H
@@ -0,0 +1,12 @@
+#ifndef DMCLK_PORT_DEFS_H
+#define DMCLK_PORT_DEFS_H
+
+/**
+ * @brief Host stand-in for the DMOD generated port API definitions
+ *
+ * Port API functions become plain C functions named dmclk_port<name>.
+ */
+#define dmod_dmclk_port_api(VERSION, RET, NAME, ARGS)               RET dmclk_port##NAME ARGS
+#define dmod_dmclk_port_api_declaration(VERSION, RET, NAME, ARGS)   RET dmclk_port##NAME ARGS
+
+#endif // DMCLK_PORT_DEFS_H
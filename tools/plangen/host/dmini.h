@@ -0,0 +1,16 @@
+#ifndef DMINI_H
+#define DMINI_H
+
+/**
+ * @brief Host stand-in for the dmini API
+ *
+ * Implemented by the plan generator on top of its own ini reader, with the
+ * lookups dmclk uses.
+ */
+
+typedef struct dmini_context* dmini_context_t;
+
+int dmini_get_int(dmini_context_t ctx, const char* section, const char* key, int default_value);
+const char* dmini_get_string(dmini_context_t ctx, const char* section, const char* key, const char* default_value);
+
+#endif // DMINI_H
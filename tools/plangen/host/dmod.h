@@ -0,0 +1,28 @@
+#ifndef DMOD_H
+#define DMOD_H
+
+/**
+ * @brief Host stand-in for the DMOD API
+ *
+ * The plan generator links the port and the governor into a host executable,
+ * without the DMOD runtime. Only what they use is provided.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+typedef struct
+{
+    int unused;
+} Dmod_Config_t;
+
+void Dmod_EnterCritical(void);
+void Dmod_ExitCritical(void);
+int Dmod_Printf(const char *format, ...);
+
+#define DMOD_LOG_ERROR(...)     fprintf(stderr, __VA_ARGS__)
+#define DMOD_LOG_INFO(...)      do { } while (0)
+
+#endif // DMOD_H
@@ -0,0 +1,582 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include "dmini.h"
+#include "dmclk.h"
+#include "dmclk_port.h"
+#include "dmclk_governor.h"
+
+/**
+ * @brief Plan generator for DMCLK_STATIC_CONFIG builds
+ *
+ * Usage:
+ *   dmclk_plangen <config.ini> <dmclk_static_config.h>
+ *
+ * Reads the configuration the way dmclk_dmdrvi_create() does - [dmclk] with
+ * the governor keys, [dmclk.plli2s], [dmclk.pllsai], [dmclk.opp.N] and
+ * [dmclk.mcoN] - solves the main plan and every operating point with the
+ * planner of the port it is built for and writes them as constant
+ * initializers for src/dmclk.c.
+ */
+
+#define PLANGEN_MAX_LINE        256
+
+typedef struct ini_entry
+{
+    char* section;
+    char* key;
+    char* value;
+    struct ini_entry* next;
+} ini_entry_t;
+
+struct dmini_context
+{
+    ini_entry_t* entries;
+};
+
+/* Same defaults and validation as read_config_parameters() in src/dmclk.c */
+typedef struct
+{
+    dmclk_frequency_t target_frequency;
+    dmclk_frequency_t tolerance;
+    dmclk_frequency_t oscillator_frequency;
+    dmclk_source_t source;
+    dmclk_bus_policy_t bus_policy;
+} plangen_config_t;
+
+typedef struct
+{
+    plangen_config_t config;
+    dmclk_port_plan_t plan;
+} plangen_opp_t;
+
+/* The port planners run on the host, nothing here touches the hardware */
+void Dmod_EnterCritical(void)
+{
+}
+
+void Dmod_ExitCritical(void)
+{
+}
+
+int Dmod_Printf(const char *format, ...)
+{
+    (void)format;
+    return 0;
+}
+
+static char* trim(char* text)
+{
+    while (isspace((unsigned char)*text))
+    {
+        text++;
+    }
+    char* end = text + strlen(text);
+    while (end > text && isspace((unsigned char)end[-1]))
+    {
+        *--end = '\0';
+    }
+    return text;
+}
+
+static char* duplicate(const char* text)
+{
+    char* copy = malloc(strlen(text) + 1);
+    if (copy == NULL)
+    {
+        fprintf(stderr, "Out of memory\n");
+        exit(1);
+    }
+    return strcpy(copy, text);
+}
+
+static int ini_load(const char* path, struct dmini_context* ini)
+{
+    char line[PLANGEN_MAX_LINE];
+    char section[PLANGEN_MAX_LINE] = "";
+    ini_entry_t** tail = &ini->entries;
+    FILE* file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return -1;
+    }
+
+    ini->entries = NULL;
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char* text = trim(line);
+        if (*text == '\0' || *text == ';' || *text == '#')
+        {
+            continue;
+        }
+        if (*text == '[')
+        {
+            char* end = strchr(text, ']');
+            if (end == NULL)
+            {
+                fprintf(stderr, "%s: malformed section header: %s\n", path, text);
+                fclose(file);
+                return -1;
+            }
+            *end = '\0';
+            strcpy(section, trim(text + 1));
+            continue;
+        }
+        char* equals = strchr(text, '=');
+        if (equals == NULL)
+        {
+            continue;
+        }
+        *equals = '\0';
+
+        ini_entry_t* entry = calloc(1, sizeof(*entry));
+        if (entry == NULL)
+        {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        entry->section = duplicate(section);
+        entry->key = duplicate(trim(text));
+        entry->value = duplicate(trim(equals + 1));
+        *tail = entry;
+        tail = &entry->next;
+    }
+    fclose(file);
+    return 0;
+}
+
+static const char* ini_find(dmini_context_t ctx, const char* section, const char* key)
+{
+    const char* value = NULL;
+    for (const ini_entry_t* entry = ctx->entries; entry != NULL; entry = entry->next)
+    {
+        if (strcmp(entry->section, section) == 0 && strcmp(entry->key, key) == 0)
+        {
+            value = entry->value;
+        }
+    }
+    return value;
+}
+
+int dmini_get_int(dmini_context_t ctx, const char* section, const char* key, int default_value)
+{
+    const char* value = ini_find(ctx, section, key);
+    return (value != NULL) ? (int)strtol(value, NULL, 10) : default_value;
+}
+
+const char* dmini_get_string(dmini_context_t ctx, const char* section, const char* key, const char* default_value)
+{
+    const char* value = ini_find(ctx, section, key);
+    return (value != NULL) ? value : default_value;
+}
+
+static int parse_source(const char* text, dmclk_source_t* source)
+{
+    if (text != NULL)
+    {
+        if (strcmp(text, "internal") == 0)
+        {
+            *source = dmclk_source_internal;
+            return 0;
+        }
+        if (strcmp(text, "external") == 0)
+        {
+            *source = dmclk_source_external;
+            return 0;
+        }
+        if (strcmp(text, "hibernation") == 0)
+        {
+            *source = dmclk_source_hibernation;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static int parse_bus_policy(const char* text, dmclk_bus_policy_t* policy)
+{
+    if (text == NULL || strcmp(text, "performance") == 0)
+    {
+        *policy = dmclk_bus_policy_performance;
+        return 0;
+    }
+    if (strcmp(text, "powersave") == 0)
+    {
+        *policy = dmclk_bus_policy_powersave;
+        return 0;
+    }
+    return -1;
+}
+
+static int parse_mco_source(const char* text, dmclk_mco_source_t* source)
+{
+    static const struct
+    {
+        const char* name;
+        dmclk_mco_source_t source;
+    } sources[] = {
+        { "off",        dmclk_mco_source_off },
+        { "sysclk",     dmclk_mco_source_sysclk },
+        { "internal",   dmclk_mco_source_internal },
+        { "external",   dmclk_mco_source_external },
+        { "pll",        dmclk_mco_source_pll },
+        { "plli2s",     dmclk_mco_source_plli2s },
+    };
+    if (text == NULL)
+    {
+        *source = dmclk_mco_source_off;
+        return 0;
+    }
+    for (size_t i = 0; i < sizeof(sources) / sizeof(sources[0]); i++)
+    {
+        if (strcmp(text, sources[i].name) == 0)
+        {
+            *source = sources[i].source;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+static const char* source_name(dmclk_source_t source)
+{
+    switch (source)
+    {
+        case dmclk_source_internal:     return "dmclk_source_internal";
+        case dmclk_source_external:     return "dmclk_source_external";
+        default:                        return "dmclk_source_hibernation";
+    }
+}
+
+static const char* bus_policy_name(dmclk_bus_policy_t policy)
+{
+    return (policy == dmclk_bus_policy_powersave) ? "dmclk_bus_policy_powersave" : "dmclk_bus_policy_performance";
+}
+
+static const char* governor_name(dmclk_governor_t policy)
+{
+    switch (policy)
+    {
+        case dmclk_governor_performance:    return "dmclk_governor_performance";
+        case dmclk_governor_powersave:      return "dmclk_governor_powersave";
+        case dmclk_governor_ondemand:       return "dmclk_governor_ondemand";
+        case dmclk_governor_conservative:   return "dmclk_governor_conservative";
+        default:                            return "dmclk_governor_none";
+    }
+}
+
+static const char* mco_source_name(dmclk_mco_source_t source)
+{
+    switch (source)
+    {
+        case dmclk_mco_source_sysclk:       return "dmclk_mco_source_sysclk";
+        case dmclk_mco_source_internal:     return "dmclk_mco_source_internal";
+        case dmclk_mco_source_external:     return "dmclk_mco_source_external";
+        case dmclk_mco_source_pll:          return "dmclk_mco_source_pll";
+        case dmclk_mco_source_plli2s:       return "dmclk_mco_source_plli2s";
+        default:                            return "dmclk_mco_source_off";
+    }
+}
+
+/**
+ * @brief Check a configuration, same rules as check_config_parameters() in src/dmclk.c
+ */
+static int check_config(const plangen_config_t* cfg, const char* section)
+{
+    if (cfg->target_frequency == 0)
+    {
+        fprintf(stderr, "[%s]: target_frequency not set\n", section);
+        return -1;
+    }
+    if (cfg->tolerance == 0)
+    {
+        fprintf(stderr, "[%s]: tolerance not set\n", section);
+        return -1;
+    }
+    if (cfg->source == dmclk_source_external && cfg->oscillator_frequency == 0)
+    {
+        fprintf(stderr, "[%s]: oscillator_frequency not set for external source\n", section);
+        return -1;
+    }
+    return 0;
+}
+
+static int plan_config(const plangen_config_t* cfg, const char* section, dmclk_port_plan_t* plan)
+{
+    int ret;
+    switch (cfg->source)
+    {
+        case dmclk_source_internal:
+            ret = dmclk_port_plan_internal(cfg->target_frequency, cfg->tolerance, cfg->bus_policy, plan);
+            break;
+        case dmclk_source_external:
+            ret = dmclk_port_plan_external(cfg->target_frequency, cfg->tolerance, cfg->oscillator_frequency, cfg->bus_policy, plan);
+            break;
+        default:
+            ret = dmclk_port_plan_hibernation(cfg->target_frequency, cfg->tolerance, cfg->oscillator_frequency, plan);
+            break;
+    }
+    if (ret != 0)
+    {
+        fprintf(stderr, "[%s]: no clock configuration reaches %llu Hz +/- %llu Hz\n", section,
+                (unsigned long long)cfg->target_frequency, (unsigned long long)cfg->tolerance);
+        return -1;
+    }
+    return 0;
+}
+
+static int read_peripheral_clocks(dmini_context_t ini, dmclk_peripheral_clocks_t* clocks)
+{
+    clocks->i2s_frequency = (dmclk_frequency_t)dmini_get_int(ini, "dmclk.plli2s", "target_frequency", 0);
+    clocks->i2s_tolerance = (dmclk_frequency_t)dmini_get_int(ini, "dmclk.plli2s", "tolerance", 0);
+    clocks->sai_frequency = (dmclk_frequency_t)dmini_get_int(ini, "dmclk.pllsai", "sai_frequency", 0);
+    clocks->lcd_frequency = (dmclk_frequency_t)dmini_get_int(ini, "dmclk.pllsai", "lcd_frequency", 0);
+    clocks->pllsai_tolerance = (dmclk_frequency_t)dmini_get_int(ini, "dmclk.pllsai", "tolerance", 0);
+
+    if (clocks->i2s_frequency == 0 && clocks->sai_frequency == 0 && clocks->lcd_frequency == 0)
+    {
+        dmclk_port_set_peripheral_clocks(NULL);
+        return 0;
+    }
+    if (dmclk_port_set_peripheral_clocks(clocks) != 0)
+    {
+        fprintf(stderr, "PLLI2S / PLLSAI clocks are not supported by the port\n");
+        return -1;
+    }
+    return 1;
+}
+
+static int read_opps(dmini_context_t ini, const plangen_config_t* defaults, plangen_opp_t* opps, uint32_t* count)
+{
+    char section[24];
+
+    *count = 0;
+    for (uint32_t i = 0; ; i++)
+    {
+        snprintf(section, sizeof(section), "dmclk.opp.%u", (unsigned int)i);
+        const char* source = dmini_get_string(ini, section, "source", NULL);
+        if (source == NULL)
+        {
+            return 0;
+        }
+        if (i >= DMCLK_MAX_OPPS)
+        {
+            fprintf(stderr, "Too many operating points, at most %d are supported\n", DMCLK_MAX_OPPS);
+            return -1;
+        }
+
+        plangen_config_t* cfg = &opps[i].config;
+        if (parse_source(source, &cfg->source) != 0)
+        {
+            fprintf(stderr, "[%s]: unknown source %s\n", section, source);
+            return -1;
+        }
+        cfg->target_frequency = (dmclk_frequency_t)dmini_get_int(ini, section, "target_frequency", 0);
+        cfg->tolerance = (dmclk_frequency_t)dmini_get_int(ini, section, "tolerance", (int)defaults->tolerance);
+        cfg->oscillator_frequency = (dmclk_frequency_t)dmini_get_int(ini, section, "oscillator_frequency", (int)defaults->oscillator_frequency);
+        const char* bus = dmini_get_string(ini, section, "bus", NULL);
+        if (bus == NULL)
+        {
+            cfg->bus_policy = defaults->bus_policy;
+        }
+        else if (parse_bus_policy(bus, &cfg->bus_policy) != 0)
+        {
+            fprintf(stderr, "[%s]: unknown bus policy %s\n", section, bus);
+            return -1;
+        }
+        if (check_config(cfg, section) != 0 || plan_config(cfg, section, &opps[i].plan) != 0)
+        {
+            return -1;
+        }
+        *count = i + 1;
+    }
+}
+
+static int read_mcos(dmini_context_t ini, dmclk_mco_config_t* mcos)
+{
+    char section[16];
+
+    for (uint32_t output = 1; output <= DMCLK_MCO_COUNT; output++)
+    {
+        snprintf(section, sizeof(section), "dmclk.mco%u", (unsigned int)output);
+        const char* source = dmini_get_string(ini, section, "source", NULL);
+        dmclk_mco_config_t* mco = &mcos[output - 1];
+        if (parse_mco_source(source, &mco->source) != 0)
+        {
+            fprintf(stderr, "[%s]: unknown clock output source %s\n", section, source);
+            return -1;
+        }
+        mco->output = output;
+        mco->divider = (uint32_t)dmini_get_int(ini, section, "divider", 1);
+    }
+    return 0;
+}
+
+static void write_config(FILE* out, const plangen_config_t* cfg)
+{
+    fprintf(out, "{ .target_frequency = %lluULL, .tolerance = %lluULL, .oscillator_frequency = %lluULL, .source = %s, .bus_policy = %s }",
+            (unsigned long long)cfg->target_frequency, (unsigned long long)cfg->tolerance,
+            (unsigned long long)cfg->oscillator_frequency, source_name(cfg->source), bus_policy_name(cfg->bus_policy));
+}
+
+static void write_plan(FILE* out, const dmclk_port_plan_t* plan, const char* indent)
+{
+    fprintf(out, "{ \\\n%s    .frequency = %lluULL, \\\n%s    .data = {", indent, (unsigned long long)plan->frequency, indent);
+    for (uint32_t i = 0; i < DMCLK_PORT_PLAN_WORDS; i++)
+    {
+        if (i % 4 == 0)
+        {
+            fprintf(out, " \\\n%s        ", indent);
+        }
+        fprintf(out, "0x%08XU,%s", (unsigned int)plan->data[i], (i % 4 == 3) ? "" : " ");
+    }
+    fprintf(out, " \\\n%s    }, \\\n%s}", indent, indent);
+}
+
+static int write_header(const char* path, const char* ini_path, const plangen_config_t* cfg,
+                        const struct dmclk_governor* governor, const dmclk_port_plan_t* plan,
+                        const dmclk_peripheral_clocks_t* clocks, const plangen_opp_t* opps,
+                        uint32_t opp_count, const dmclk_mco_config_t* mcos)
+{
+    FILE* out = fopen(path, "w");
+    if (out == NULL)
+    {
+        fprintf(stderr, "Cannot write %s\n", path);
+        return -1;
+    }
+
+    fprintf(out, "/* Generated by dmclk_plangen from %s - do not edit */\n", ini_path);
+    fprintf(out, "#ifndef DMCLK_STATIC_CONFIG_H\n#define DMCLK_STATIC_CONFIG_H\n\n");
+
+    fprintf(out, "/* [dmclk], target after the initial governor policy */\n");
+    fprintf(out, "#define DMCLK_STATIC_CONFIG_VALUES \\\n    ");
+    write_config(out, cfg);
+    fprintf(out, "\n\n");
+
+    fprintf(out, "#define DMCLK_STATIC_GOVERNOR { \\\n"
+                 "    .policy = %s, \\\n"
+                 "    .min_frequency = %lluULL, \\\n"
+                 "    .max_frequency = %lluULL, \\\n"
+                 "    .step = %lluULL, \\\n"
+                 "    .sampling_period_us = %uU, \\\n"
+                 "    .up_threshold = %uU, \\\n"
+                 "    .down_threshold = %uU, \\\n"
+                 "    .down_samples = %uU, \\\n"
+                 "}\n\n",
+            governor_name(governor->policy), (unsigned long long)governor->min_frequency,
+            (unsigned long long)governor->max_frequency, (unsigned long long)governor->step,
+            (unsigned int)governor->sampling_period_us, (unsigned int)governor->up_threshold,
+            (unsigned int)governor->down_threshold, (unsigned int)governor->down_samples);
+
+    fprintf(out, "/* %llu Hz */\n#define DMCLK_STATIC_PLAN ", (unsigned long long)plan->frequency);
+    write_plan(out, plan, "");
+    fprintf(out, "\n\n");
+
+    if (clocks != NULL)
+    {
+        fprintf(out, "/* [dmclk.plli2s] and [dmclk.pllsai] */\n"
+                     "#define DMCLK_STATIC_PERIPHERAL_CLOCKS { \\\n"
+                     "    .i2s_frequency = %lluULL, \\\n"
+                     "    .i2s_tolerance = %lluULL, \\\n"
+                     "    .sai_frequency = %lluULL, \\\n"
+                     "    .lcd_frequency = %lluULL, \\\n"
+                     "    .pllsai_tolerance = %lluULL, \\\n"
+                     "}\n\n",
+                (unsigned long long)clocks->i2s_frequency, (unsigned long long)clocks->i2s_tolerance,
+                (unsigned long long)clocks->sai_frequency, (unsigned long long)clocks->lcd_frequency,
+                (unsigned long long)clocks->pllsai_tolerance);
+    }
+
+    fprintf(out, "/* [dmclk.opp.N] */\n#define DMCLK_STATIC_OPP_COUNT %u\n", (unsigned int)opp_count);
+    if (opp_count == 0)
+    {
+        fprintf(out, "#define DMCLK_STATIC_OPPS { 0 }\n\n");
+    }
+    else
+    {
+        fprintf(out, "#define DMCLK_STATIC_OPPS { \\\n");
+        for (uint32_t i = 0; i < opp_count; i++)
+        {
+            fprintf(out, "    { \\\n        .config = ");
+            write_config(out, &opps[i].config);
+            fprintf(out, ", \\\n        .plan = ");
+            write_plan(out, &opps[i].plan, "        ");
+            fprintf(out, ", \\\n    }, \\\n");
+        }
+        fprintf(out, "}\n\n");
+    }
+
+    fprintf(out, "/* [dmclk.mcoN] */\n#define DMCLK_STATIC_MCOS { \\\n");
+    for (uint32_t i = 0; i < DMCLK_MCO_COUNT; i++)
+    {
+        fprintf(out, "    { .output = %uU, .source = %s, .divider = %uU }, \\\n", (unsigned int)mcos[i].output,
+                mco_source_name(mcos[i].source), (unsigned int)mcos[i].divider);
+    }
+    fprintf(out, "}\n\n#endif // DMCLK_STATIC_CONFIG_H\n");
+
+    return (fclose(out) == 0) ? 0 : -1;
+}
+
+int main(int argc, char *argv[])
+{
+    struct dmini_context ini;
+    plangen_config_t cfg;
+    struct dmclk_governor governor;
+    dmclk_port_plan_t plan;
+    dmclk_peripheral_clocks_t clocks;
+    plangen_opp_t opps[DMCLK_MAX_OPPS];
+    uint32_t opp_count = 0;
+    dmclk_mco_config_t mcos[DMCLK_MCO_COUNT];
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: %s <config.ini> <dmclk_static_config.h>\n", argv[0]);
+        return 2;
+    }
+    if (ini_load(argv[1], &ini) != 0)
+    {
+        return 1;
+    }
+
+    const char* source = dmini_get_string(&ini, "dmclk", "source", NULL);
+    if (parse_source(source, &cfg.source) != 0)
+    {
+        fprintf(stderr, "[dmclk]: source not set or unknown\n");
+        return 1;
+    }
+    const char* bus = dmini_get_string(&ini, "dmclk", "bus", NULL);
+    if (parse_bus_policy(bus, &cfg.bus_policy) != 0)
+    {
+        fprintf(stderr, "[dmclk]: unknown bus policy %s\n", bus);
+        return 1;
+    }
+    cfg.target_frequency = (dmclk_frequency_t)dmini_get_int(&ini, "dmclk", "target_frequency", 0);
+    cfg.tolerance = (dmclk_frequency_t)dmini_get_int(&ini, "dmclk", "tolerance", 0);
+    cfg.oscillator_frequency = (dmclk_frequency_t)dmini_get_int(&ini, "dmclk", "oscillator_frequency", 0);
+    if (check_config(&cfg, "dmclk") != 0
+     || dmclk_governor_read_config(&governor, &ini, cfg.target_frequency) != 0)
+    {
+        return 1;
+    }
+    cfg.target_frequency = dmclk_governor_initial_target(&governor, cfg.target_frequency);
+
+    int peripheral = read_peripheral_clocks(&ini, &clocks);
+    if (peripheral < 0
+     || plan_config(&cfg, "dmclk", &plan) != 0
+     || read_opps(&ini, &cfg, opps, &opp_count) != 0
+     || read_mcos(&ini, mcos) != 0)
+    {
+        return 1;
+    }
+
+    if (write_header(argv[2], argv[1], &cfg, &governor, &plan, (peripheral > 0) ? &clocks : NULL,
+                     opps, opp_count, mcos) != 0)
+    {
+        return 1;
+    }
+    printf("%s: %llu Hz, %u operating points\n", argv[1], (unsigned long long)plan.frequency, (unsigned int)opp_count);
+    return 0;
+}
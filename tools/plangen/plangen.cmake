@@ -0,0 +1,38 @@
+# ======================================================================
+#               Static configuration
+# ======================================================================
+# Builds dmclk_plangen for the host, runs it on DMCLK_STATIC_CONFIG and
+# compiles dmclk with the generated dmclk_static_config.h - the context,
+# configuration and solved plans become constants, the module neither parses
+# an ini file nor allocates memory at boot.
+#
+include(ExternalProject)
+
+set(DMCLK_PLANGEN_DIR       ${CMAKE_BINARY_DIR}/plangen)
+set(DMCLK_PLANGEN_TOOL      ${DMCLK_PLANGEN_DIR}/dmclk_plangen${CMAKE_HOST_EXECUTABLE_SUFFIX})
+set(DMCLK_STATIC_DIR        ${CMAKE_BINARY_DIR}/dmclk_static)
+set(DMCLK_STATIC_HEADER     ${DMCLK_STATIC_DIR}/dmclk_static_config.h)
+
+# The main build uses the cross toolchain, the generator needs the host one
+ExternalProject_Add(dmclk_plangen
+    SOURCE_DIR          ${CMAKE_CURRENT_LIST_DIR}
+    BINARY_DIR          ${DMCLK_PLANGEN_DIR}
+    CMAKE_ARGS          -DDMCLK_MCU_SERIES=${DMCLK_MCU_SERIES}
+    BUILD_ALWAYS        ON
+    INSTALL_COMMAND     ""
+    BUILD_BYPRODUCTS    ${DMCLK_PLANGEN_TOOL}
+)
+
+add_custom_command(
+    OUTPUT ${DMCLK_STATIC_HEADER}
+    COMMAND ${CMAKE_COMMAND} -E make_directory ${DMCLK_STATIC_DIR}
+    COMMAND ${DMCLK_PLANGEN_TOOL} ${DMCLK_STATIC_CONFIG} ${DMCLK_STATIC_HEADER}
+    DEPENDS ${DMCLK_STATIC_CONFIG} dmclk_plangen
+    COMMENT "Generating the dmclk static configuration from ${DMCLK_STATIC_CONFIG}"
+    VERBATIM
+)
+add_custom_target(dmclk_static_config DEPENDS ${DMCLK_STATIC_HEADER})
+
+add_dependencies(dmclk dmclk_static_config)
+target_compile_definitions(dmclk PRIVATE DMCLK_STATIC_CONFIG)
+target_include_directories(dmclk PRIVATE ${DMCLK_STATIC_DIR})